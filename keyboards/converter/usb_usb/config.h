@@ -40,6 +40,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /* matrix scanning is done in custom_matrix.cpp */
 #define DIODE_DIRECTION CUSTOM_MATRIX
 
+/* the keys of all attached keyboards are sent in one report */
+#define FORCE_NKRO
+
+/* hid_merge.c applies a whole report per scan, so all keys it changed have to be
+ * processed in that scan, or the next report overwrites some of them */
+#define QMK_KEYS_PER_SCAN (MATRIX_ROWS * MATRIX_COLS)
+
 /* key combination for command */
 #define IS_COMMAND() (keyboard_report->mods == (MOD_BIT(KC_LSHIFT) | MOD_BIT(KC_RSHIFT))) 
 
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "hid.h"
 #include "hidboot.h"
 #include "parser.h"
+#include "hid_merge.h"
 
 #include "keycode.h"
 #include "util.h"
@@ -64,14 +65,14 @@ extern "C" {
 #define ROW_BITS(code)  (1 << COL(code))
 
 
-// Integrated key state of all keyboards
-static report_keyboard_t local_keyboard_report;
-
 static bool matrix_is_mod = false;
 
 /*
  * USB Host Shield HID keyboards
  * This supports two cascaded hubs and four keyboards
+ *
+ * Their reports are merged by hid_merge.c, so together they can hold down
+ * any number of keys, and each report they send is seen by one scan.
  */
 USB usb_host;
 USBHub hub1(&usb_host);
@@ -80,10 +81,13 @@ HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd1(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd2(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd3(&usb_host);
 HIDBoot<HID_PROTOCOL_KEYBOARD>    kbd4(&usb_host);
-KBDReportParser kbd_parser1;
-KBDReportParser kbd_parser2;
-KBDReportParser kbd_parser3;
-KBDReportParser kbd_parser4;
+KBDReportParser kbd_parser1(0);
+KBDReportParser kbd_parser2(1);
+KBDReportParser kbd_parser3(2);
+KBDReportParser kbd_parser4(3);
+
+static HIDBoot<HID_PROTOCOL_KEYBOARD> *const kbds[] = { &kbd1, &kbd2, &kbd3, &kbd4 };
+#define KBD_COUNT (sizeof(kbds) / sizeof(kbds[0]))
 
 
 extern "C"
@@ -94,62 +98,15 @@ extern "C"
     void matrix_init(void) {
         // USB Host Shield setup
         usb_host.Init();
+        hid_merge_init();
         kbd1.SetReportParser(0, (HIDReportParser*)&kbd_parser1);
         kbd2.SetReportParser(0, (HIDReportParser*)&kbd_parser2);
         kbd3.SetReportParser(0, (HIDReportParser*)&kbd_parser3);
         kbd4.SetReportParser(0, (HIDReportParser*)&kbd_parser4);
     }
 
-    static void or_report(report_keyboard_t report) {
-        // integrate reports into local_keyboard_report
-        local_keyboard_report.mods |= report.mods;
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(report.keys[i])) {
-                for (uint8_t j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
-                    if (! local_keyboard_report.keys[j]) {
-                        local_keyboard_report.keys[j] = report.keys[i];
-                        break;
-                    }
-                }
-            }
-        }
-    }
-
     uint8_t matrix_scan(void) {
-        static uint16_t last_time_stamp1 = 0;
-        static uint16_t last_time_stamp2 = 0;
-        static uint16_t last_time_stamp3 = 0;
-        static uint16_t last_time_stamp4 = 0;
-
-        // check report came from keyboards
-        if (kbd_parser1.time_stamp != last_time_stamp1 ||
-            kbd_parser2.time_stamp != last_time_stamp2 ||
-            kbd_parser3.time_stamp != last_time_stamp3 ||
-            kbd_parser4.time_stamp != last_time_stamp4) {
-
-            last_time_stamp1 = kbd_parser1.time_stamp;
-            last_time_stamp2 = kbd_parser2.time_stamp;
-            last_time_stamp3 = kbd_parser3.time_stamp;
-            last_time_stamp4 = kbd_parser4.time_stamp;
-
-            // clear and integrate all reports
-            local_keyboard_report = {};
-            or_report(kbd_parser1.report);
-            or_report(kbd_parser2.report);
-            or_report(kbd_parser3.report);
-            or_report(kbd_parser4.report);
-
-            matrix_is_mod = true;
-
-            dprintf("state:  %02X %02X", local_keyboard_report.mods, local_keyboard_report.reserved);
-            for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-                dprintf(" %02X", local_keyboard_report.keys[i]);
-            }
-            dprint("\r\n");
-        } else {
-            matrix_is_mod = false;
-        }
-
+        // reports are parsed in here, so the scan sees them right away
         uint16_t timer;
         timer = timer_read();
         usb_host.Task();
@@ -158,6 +115,27 @@ extern "C"
             dprintf("host.Task: %d\n", timer);
         }
 
+        // release the keys of keyboards that were unplugged
+        static bool kbd_ready[KBD_COUNT] = {};
+        for (uint8_t i = 0; i < KBD_COUNT; i++) {
+            bool ready = kbds[i]->isReady();
+            if (kbd_ready[i] && !ready) {
+                hid_merge_release(i);
+            }
+            kbd_ready[i] = ready;
+        }
+
+        matrix_is_mod = hid_merge_apply();
+        if (matrix_is_mod && debug_matrix) {
+            print("state:");
+            for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+                if (hid_merge_row(row)) {
+                    xprintf(" %02X:%04X", row, hid_merge_row(row));
+                }
+            }
+            print("\r\n");
+        }
+
         static uint8_t usb_state = 0;
         if (usb_state != usb_host.getUsbTaskState()) {
             usb_state = usb_host.getUsbTaskState();
@@ -177,48 +155,15 @@ extern "C"
     }
 
     bool matrix_is_on(uint8_t row, uint8_t col) {
-        uint8_t code = CODE(row, col);
-
-        if (IS_MOD(code)) {
-            if (local_keyboard_report.mods & ROW_BITS(code)) {
-                return true;
-            }
-        }
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (local_keyboard_report.keys[i] == code) {
-                return true;
-            }
-        }
-        return false;
+        return hid_merge_is_on(CODE(row, col));
     }
 
     matrix_row_t matrix_get_row(uint8_t row) {
-        uint16_t row_bits = 0;
-
-        if (IS_MOD(CODE(row, 0)) && local_keyboard_report.mods) {
-            row_bits |= local_keyboard_report.mods;
-        }
-
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(local_keyboard_report.keys[i])) {
-                if (row == ROW(local_keyboard_report.keys[i])) {
-                    row_bits |= ROW_BITS(local_keyboard_report.keys[i]);
-                }
-            }
-        }
-        return row_bits;
+        return hid_merge_row(row);
     }
 
     uint8_t matrix_key_count(void) {
-        uint8_t count = 0;
-
-        count += bitpop(local_keyboard_report.mods);
-        for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-            if (IS_ANY(local_keyboard_report.keys[i])) {
-                count++;
-            }
-        }
-        return count;
+        return hid_merge_key_count();
     }
 
     void matrix_print(void) {
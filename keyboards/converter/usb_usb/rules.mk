@@ -61,7 +61,7 @@ EXTRAKEY_ENABLE		= yes	# Audio control and System control(+450)
 # CONSOLE_ENABLE		= yes	# Console for debug(+400)
 # COMMAND_ENABLE		= yes  # Commands for debug and configuration
 # SLEEP_LED_ENABLE = yes  # Breathing sleep LED during USB suspend
-# NKRO_ENABLE = yes	# USB Nkey Rollover - not yet supported in LUFA
+NKRO_ENABLE = yes	# USB Nkey Rollover, so that the keys of all keyboards together aren't cut to 6
 # BACKLIGHT_ENABLE = yes
 USB_HID_ENABLE = yes
 
@@ -21,15 +21,33 @@
   #include <avr/pgmspace.h>
   #include <avr/interrupt.h>
   #include <avr/io.h>
+  #include <util/atomic.h>
 #endif
 #include "print.h"
 #include "audio.h"
+#include "audio_queue.h"
 #include "keymap.h"
 #include "wait.h"
+#include "timer.h"
 
 #include "eeconfig.h"
 
-#define CPU_PRESCALER 8
+// Voices and vibrato keep changing the frequency of a note, which the main loop then keeps updating.
+// Without them the timer period of each note is computed once, and a held note needs no ISR at all
+#if defined(AUDIO_VOICES) || defined(VIBRATO_ENABLE)
+    #define AUDIO_MODULATION
+#endif
+
+// Song notes are queued in chunks of up to this many timer periods, so that their modulation
+// is updated along the way
+#ifdef AUDIO_MODULATION
+    #ifndef AUDIO_MODULATION_TICKS
+        #define AUDIO_MODULATION_TICKS 8
+    #endif
+    #define SONG_EVENT_TICKS AUDIO_MODULATION_TICKS
+#else
+    #define SONG_EVENT_TICKS 0xFFFF
+#endif
 
 // -----------------------------------------------------------------------------
 // Timer Abstractions
@@ -110,6 +128,34 @@
     #define TIMER_1_DUTY_CYCLE OCR1C
     #define TIMER1_AUDIO_vect TIMER1_COMPC_vect
 #endif
+
+// The queue plays songs and the newest note on timer 3, or on timer 1 when timer 3 has no pin.
+// When both have a pin, timer 1 plays the note before it and is set directly from the main loop.
+#if defined(CPIN_AUDIO)
+    #define ENABLE_QUEUE_ISR ENABLE_AUDIO_COUNTER_3_ISR
+    #define DISABLE_QUEUE_ISR DISABLE_AUDIO_COUNTER_3_ISR
+    #define ENABLE_QUEUE_OUTPUT ENABLE_AUDIO_COUNTER_3_OUTPUT
+    #define DISABLE_QUEUE_OUTPUT DISABLE_AUDIO_COUNTER_3_OUTPUT
+    #define QUEUE_TIMER_PERIOD TIMER_3_PERIOD
+    #define QUEUE_TIMER_DUTY_CYCLE TIMER_3_DUTY_CYCLE
+    #define QUEUE_AUDIO_vect TIMER3_AUDIO_vect
+    #if defined(BPIN_AUDIO)
+        #define ALT_PIN_AUDIO
+    #endif
+#elif defined(BPIN_AUDIO)
+    #define ENABLE_QUEUE_ISR ENABLE_AUDIO_COUNTER_1_ISR
+    #define DISABLE_QUEUE_ISR DISABLE_AUDIO_COUNTER_1_ISR
+    #define ENABLE_QUEUE_OUTPUT ENABLE_AUDIO_COUNTER_1_OUTPUT
+    #define DISABLE_QUEUE_OUTPUT DISABLE_AUDIO_COUNTER_1_OUTPUT
+    #define QUEUE_TIMER_PERIOD TIMER_1_PERIOD
+    #define QUEUE_TIMER_DUTY_CYCLE TIMER_1_DUTY_CYCLE
+    #define QUEUE_AUDIO_vect TIMER1_AUDIO_vect
+#else
+    #define ENABLE_QUEUE_ISR
+    #define DISABLE_QUEUE_ISR
+    #define ENABLE_QUEUE_OUTPUT
+    #define DISABLE_QUEUE_OUTPUT
+#endif
 // -----------------------------------------------------------------------------
 
 
@@ -121,6 +167,7 @@ int volume = 0;
 long position = 0;
 
 float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+uint16_t periods[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 bool sliding = false;
 
@@ -131,18 +178,17 @@ uint16_t sample_length = 0;
 
 bool     playing_notes = false;
 bool     playing_note = false;
-float    note_frequency = 0;
-float    note_length = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
 float    note_timbre = TIMBRE_DEFAULT;
-uint16_t note_position = 0;
-float (* notes_pointer)[][2];
-uint16_t notes_count;
-bool     notes_repeat;
-bool     note_resting = false;
 
-uint8_t current_note = 0;
-uint8_t rest_counter = 0;
+static note_sequence_t song;
+static bool song_finished = false; // All of its notes have been queued
+static bool song_queued = false;   // Its end has been queued too
+
+static audio_queue_t audio_queue;
+#ifdef AUDIO_MODULATION
+static uint16_t modulation_ticks = 0;
+#endif
 
 #ifdef VIBRATO_ENABLE
 float vibrato_counter = 0;
@@ -168,9 +214,13 @@ bool glissando = true;
 #ifndef AUDIO_OFF_SONG
     #define AUDIO_OFF_SONG SONG(AUDIO_OFF_SOUND)
 #endif
-float startup_song[][2] = STARTUP_SONG;
-float audio_on_song[][2] = AUDIO_ON_SONG;
-float audio_off_song[][2] = AUDIO_OFF_SONG;
+
+// The built in songs are stored in flash, as integer notes
+#undef MUSICAL_NOTE
+#define MUSICAL_NOTE(note, duration) FLASH_NOTE(note, duration)
+static const audio_note_t startup_song[] PROGMEM = STARTUP_SONG;
+static const audio_note_t audio_on_song[] PROGMEM = AUDIO_ON_SONG;
+static const audio_note_t audio_off_song[] PROGMEM = AUDIO_OFF_SONG;
 
 void audio_init()
 {
@@ -229,11 +279,21 @@ void audio_init()
     }
 
     if (audio_config.enable) {
-        PLAY_SONG(startup_song);
+        PLAY_SONG_P(startup_song);
     }
     
 }
 
+static void stop_outputs(void)
+{
+    DISABLE_QUEUE_ISR;
+    DISABLE_QUEUE_OUTPUT;
+    #ifdef ALT_PIN_AUDIO
+        DISABLE_AUDIO_COUNTER_1_OUTPUT;
+    #endif
+    audio_queue_clear(&audio_queue);
+}
+
 void stop_all_notes()
 {
     dprintf("audio stop all notes");
@@ -243,15 +303,7 @@ void stop_all_notes()
     }
     voices = 0;
 
-    #ifdef CPIN_AUDIO
-        DISABLE_AUDIO_COUNTER_3_ISR;
-        DISABLE_AUDIO_COUNTER_3_OUTPUT;
-    #endif
-
-    #ifdef BPIN_AUDIO
-        DISABLE_AUDIO_COUNTER_1_ISR;
-        DISABLE_AUDIO_COUNTER_1_OUTPUT;
-    #endif
+    stop_outputs();
 
     playing_notes = false;
     playing_note = false;
@@ -262,10 +314,13 @@ void stop_all_notes()
     for (uint8_t i = 0; i < 8; i++)
     {
         frequencies[i] = 0;
+        periods[i] = 0;
         volumes[i] = 0;
     }
 }
 
+static void update_notes(void);
+
 void stop_note(float freq)
 {
     dprintf("audio stop note freq=%d", (int)freq);
@@ -277,10 +332,13 @@ void stop_note(float freq)
         for (int i = 7; i >= 0; i--) {
             if (frequencies[i] == freq) {
                 frequencies[i] = 0;
+                periods[i] = 0;
                 volumes[i] = 0;
                 for (int j = i; (j < 7); j++) {
                     frequencies[j] = frequencies[j+1];
                     frequencies[j+1] = 0;
+                    periods[j] = periods[j+1];
+                    periods[j+1] = 0;
                     volumes[j] = volumes[j+1];
                     volumes[j+1] = 0;
                 }
@@ -294,18 +352,13 @@ void stop_note(float freq)
             voice_place = 0;
         }
         if (voices == 0) {
-            #ifdef CPIN_AUDIO
-                DISABLE_AUDIO_COUNTER_3_ISR;
-                DISABLE_AUDIO_COUNTER_3_OUTPUT;
-            #endif
-            #ifdef BPIN_AUDIO
-                DISABLE_AUDIO_COUNTER_1_ISR;
-                DISABLE_AUDIO_COUNTER_1_OUTPUT;
-            #endif
+            stop_outputs();
             frequency = 0;
             frequency_alt = 0;
             volume = 0;
             playing_note = false;
+        } else {
+            update_notes();
         }
     }
 }
@@ -318,340 +371,232 @@ float mod(float a, int b)
     return r < 0 ? r + b : r;
 }
 
-float vibrato(float average_freq) {
+// Moves the vibrato on by the timer periods the note has played since the last call
+float vibrato(float average_freq, uint16_t ticks) {
     #ifdef VIBRATO_STRENGTH_ENABLE
         float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
     #else
         float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
     #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
+    vibrato_counter = mod((vibrato_counter + ticks * vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
     return vibrated_freq;
 }
 
 #endif
 
-#ifdef CPIN_AUDIO
-ISR(TIMER3_AUDIO_vect)
+// Replaces whatever the queue timer plays with a note that is held until the next change
+static void hold_note(uint16_t period, uint16_t duty)
 {
-    float freq;
+    DISABLE_QUEUE_ISR;
+    audio_queue_clear(&audio_queue);
+    audio_queue_push(&audio_queue, period, duty, 0);
+    ENABLE_QUEUE_ISR;
+    ENABLE_QUEUE_OUTPUT;
+}
 
-    if (playing_note) {
-        if (voices > 0) {
+#ifdef AUDIO_MODULATION
+// Applies vibrato and the voice envelope, for a note that has played for a number of timer periods
+static float apply_modulation(float freq, uint16_t ticks) {
+    #ifdef VIBRATO_ENABLE
+        if (vibrato_strength > 0) {
+            freq = vibrato(freq, ticks);
+        }
+    #endif
 
-            #ifdef BPIN_AUDIO
-            float freq_alt = 0;
-                if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
-                        envelope_index++;
-                    }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq_alt * CPU_PRESCALER));
-                    TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq_alt * CPU_PRESCALER)) * note_timbre);
-                }
-            #endif
-
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
+    if (envelope_index < 65535 - ticks) {
+        envelope_index += ticks;
+    } else {
+        envelope_index = 65535;
+    }
+    return voice_envelope(freq);
+}
 
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
+static uint16_t timer_period(float freq, uint16_t *duty) {
+    if (freq < 30.517578125) {
+        freq = 30.52;
+    }
+    uint16_t period = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
+    *duty = (uint16_t)(period * note_timbre);
+    return period;
+}
 
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
+// Slides from one frequency towards another by a step for each timer period played since the last call
+static float glide(float from, float to, uint16_t ticks) {
+    if (!glissando) {
+        return to;
+    }
+    if (from != 0 && from < to && from < to * pow(2, -440/to/12/2)) {
+        from *= pow(2, ticks * 440/from/12/2);
+        return from < to ? from : to;
+    } else if (from != 0 && from > to && from > to * pow(2, 440/to/12/2)) {
+        from *= pow(2, -(ticks * 440/from/12/2));
+        return from > to ? from : to;
+    }
+    return to;
+}
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
+// Called from the main loop while notes are held, with the timer periods played since the last call
+static void update_notes(void)
+{
+    uint16_t played;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        played = audio_queue.ticks_played;
+    }
+    uint16_t ticks = played - modulation_ticks;
+    modulation_ticks = played;
 
-            freq = voice_envelope(freq);
+    float freq;
+    uint16_t period;
+    uint16_t duty;
+
+    #ifdef ALT_PIN_AUDIO
+        if (voices > 1 && polyphony_rate == 0) {
+            frequency_alt = glide(frequency_alt, frequencies[voices - 2], ticks);
+            // The vibrato and envelope are moved on once, by the newest note below
+            period = timer_period(apply_modulation(frequency_alt, 0), &duty);
+            TIMER_1_PERIOD = period;
+            TIMER_1_DUTY_CYCLE = duty;
+            ENABLE_AUDIO_COUNTER_1_OUTPUT;
+        } else {
+            DISABLE_AUDIO_COUNTER_1_OUTPUT;
+        }
+    #endif
 
-            if (freq < 30.517578125) {
-                freq = 30.52;
+    if (polyphony_rate > 0) {
+        if (voices > 1) {
+            voice_place %= voices;
+            place += ticks;
+            if (place > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
+                voice_place = (voice_place + 1) % voices;
+                place = 0.0;
             }
-
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
         }
+        freq = frequencies[voice_place];
+    } else {
+        frequency = glide(frequency, frequencies[voices - 1], ticks);
+        freq = frequency;
     }
 
-    if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
+    period = timer_period(apply_modulation(freq, ticks), &duty);
+    hold_note(period, duty);
+}
 
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+// Returns the timer period of the current song note, and sets the matching duty cycle
+static uint16_t song_period(uint16_t *duty) {
+    float freq = note_sequence_frequency(&song);
+    if (freq > 0) {
+        return timer_period(apply_modulation(freq, SONG_EVENT_TICKS), duty);
+    }
+    *duty = 0;
+    return 0;
+}
+#else
+static void update_notes(void)
+{
+    #ifdef ALT_PIN_AUDIO
+        if (voices > 1) {
+            TIMER_1_PERIOD = periods[voices - 2];
+            TIMER_1_DUTY_CYCLE = periods[voices - 2] / 2;
+            ENABLE_AUDIO_COUNTER_1_OUTPUT;
         } else {
-            TIMER_3_PERIOD = 0;
-            TIMER_3_DUTY_CYCLE = 0;
+            DISABLE_AUDIO_COUNTER_1_OUTPUT;
         }
+    #endif
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_3_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_3_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
+    hold_note(periods[voices - 1], periods[voices - 1] / 2);
+}
 
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_3_ISR;
-                    DISABLE_AUDIO_COUNTER_3_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
+static uint16_t song_period(uint16_t *duty) {
+    // The default voice always uses TIMBRE_50
+    *duty = song.period / 2;
+    return song.period;
+}
+#endif
 
-            note_position = 0;
+// Queues the upcoming notes of the song, and then an event that turns the output off
+static void queue_song(void)
+{
+    bool queued = false;
+    while (!song_queued && audio_queue_space(&audio_queue)) {
+        if (song_finished) {
+            audio_queue_push(&audio_queue, 0, 0, 0);
+            song_queued = true;
+        } else {
+            uint16_t duty;
+            uint16_t period = song_period(&duty);
+            switch (audio_queue_note(&audio_queue, &song, period, duty, SONG_EVENT_TICKS, note_tempo)) {
+                case NOTE_SEQUENCE_FINISHED:
+                    song_finished = true;
+                    break;
+                case NOTE_SEQUENCE_NEW_NOTE:
+                    envelope_index = 0;
+                    break;
+                default:
+                    break;
+            }
         }
+        queued = true;
     }
+    if (queued) {
+        // The ISR turns itself off when the queue runs dry
+        ENABLE_QUEUE_ISR;
+    }
+}
 
-    if (!audio_config.enable) {
-        playing_notes = false;
-        playing_note = false;
+#if defined(CPIN_AUDIO) || defined(BPIN_AUDIO)
+// Only applies what the main loop has queued, so it takes the same short time on every period
+ISR(QUEUE_AUDIO_vect)
+{
+    const audio_event_t *event = audio_queue_tick(&audio_queue);
+    if (event) {
+        if (event->period) {
+            QUEUE_TIMER_PERIOD = event->period;
+            QUEUE_TIMER_DUTY_CYCLE = event->duty;
+        } else {
+            DISABLE_QUEUE_ISR;
+            DISABLE_QUEUE_OUTPUT;
+        }
     }
+#ifndef AUDIO_MODULATION
+    else if (audio_queue_idle(&audio_queue)) {
+        // A held note plays on without the ISR
+        DISABLE_QUEUE_ISR;
+    }
+#endif
 }
 #endif
 
-#ifdef BPIN_AUDIO
-ISR(TIMER1_AUDIO_vect)
+void audio_task(void)
 {
-    #if defined(BPIN_AUDIO) && !defined(CPIN_AUDIO)
-    float freq = 0;
-
-    if (playing_note) {
-        if (voices > 0) {
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
+    if (!audio_initialized) {
+        return;
+    }
 
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+    if (!audio_config.enable) {
+        if (playing_notes || playing_note) {
+            stop_all_notes();
         }
+        return;
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
-        } else {
-            TIMER_1_PERIOD = 0;
-            TIMER_1_DUTY_CYCLE = 0;
+        bool idle;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            idle = audio_queue_idle(&audio_queue);
         }
-
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_1_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_1_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
+        if (song_queued && idle) {
+            playing_notes = false;
         } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_1_ISR;
-                    DISABLE_AUDIO_COUNTER_1_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+            queue_song();
         }
     }
 
-    if (!audio_config.enable) {
-        playing_notes = false;
-        playing_note = false;
-    }
-#endif
+    #ifdef AUDIO_MODULATION
+        if (playing_note && voices > 0) {
+            update_notes();
+        }
+    #endif
 }
-#endif
 
 void play_note(float freq, int vol) {
 
@@ -662,12 +607,6 @@ void play_note(float freq, int vol) {
     }
 
     if (audio_config.enable && voices < 8) {
-        #ifdef CPIN_AUDIO
-            DISABLE_AUDIO_COUNTER_3_ISR;
-        #endif
-        #ifdef BPIN_AUDIO
-            DISABLE_AUDIO_COUNTER_1_ISR;
-        #endif
 
         // Cancel notes if notes are playing
         if (playing_notes)
@@ -679,75 +618,62 @@ void play_note(float freq, int vol) {
 
         if (freq > 0) {
             frequencies[voices] = freq;
+            periods[voices] = NOTE_TIMER_PERIOD(freq);
             volumes[voices] = vol;
             voices++;
         }
 
-        #ifdef CPIN_AUDIO
-            ENABLE_AUDIO_COUNTER_3_ISR;
-            ENABLE_AUDIO_COUNTER_3_OUTPUT;
-        #endif
-        #ifdef BPIN_AUDIO
-            #ifdef CPIN_AUDIO
-            if (voices > 1) {
-                ENABLE_AUDIO_COUNTER_1_ISR;
-                ENABLE_AUDIO_COUNTER_1_OUTPUT;
-            }
-            #else
-            ENABLE_AUDIO_COUNTER_1_ISR;
-            ENABLE_AUDIO_COUNTER_1_OUTPUT;
-            #endif
-        #endif
+        if (voices > 0) {
+            update_notes();
+        }
     }
 
 }
 
-void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
+static bool begin_notes(void)
 {
 
     if (!audio_initialized) {
         audio_init();
     }
 
-    if (audio_config.enable) {
-
-        #ifdef CPIN_AUDIO
-            DISABLE_AUDIO_COUNTER_3_ISR;
-        #endif
-        #ifdef BPIN_AUDIO
-            DISABLE_AUDIO_COUNTER_1_ISR;
-        #endif
-
-        // Cancel note if a note is playing
-        if (playing_note)
-            stop_all_notes();
-
-        playing_notes = true;
+    if (!audio_config.enable) {
+        return false;
+    }
 
-        notes_pointer = np;
-        notes_count = n_count;
-        notes_repeat = n_repeat;
+    // Cancel note if a note is playing
+    if (playing_note)
+        stop_all_notes();
 
-        place = 0;
-        current_note = 0;
+    stop_outputs();
+    playing_notes = true;
+    song_finished = false;
+    song_queued = false;
 
-        note_frequency = (*notes_pointer)[current_note][0];
-        note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-        note_position = 0;
+    place = 0;
+    return true;
+}
 
+static void enable_notes_output(void)
+{
+    queue_song();
+    ENABLE_QUEUE_OUTPUT;
+}
 
-        #ifdef CPIN_AUDIO
-            ENABLE_AUDIO_COUNTER_3_ISR;
-            ENABLE_AUDIO_COUNTER_3_OUTPUT;
-        #endif
-        #ifdef BPIN_AUDIO
-            #ifndef CPIN_AUDIO
-            ENABLE_AUDIO_COUNTER_1_ISR;
-            ENABLE_AUDIO_COUNTER_1_OUTPUT;
-            #endif
-        #endif
+void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
+{
+    if (begin_notes()) {
+        note_sequence_start(&song, np, n_count, n_repeat, note_tempo);
+        enable_notes_output();
     }
+}
 
+void play_notes_P(const audio_note_t *np, uint16_t n_count, bool n_repeat)
+{
+    if (begin_notes()) {
+        note_sequence_start_P(&song, np, n_count, n_repeat, note_tempo);
+        enable_notes_output();
+    }
 }
 
 bool is_playing_notes(void) {
@@ -769,12 +695,16 @@ void audio_on(void) {
     audio_config.enable = 1;
     eeconfig_update_audio(audio_config.raw);
     audio_on_user();
-    PLAY_SONG(audio_on_song);
+    PLAY_SONG_P(audio_on_song);
 }
 
 void audio_off(void) {
-    PLAY_SONG(audio_off_song);
-    wait_ms(100);
+    PLAY_SONG_P(audio_off_song);
+    // Nothing else calls audio_task() while we wait, and it has to keep the song queued
+    uint16_t start = timer_read();
+    while (playing_notes && timer_elapsed(start) < 100) {
+        audio_task();
+    }
     stop_all_notes();
     audio_config.enable = 0;
     eeconfig_update_audio(audio_config.raw);
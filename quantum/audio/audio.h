@@ -25,6 +25,7 @@
 #include "musical_notes.h"
 #include "song_list.h"
 #include "voices.h"
+#include "note_engine.h"
 #include "quantum.h"
 #include <math.h>
 
@@ -82,6 +83,8 @@ void increase_tempo(uint8_t tempo_change);
 void decrease_tempo(uint8_t tempo_change);
 
 void audio_init(void);
+// Keeps the audio going, called from the main loop
+void audio_task(void);
 
 #ifdef PWM_AUDIO
 void play_sample(uint8_t * s, uint16_t l, bool r);
@@ -90,6 +93,10 @@ void play_note(float freq, int vol);
 void stop_note(float freq);
 void stop_all_notes(void);
 void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat);
+#if defined(__AVR__)
+// Plays a song of integer notes stored in flash, see FLASH_NOTE
+void play_notes_P(const audio_note_t *np, uint16_t n_count, bool n_repeat);
+#endif
 
 #define SCALE (int8_t []){ 0 + (12*0), 2 + (12*0), 4 + (12*0), 5 + (12*0), 7 + (12*0), 9 + (12*0), 11 + (12*0), \
                            0 + (12*1), 2 + (12*1), 4 + (12*1), 5 + (12*1), 7 + (12*1), 9 + (12*1), 11 + (12*1), \
@@ -105,6 +112,8 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat);
 	_Pragma ("message \"'PLAY_NOTE_ARRAY' macro is deprecated\"")
 #define PLAY_SONG(note_array) play_notes(&note_array, NOTE_ARRAY_SIZE((note_array)), false)
 #define PLAY_LOOP(note_array) play_notes(&note_array, NOTE_ARRAY_SIZE((note_array)), true)
+#define PLAY_SONG_P(note_array) play_notes_P(note_array, NOTE_ARRAY_SIZE((note_array)), false)
+#define PLAY_LOOP_P(note_array) play_notes_P(note_array, NOTE_ARRAY_SIZE((note_array)), true)
 
 bool is_playing_notes(void);
 
@@ -15,6 +15,7 @@
  */
 
 #include "audio.h"
+#include "synth.h"
 #include "ch.h"
 #include "hal.h"
 
@@ -77,185 +78,54 @@ bool glissando = true;
 #endif
 float startup_song[][2] = STARTUP_SONG;
 
-static void gpt_cb8(GPTDriver *gptp);
+#define DAC_BUFFER_SIZE (SYNTH_BLOCK_SIZE * 2)
 
-#define DAC_BUFFER_SIZE 360
-
-#define START_CHANNEL_1() gptStart(&GPTD6, &gpt6cfg1); \
-    gptStartContinuous(&GPTD6, 2U)
-#define START_CHANNEL_2() gptStart(&GPTD7, &gpt7cfg1); \
-    gptStartContinuous(&GPTD7, 2U)
-#define STOP_CHANNEL_1() gptStopTimer(&GPTD6)
-#define STOP_CHANNEL_2() gptStopTimer(&GPTD7)
-#define RESTART_CHANNEL_1() STOP_CHANNEL_1(); \
-    START_CHANNEL_1()
-#define RESTART_CHANNEL_2() STOP_CHANNEL_2(); \
-    START_CHANNEL_2()
-#define UPDATE_CHANNEL_1_FREQ(freq) gpt6cfg1.frequency = freq * DAC_BUFFER_SIZE; \
-    RESTART_CHANNEL_1()
-#define UPDATE_CHANNEL_2_FREQ(freq) gpt7cfg1.frequency = freq * DAC_BUFFER_SIZE; \
-    RESTART_CHANNEL_2()
-#define GET_CHANNEL_1_FREQ gpt6cfg1.frequency
-#define GET_CHANNEL_2_FREQ gpt7cfg1.frequency
+// Blocks in a note length of 1, which lasts as long as on AVR: 0xFFFF counts of its 2MHz timer
+#define NOTE_LENGTH_BLOCKS ((0xFFFF / 2000000.0f) * SYNTH_SAMPLE_RATE / SYNTH_BLOCK_SIZE)
 
+#define BLOCKS_PER_SECOND (SYNTH_SAMPLE_RATE / SYNTH_BLOCK_SIZE)
 
 /*
- * GPT6 configuration.
+ * GPT6 configuration, it triggers the DAC at the sample rate.
+ * The sample rate never changes, all voices are mixed in software.
  */
-// static const GPTConfig gpt6cfg1 = {
-//   .frequency    = 1000000U,
-//   .callback     = NULL,
-//   .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
-//   .dier         = 0U
-// };
-
-GPTConfig gpt6cfg1 = {
-  .frequency    = 440U*DAC_BUFFER_SIZE,
-  .callback     = NULL,
-  .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
-  .dier         = 0U
-};
-
-GPTConfig gpt7cfg1 = {
-  .frequency    = 440U*DAC_BUFFER_SIZE,
+static const GPTConfig gpt6cfg1 = {
+  .frequency    = SYNTH_SAMPLE_RATE * 2U,
   .callback     = NULL,
   .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
   .dier         = 0U
 };
 
-GPTConfig gpt8cfg1 = {
-  .frequency    = 10,
-  .callback     = gpt_cb8,
-  .cr2          = TIM_CR2_MMS_1,    /* MMS = 010 = TRGO on Update Event.    */
-  .dier         = 0U
-};
-
-
 /*
- * DAC test buffer (sine wave).
+ * Circular DAC buffers, one half is rendered while the other one is played.
+ * DAC2 plays the mix inverted, so a speaker between A4 and A5 gets twice the swing.
  */
-// static const dacsample_t dac_buffer[DAC_BUFFER_SIZE] = {
-//   2047, 2082, 2118, 2154, 2189, 2225, 2260, 2296, 2331, 2367, 2402, 2437,
-//   2472, 2507, 2542, 2576, 2611, 2645, 2679, 2713, 2747, 2780, 2813, 2846,
-//   2879, 2912, 2944, 2976, 3008, 3039, 3070, 3101, 3131, 3161, 3191, 3221,
-//   3250, 3278, 3307, 3335, 3362, 3389, 3416, 3443, 3468, 3494, 3519, 3544,
-//   3568, 3591, 3615, 3637, 3660, 3681, 3703, 3723, 3744, 3763, 3782, 3801,
-//   3819, 3837, 3854, 3870, 3886, 3902, 3917, 3931, 3944, 3958, 3970, 3982,
-//   3993, 4004, 4014, 4024, 4033, 4041, 4049, 4056, 4062, 4068, 4074, 4078,
-//   4082, 4086, 4089, 4091, 4092, 4093, 4094, 4093, 4092, 4091, 4089, 4086,
-//   4082, 4078, 4074, 4068, 4062, 4056, 4049, 4041, 4033, 4024, 4014, 4004,
-//   3993, 3982, 3970, 3958, 3944, 3931, 3917, 3902, 3886, 3870, 3854, 3837,
-//   3819, 3801, 3782, 3763, 3744, 3723, 3703, 3681, 3660, 3637, 3615, 3591,
-//   3568, 3544, 3519, 3494, 3468, 3443, 3416, 3389, 3362, 3335, 3307, 3278,
-//   3250, 3221, 3191, 3161, 3131, 3101, 3070, 3039, 3008, 2976, 2944, 2912,
-//   2879, 2846, 2813, 2780, 2747, 2713, 2679, 2645, 2611, 2576, 2542, 2507,
-//   2472, 2437, 2402, 2367, 2331, 2296, 2260, 2225, 2189, 2154, 2118, 2082,
-//   2047, 2012, 1976, 1940, 1905, 1869, 1834, 1798, 1763, 1727, 1692, 1657,
-//   1622, 1587, 1552, 1518, 1483, 1449, 1415, 1381, 1347, 1314, 1281, 1248,
-//   1215, 1182, 1150, 1118, 1086, 1055, 1024,  993,  963,  933,  903,  873,
-//    844,  816,  787,  759,  732,  705,  678,  651,  626,  600,  575,  550,
-//    526,  503,  479,  457,  434,  413,  391,  371,  350,  331,  312,  293,
-//    275,  257,  240,  224,  208,  192,  177,  163,  150,  136,  124,  112,
-//    101,   90,   80,   70,   61,   53,   45,   38,   32,   26,   20,   16,
-//     12,    8,    5,    3,    2,    1,    0,    1,    2,    3,    5,    8,
-//     12,   16,   20,   26,   32,   38,   45,   53,   61,   70,   80,   90,
-//    101,  112,  124,  136,  150,  163,  177,  192,  208,  224,  240,  257,
-//    275,  293,  312,  331,  350,  371,  391,  413,  434,  457,  479,  503,
-//    526,  550,  575,  600,  626,  651,  678,  705,  732,  759,  787,  816,
-//    844,  873,  903,  933,  963,  993, 1024, 1055, 1086, 1118, 1150, 1182,
-//   1215, 1248, 1281, 1314, 1347, 1381, 1415, 1449, 1483, 1518, 1552, 1587,
-//   1622, 1657, 1692, 1727, 1763, 1798, 1834, 1869, 1905, 1940, 1976, 2012
-// };
-
-// squarewave
-static const dacsample_t dac_buffer[DAC_BUFFER_SIZE] = {
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-};
+static dacsample_t dac_buffer[DAC_BUFFER_SIZE];
+static dacsample_t dac_buffer_2[DAC_BUFFER_SIZE];
 
-// squarewave
-static const dacsample_t dac_buffer_2[DAC_BUFFER_SIZE] = {
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-  2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047, 2047,
-
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-};
+// Blocks rendered so far, the main loop moves the notes on by the ones it has not seen yet
+static volatile uint16_t blocks_rendered = 0;
+static uint16_t blocks_updated = 0;
+
+static void render_block(dacsample_t *buffer, size_t n) {
+  dacsample_t *inverted = dac_buffer_2 + (buffer - dac_buffer);
+
+  synth_render(buffer, n);
+  for (size_t i = 0; i < n; i++) {
+    inverted[i] = SYNTH_SAMPLE_MAX - buffer[i];
+  }
+}
 
 /*
- * DAC streaming callback.
+ * DAC streaming callback, called each time one half of the buffer has been played.
+ * It only renders what the main loop has set up, the voices are changed from audio_task().
  */
-size_t nx = 0, ny = 0, nz = 0;
 static void end_cb1(DACDriver *dacp, dacsample_t *buffer, size_t n) {
 
   (void)dacp;
 
-  nz++;
-  if (dac_buffer == buffer) {
-    nx += n;
-  }
-  else {
-    ny += n;
-  }
-
-  if ((nz % 1000) == 0) {
-    // palTogglePad(GPIOD, GPIOD_LED3);
-  }
+  render_block(buffer, n);
+  blocks_rendered++;
 }
 
 /*
@@ -270,7 +140,7 @@ static void error_cb1(DACDriver *dacp, dacerror_t err) {
 }
 
 static const DACConfig dac1cfg1 = {
-  .init         = 2047U,
+  .init         = SYNTH_SAMPLE_MIDPOINT,
   .datamode     = DAC_DHRM_12BIT_RIGHT
 };
 
@@ -282,13 +152,16 @@ static const DACConversionGroup dacgrpcfg1 = {
 };
 
 static const DACConfig dac1cfg2 = {
-  .init         = 2047U,
+  .init         = SYNTH_SAMPLE_MIDPOINT,
   .datamode     = DAC_DHRM_12BIT_RIGHT
 };
 
+/*
+ * DAC2 is triggered by the same timer, so it stays in step with DAC1 and needs no callback.
+ */
 static const DACConversionGroup dacgrpcfg2 = {
   .num_channels = 1U,
-  .end_cb       = end_cb1,
+  .end_cb       = NULL,
   .error_cb     = error_cb1,
   .trigger      = DAC_TRG(0)
 };
@@ -307,6 +180,9 @@ void audio_init()
     // audio_config.raw = eeconfig_read_audio();
     audio_config.enable = true;
 
+    synth_init();
+    render_block(dac_buffer, DAC_BUFFER_SIZE);
+
   /*
    * Starting DAC1 driver, setting up the output pin as analog as suggested
    * by the Reference Manual.
@@ -319,18 +195,15 @@ void audio_init()
   /*
    * Starting GPT6 driver, it is used for triggering the DAC.
    */
-  START_CHANNEL_1();
-  START_CHANNEL_2();
+  gptStart(&GPTD6, &gpt6cfg1);
+  gptStartContinuous(&GPTD6, 2U);
 
   /*
-   * Starting a continuous conversion.
+   * Starting continuous conversions, which keep running and play silence
+   * when no voices are on.
    */
-  dacStartConversion(&DACD1, &dacgrpcfg1,
-                     (dacsample_t *)dac_buffer, DAC_BUFFER_SIZE);
-  dacStartConversion(&DACD2, &dacgrpcfg2,
-                     (dacsample_t *)dac_buffer_2, DAC_BUFFER_SIZE);
-  // gptStartContinuous(&GPTD6, 2U);
-
+  dacStartConversion(&DACD2, &dacgrpcfg2, dac_buffer_2, DAC_BUFFER_SIZE);
+  dacStartConversion(&DACD1, &dacgrpcfg1, dac_buffer, DAC_BUFFER_SIZE);
 
     audio_initialized = true;
 
@@ -340,6 +213,13 @@ void audio_init()
 
 }
 
+// The mixer is only changed with the DAC callback held off, so that a block is rendered with whole settings
+static void stop_voices(void) {
+    chSysLock();
+    synth_stop_all();
+    chSysUnlock();
+}
+
 void stop_all_notes()
 {
     dprintf("audio stop all notes");
@@ -347,11 +227,8 @@ void stop_all_notes()
     if (!audio_initialized) {
         audio_init();
     }
-    voices = 0;
 
-    gptStopTimer(&GPTD6);
-    gptStopTimer(&GPTD7);
-    gptStopTimer(&GPTD8);
+    voices = 0;
 
     playing_notes = false;
     playing_note = false;
@@ -364,6 +241,7 @@ void stop_all_notes()
         frequencies[i] = 0;
         volumes[i] = 0;
     }
+    stop_voices();
 }
 
 void stop_note(float freq)
@@ -394,9 +272,7 @@ void stop_note(float freq)
             voice_place = 0;
         }
         if (voices == 0) {
-            STOP_CHANNEL_1();
-            STOP_CHANNEL_2();
-            gptStopTimer(&GPTD8);
+            stop_voices();
             frequency = 0;
             frequency_alt = 0;
             volume = 0;
@@ -413,205 +289,148 @@ float mod(float a, int b)
     return r < 0 ? r + b : r;
 }
 
-float vibrato(float average_freq) {
+// Moves the vibrato on by the blocks rendered since the last call
+float vibrato(float average_freq, uint16_t blocks) {
     #ifdef VIBRATO_STRENGTH_ENABLE
         float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
     #else
         float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
     #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
+    vibrato_counter = mod((vibrato_counter + blocks * vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
     return vibrated_freq;
 }
 
 #endif
 
-static void gpt_cb8(GPTDriver *gptp) {
-    float freq;
-
-    if (playing_note) {
-        if (voices > 0) {
-
-            float freq_alt = 0;
-                if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
-                        envelope_index++;
-                    }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    if (GET_CHANNEL_2_FREQ != (uint16_t)freq_alt) {
-                        UPDATE_CHANNEL_2_FREQ(freq_alt);
-                    }
-                    //note_timbre;
-                }
-
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
+// The envelopes in voices.c count periods of the note, as they were written for a timer
+// interrupt that ran once per period. A block holds several, and the fraction is carried over.
+static float envelope_fraction = 0;
 
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
+static void advance_envelope(float freq, uint16_t blocks) {
+    float periods = envelope_fraction + freq * blocks * SYNTH_BLOCK_SIZE / SYNTH_SAMPLE_RATE;
+    uint16_t whole = (uint16_t)periods;
+    envelope_fraction = periods - whole;
+    envelope_index = (envelope_index > 65535 - whole) ? 65535 : envelope_index + whole;
+}
 
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
+// Applies vibrato and the voice envelope to a frequency, and hands it to the mixer
+static void play_voice(uint8_t voice, float freq, int16_t amplitude, uint16_t blocks) {
+    #ifdef VIBRATO_ENABLE
+        if (vibrato_strength > 0) {
+            freq = vibrato(freq, blocks);
+        }
+    #endif
 
-            freq = voice_envelope(freq);
+    freq = voice_envelope(freq);
+    chSysLock();
+    synth_voice_set(voice, freq, note_timbre, amplitude);
+    chSysUnlock();
+}
 
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
+static void stop_voice(uint8_t voice) {
+    chSysLock();
+    synth_voice_stop(voice);
+    chSysUnlock();
+}
 
+// Slides from one frequency towards another by a step for each block rendered since the last call
+static float glide(float from, float to, uint16_t blocks) {
+    if (!glissando) {
+        return to;
+    }
+    if (from != 0 && from < to && from < to * pow(2, -440/to/12/2)) {
+        from *= pow(2, blocks * 440/from/12/2);
+        return from < to ? from : to;
+    } else if (from != 0 && from > to && from > to * pow(2, 440/to/12/2)) {
+        from *= pow(2, -(blocks * 440/from/12/2));
+        return from > to ? from : to;
+    }
+    return to;
+}
 
-            if (GET_CHANNEL_1_FREQ != (uint16_t)freq) {
-                UPDATE_CHANNEL_1_FREQ(freq);
+static void update_notes(uint16_t blocks) {
+    if (polyphony_rate > 0) {
+        // Cycle through the held notes on a single voice, polyphony_rate times a second
+        if (voices > 1) {
+            voice_place %= voices;
+            place += blocks;
+            if (place > (BLOCKS_PER_SECOND / polyphony_rate)) {
+                voice_place = (voice_place + 1) % voices;
+                place = 0.0;
             }
-            //note_timbre;
         }
+        advance_envelope(frequencies[voice_place], blocks);
+        play_voice(0, frequencies[voice_place], SYNTH_AMPLITUDE_MAX, blocks);
+        for (uint8_t i = 1; i < SYNTH_VOICES; i++) {
+            stop_voice(i);
+        }
+        return;
     }
 
-    if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
+    // The newest note slides to its pitch, the others are played as they are
+    frequency = glide(frequency, frequencies[voices - 1], blocks);
+    advance_envelope(frequency, blocks);
 
-
-            if (GET_CHANNEL_1_FREQ != (uint16_t)freq) {
-                UPDATE_CHANNEL_1_FREQ(freq);
-                UPDATE_CHANNEL_2_FREQ(freq);
-            }
-            //note_timbre;
+    int16_t amplitude = SYNTH_AMPLITUDE_MAX / voices;
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (i < voices - 1) {
+            play_voice(i, frequencies[i], amplitude, blocks);
+        } else if (i == voices - 1) {
+            play_voice(i, frequency, amplitude, blocks);
         } else {
-            // gptStopTimer(&GPTD6);
-            // gptStopTimer(&GPTD7);
+            stop_voice(i);
         }
+    }
+}
 
-        note_position++;
-        bool end_of_note = false;
-        if (GET_CHANNEL_1_FREQ > 0) {
-            if (!note_resting)
-                end_of_note = (note_position >= (note_length*16 - 1));
-            else
-                end_of_note = (note_position >= (note_length*16));
-        } else {
-            end_of_note = (note_position >= (note_length*16));
-        }
+static void update_song(uint16_t blocks) {
+    if (note_frequency > 0) {
+        advance_envelope(note_frequency, blocks);
+        play_voice(0, note_frequency, SYNTH_AMPLITUDE_MAX, blocks);
+    } else {
+        stop_voice(0);
+    }
 
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    STOP_CHANNEL_1();
-                    STOP_CHANNEL_2();
-                    // gptStopTimer(&GPTD8);
-                    playing_notes = false;
-                    return;
-                }
+    // The gap between two notes lasts a single block
+    note_position += blocks;
+    bool end_of_note;
+    if (note_resting) {
+        end_of_note = (note_position >= 1);
+    } else {
+        end_of_note = (note_position >= (note_length * NOTE_LENGTH_BLOCKS));
+    }
+
+    if (end_of_note) {
+        current_note++;
+        if (current_note >= notes_count) {
+            if (notes_repeat) {
+                current_note = 0;
+            } else {
+                stop_voices();
+                playing_notes = false;
+                return;
             }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
+        }
+        if (!note_resting) {
+            note_resting = true;
+            current_note--;
+            if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
+                note_frequency = 0;
             } else {
-                note_resting = false;
-                envelope_index = 0;
                 note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
             }
-
-            note_position = 0;
+        } else {
+            note_resting = false;
+            envelope_index = 0;
+            note_frequency = (*notes_pointer)[current_note][0];
+            note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
         }
-    }
 
-    if (!audio_config.enable) {
-        playing_notes = false;
-        playing_note = false;
+        note_position = 0;
     }
 }
 
+
 void play_note(float freq, int vol) {
 
     dprintf("audio play note freq=%d vol=%d", (int)freq, vol);
@@ -635,11 +454,6 @@ void play_note(float freq, int vol) {
             volumes[voices] = vol;
             voices++;
         }
-
-        gptStart(&GPTD8, &gpt8cfg1);
-        gptStartContinuous(&GPTD8, 2U);
-        RESTART_CHANNEL_1();
-        RESTART_CHANNEL_2();
     }
 
 }
@@ -669,13 +483,33 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
         note_frequency = (*notes_pointer)[current_note][0];
         note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
         note_position = 0;
+        note_resting = false;
+        envelope_index = 0;
+    }
+
+}
 
-        gptStart(&GPTD8, &gpt8cfg1);
-        gptStartContinuous(&GPTD8, 2U);
-        RESTART_CHANNEL_1();
-        RESTART_CHANNEL_2();
+// Moves the notes on by the blocks the DAC callback has rendered since the last call, and sets
+// up the mixer for the next ones. All of the float work happens here, in the main loop.
+void audio_task(void) {
+    uint16_t blocks = blocks_rendered - blocks_updated;
+    if (!blocks) {
+        return;
     }
+    blocks_updated += blocks;
 
+    if (!audio_config.enable) {
+        playing_notes = false;
+        playing_note = false;
+    }
+
+    if (playing_note && voices > 0) {
+        update_notes(blocks);
+    } else if (playing_notes) {
+        update_song(blocks);
+    } else if (synth_is_active()) {
+        stop_voices();
+    }
 }
 
 bool is_playing_notes(void) {
@@ -0,0 +1,54 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audio_queue.h"
+
+void audio_queue_clear(audio_queue_t* q) {
+    q->head = 0;
+    q->tail = 0;
+    q->ticks_left = 0;
+}
+
+uint8_t audio_queue_space(audio_queue_t* q) {
+    // One slot stays empty, to tell a full queue from an empty one
+    return AUDIO_QUEUE_MASK - ((q->tail - q->head) & AUDIO_QUEUE_MASK);
+}
+
+bool audio_queue_push(audio_queue_t* q, uint16_t period, uint16_t duty, uint16_t ticks) {
+    if (!audio_queue_space(q)) {
+        return false;
+    }
+    uint8_t tail = q->tail;
+    q->events[tail].period = period;
+    q->events[tail].duty = duty;
+    q->events[tail].ticks = ticks;
+    // Publish the event only once it is complete
+    q->tail = (tail + 1) & AUDIO_QUEUE_MASK;
+    return true;
+}
+
+note_sequence_state_t audio_queue_note(audio_queue_t* q, note_sequence_t* seq, uint16_t period, uint16_t duty, uint16_t max_ticks, uint8_t tempo) {
+    uint32_t ticks = note_sequence_ticks(seq, period);
+    if (ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+    if (period > 0) {
+        audio_queue_push(q, period, duty, ticks);
+    } else {
+        audio_queue_push(q, AUDIO_QUEUE_SILENCE, 0, ticks);
+    }
+    return note_sequence_skip(seq, period, ticks, tempo);
+}
@@ -0,0 +1,105 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUDIO_QUEUE_H
+#define AUDIO_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "note_engine.h"
+
+// Upcoming changes of the audio timer, computed ahead of time by the main loop so that
+// the timer ISR only has to count periods and copy the next period and duty cycle.
+
+// Must be a power of two
+#ifndef AUDIO_QUEUE_LENGTH
+    #define AUDIO_QUEUE_LENGTH 8
+#endif
+
+#define AUDIO_QUEUE_MASK (AUDIO_QUEUE_LENGTH - 1)
+
+// Rests are played as the longest timer period with the output kept low
+#define AUDIO_QUEUE_SILENCE 0xFFFF
+
+typedef struct {
+    uint16_t period; // 0 turns the output off
+    uint16_t duty;
+    uint16_t ticks;  // Timer periods to play it for, 0 holds it until the next event
+} audio_event_t;
+
+typedef struct {
+    audio_event_t events[AUDIO_QUEUE_LENGTH];
+    volatile uint8_t head; // Only written by the ISR
+    volatile uint8_t tail; // Only written by the main loop
+    // Written by the ISR, the main loop has to read it with the ISR held off
+    volatile uint16_t ticks_left;
+    volatile uint16_t ticks_played;
+    volatile uint8_t underruns;
+} audio_queue_t;
+
+// The host tests count the steps the ISR takes, to check that its work per call is bounded
+#ifdef AUDIO_QUEUE_COUNT_STEPS
+    extern uint16_t audio_queue_steps;
+    #define AUDIO_QUEUE_STEP() (audio_queue_steps++)
+#else
+    #define AUDIO_QUEUE_STEP()
+#endif
+
+// The most steps audio_queue_tick() takes in one call
+#define AUDIO_QUEUE_MAX_STEPS 3
+
+// The ISR has to be disabled while the queue is cleared
+void audio_queue_clear(audio_queue_t* q);
+uint8_t audio_queue_space(audio_queue_t* q);
+bool audio_queue_push(audio_queue_t* q, uint16_t period, uint16_t duty, uint16_t ticks);
+// Queues the current note of a song for up to max_ticks timer periods, and advances the song past them
+note_sequence_state_t audio_queue_note(audio_queue_t* q, note_sequence_t* seq, uint16_t period, uint16_t duty, uint16_t max_ticks, uint8_t tempo);
+
+// True when the last event has been applied and has no ticks left.
+// Outside of the ISR it has to be called from an atomic block.
+static inline bool audio_queue_idle(audio_queue_t* q) {
+    return q->head == q->tail && q->ticks_left == 0;
+}
+
+// Called from the timer ISR once per period, returns the event to apply or NULL to keep the current one.
+// Takes the same few steps on every call, whatever is in the queue.
+static inline const audio_event_t* audio_queue_tick(audio_queue_t* q) {
+    AUDIO_QUEUE_STEP();
+    q->ticks_played++;
+    uint16_t ticks_left = q->ticks_left;
+    if (ticks_left > 1) {
+        q->ticks_left = ticks_left - 1;
+        return NULL;
+    }
+    AUDIO_QUEUE_STEP();
+    uint8_t head = q->head;
+    if (head == q->tail) {
+        if (ticks_left) {
+            // The main loop fell behind, keep playing the current event until it catches up
+            AUDIO_QUEUE_STEP();
+            q->ticks_left = 0;
+            q->underruns++;
+        }
+        return NULL;
+    }
+    AUDIO_QUEUE_STEP();
+    const audio_event_t* event = &q->events[head];
+    q->head = (head + 1) & AUDIO_QUEUE_MASK;
+    q->ticks_left = event->ticks;
+    return event;
+}
+
+#endif
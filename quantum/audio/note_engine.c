@@ -0,0 +1,170 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "note_engine.h"
+#include "progmem.h"
+
+// Timer periods of all MIDI notes, 440 * 2^((n - 69) / 12) Hz
+static const uint16_t note_period_table[NOTE_TIMER_PERIOD_TABLE_LENGTH] PROGMEM = {
+    NOTE_TIMER_PERIOD(8.1758f), NOTE_TIMER_PERIOD(8.6620f), NOTE_TIMER_PERIOD(9.1770f), NOTE_TIMER_PERIOD(9.7227f),
+    NOTE_TIMER_PERIOD(10.3009f), NOTE_TIMER_PERIOD(10.9134f), NOTE_TIMER_PERIOD(11.5623f), NOTE_TIMER_PERIOD(12.2499f),
+    NOTE_TIMER_PERIOD(12.9783f), NOTE_TIMER_PERIOD(13.7500f), NOTE_TIMER_PERIOD(14.5676f), NOTE_TIMER_PERIOD(15.4339f),
+    NOTE_TIMER_PERIOD(16.3516f), NOTE_TIMER_PERIOD(17.3239f), NOTE_TIMER_PERIOD(18.3540f), NOTE_TIMER_PERIOD(19.4454f),
+    NOTE_TIMER_PERIOD(20.6017f), NOTE_TIMER_PERIOD(21.8268f), NOTE_TIMER_PERIOD(23.1247f), NOTE_TIMER_PERIOD(24.4997f),
+    NOTE_TIMER_PERIOD(25.9565f), NOTE_TIMER_PERIOD(27.5000f), NOTE_TIMER_PERIOD(29.1352f), NOTE_TIMER_PERIOD(30.8677f),
+    NOTE_TIMER_PERIOD(32.7032f), NOTE_TIMER_PERIOD(34.6478f), NOTE_TIMER_PERIOD(36.7081f), NOTE_TIMER_PERIOD(38.8909f),
+    NOTE_TIMER_PERIOD(41.2034f), NOTE_TIMER_PERIOD(43.6535f), NOTE_TIMER_PERIOD(46.2493f), NOTE_TIMER_PERIOD(48.9994f),
+    NOTE_TIMER_PERIOD(51.9131f), NOTE_TIMER_PERIOD(55.0000f), NOTE_TIMER_PERIOD(58.2705f), NOTE_TIMER_PERIOD(61.7354f),
+    NOTE_TIMER_PERIOD(65.4064f), NOTE_TIMER_PERIOD(69.2957f), NOTE_TIMER_PERIOD(73.4162f), NOTE_TIMER_PERIOD(77.7817f),
+    NOTE_TIMER_PERIOD(82.4069f), NOTE_TIMER_PERIOD(87.3071f), NOTE_TIMER_PERIOD(92.4986f), NOTE_TIMER_PERIOD(97.9989f),
+    NOTE_TIMER_PERIOD(103.8262f), NOTE_TIMER_PERIOD(110.0000f), NOTE_TIMER_PERIOD(116.5409f), NOTE_TIMER_PERIOD(123.4708f),
+    NOTE_TIMER_PERIOD(130.8128f), NOTE_TIMER_PERIOD(138.5913f), NOTE_TIMER_PERIOD(146.8324f), NOTE_TIMER_PERIOD(155.5635f),
+    NOTE_TIMER_PERIOD(164.8138f), NOTE_TIMER_PERIOD(174.6141f), NOTE_TIMER_PERIOD(184.9972f), NOTE_TIMER_PERIOD(195.9977f),
+    NOTE_TIMER_PERIOD(207.6523f), NOTE_TIMER_PERIOD(220.0000f), NOTE_TIMER_PERIOD(233.0819f), NOTE_TIMER_PERIOD(246.9417f),
+    NOTE_TIMER_PERIOD(261.6256f), NOTE_TIMER_PERIOD(277.1826f), NOTE_TIMER_PERIOD(293.6648f), NOTE_TIMER_PERIOD(311.1270f),
+    NOTE_TIMER_PERIOD(329.6276f), NOTE_TIMER_PERIOD(349.2282f), NOTE_TIMER_PERIOD(369.9944f), NOTE_TIMER_PERIOD(391.9954f),
+    NOTE_TIMER_PERIOD(415.3047f), NOTE_TIMER_PERIOD(440.0000f), NOTE_TIMER_PERIOD(466.1638f), NOTE_TIMER_PERIOD(493.8833f),
+    NOTE_TIMER_PERIOD(523.2511f), NOTE_TIMER_PERIOD(554.3653f), NOTE_TIMER_PERIOD(587.3295f), NOTE_TIMER_PERIOD(622.2540f),
+    NOTE_TIMER_PERIOD(659.2551f), NOTE_TIMER_PERIOD(698.4565f), NOTE_TIMER_PERIOD(739.9888f), NOTE_TIMER_PERIOD(783.9909f),
+    NOTE_TIMER_PERIOD(830.6094f), NOTE_TIMER_PERIOD(880.0000f), NOTE_TIMER_PERIOD(932.3275f), NOTE_TIMER_PERIOD(987.7666f),
+    NOTE_TIMER_PERIOD(1046.5023f), NOTE_TIMER_PERIOD(1108.7305f), NOTE_TIMER_PERIOD(1174.6591f), NOTE_TIMER_PERIOD(1244.5079f),
+    NOTE_TIMER_PERIOD(1318.5102f), NOTE_TIMER_PERIOD(1396.9129f), NOTE_TIMER_PERIOD(1479.9777f), NOTE_TIMER_PERIOD(1567.9817f),
+    NOTE_TIMER_PERIOD(1661.2188f), NOTE_TIMER_PERIOD(1760.0000f), NOTE_TIMER_PERIOD(1864.6550f), NOTE_TIMER_PERIOD(1975.5332f),
+    NOTE_TIMER_PERIOD(2093.0045f), NOTE_TIMER_PERIOD(2217.4610f), NOTE_TIMER_PERIOD(2349.3181f), NOTE_TIMER_PERIOD(2489.0159f),
+    NOTE_TIMER_PERIOD(2637.0205f), NOTE_TIMER_PERIOD(2793.8259f), NOTE_TIMER_PERIOD(2959.9554f), NOTE_TIMER_PERIOD(3135.9635f),
+    NOTE_TIMER_PERIOD(3322.4376f), NOTE_TIMER_PERIOD(3520.0000f), NOTE_TIMER_PERIOD(3729.3101f), NOTE_TIMER_PERIOD(3951.0664f),
+    NOTE_TIMER_PERIOD(4186.0090f), NOTE_TIMER_PERIOD(4434.9221f), NOTE_TIMER_PERIOD(4698.6363f), NOTE_TIMER_PERIOD(4978.0317f),
+    NOTE_TIMER_PERIOD(5274.0409f), NOTE_TIMER_PERIOD(5587.6517f), NOTE_TIMER_PERIOD(5919.9108f), NOTE_TIMER_PERIOD(6271.9270f),
+    NOTE_TIMER_PERIOD(6644.8752f), NOTE_TIMER_PERIOD(7040.0000f), NOTE_TIMER_PERIOD(7458.6202f), NOTE_TIMER_PERIOD(7902.1328f),
+    NOTE_TIMER_PERIOD(8372.0181f), NOTE_TIMER_PERIOD(8869.8442f), NOTE_TIMER_PERIOD(9397.2726f), NOTE_TIMER_PERIOD(9956.0635f),
+    NOTE_TIMER_PERIOD(10548.0818f), NOTE_TIMER_PERIOD(11175.3034f), NOTE_TIMER_PERIOD(11839.8215f), NOTE_TIMER_PERIOD(12543.8540f),
+};
+
+uint16_t note_period(uint8_t note) {
+    if (note == 0 || note >= NOTE_TIMER_PERIOD_TABLE_LENGTH) {
+        return 0;
+    }
+    return pgm_read_word(&note_period_table[note]);
+}
+
+static uint16_t load_period(note_sequence_t* seq, uint16_t index) {
+    if (seq->float_notes) {
+        float freq = (*seq->float_notes)[index][0];
+        return freq > 0 ? NOTE_TIMER_PERIOD(freq) : 0;
+    }
+    return note_period(pgm_read_byte(&seq->notes[index].note));
+}
+
+static void load_note(note_sequence_t* seq, uint8_t tempo) {
+    seq->period = load_period(seq, seq->current);
+    seq->elapsed = 0;
+    // A whole note of 64 lasts 16 * 0xFFFF timer counts at the default tempo of 100
+    if (seq->float_notes) {
+        float duration = (*seq->float_notes)[seq->current][1];
+        seq->length = (uint32_t)((duration / 4) * (((float)tempo) / 100) * 0xFFFF);
+    } else {
+        uint8_t duration = pgm_read_byte(&seq->notes[seq->current].duration);
+        seq->length = ((uint32_t)duration * tempo * 0xFFFF) / 400;
+    }
+}
+
+static void start(note_sequence_t* seq, uint16_t count, bool repeat, uint8_t tempo) {
+    seq->count = count;
+    seq->repeat = repeat;
+    seq->current = 0;
+    seq->resting = false;
+    load_note(seq, tempo);
+}
+
+void note_sequence_start_P(note_sequence_t* seq, const audio_note_t* notes, uint16_t count, bool repeat, uint8_t tempo) {
+    seq->notes = notes;
+    seq->float_notes = 0;
+    start(seq, count, repeat, tempo);
+}
+
+void note_sequence_start(note_sequence_t* seq, float (*notes)[][2], uint16_t count, bool repeat, uint8_t tempo) {
+    seq->notes = 0;
+    seq->float_notes = notes;
+    start(seq, count, repeat, tempo);
+}
+
+note_sequence_state_t note_sequence_advance(note_sequence_t* seq, uint16_t period, uint8_t tempo) {
+    bool end_of_note;
+    if (period > 0 && !seq->resting) {
+        seq->elapsed += period;
+        end_of_note = seq->elapsed + period >= seq->length;
+    } else {
+        seq->elapsed += 0xFFFF;
+        end_of_note = seq->elapsed >= seq->length;
+    }
+
+    if (!end_of_note) {
+        return NOTE_SEQUENCE_PLAYING;
+    }
+
+    uint16_t next = seq->current + 1;
+    if (next >= seq->count) {
+        if (!seq->repeat) {
+            return NOTE_SEQUENCE_FINISHED;
+        }
+        next = 0;
+    }
+
+    if (!seq->resting) {
+        // Notes are separated by a one period gap, which is silent when the next note has the same pitch
+        seq->resting = true;
+        if (load_period(seq, next) == seq->period) {
+            seq->period = 0;
+        }
+        seq->elapsed = 0;
+        seq->length = 0xFFFF;
+        return NOTE_SEQUENCE_PLAYING;
+    }
+
+    seq->resting = false;
+    seq->current = next;
+    load_note(seq, tempo);
+    return NOTE_SEQUENCE_NEW_NOTE;
+}
+
+uint32_t note_sequence_ticks(note_sequence_t* seq, uint16_t period) {
+    if (period > 0 && !seq->resting) {
+        // The note ends on the first tick after which another period doesn't fit
+        if (seq->elapsed + 2UL * period >= seq->length) {
+            return 1;
+        }
+        return (seq->length - seq->elapsed - 1) / period;
+    }
+    if (seq->elapsed + 0xFFFF >= seq->length) {
+        return 1;
+    }
+    return (seq->length - seq->elapsed + 0xFFFE) / 0xFFFF;
+}
+
+note_sequence_state_t note_sequence_skip(note_sequence_t* seq, uint16_t period, uint16_t ticks, uint8_t tempo) {
+    if (ticks > 1) {
+        uint16_t step = (period > 0 && !seq->resting) ? period : 0xFFFF;
+        seq->elapsed += (uint32_t)(ticks - 1) * step;
+    }
+    return note_sequence_advance(seq, period, tempo);
+}
+
+float note_sequence_frequency(note_sequence_t* seq) {
+    if (seq->period == 0) {
+        return 0;
+    }
+    return ((float)F_CPU) / ((float)seq->period * CPU_PRESCALER);
+}
@@ -0,0 +1,71 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NOTE_ENGINE_H
+#define NOTE_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CPU_PRESCALER
+    #define CPU_PRESCALER 8
+#endif
+
+// The timer period of a frequency, clamped to what fits in the 16-bit timer
+// Evaluated by the compiler when the frequency is a constant
+#define NOTE_TIMER_PERIOD(freq) \
+    ((((float)F_CPU) / ((freq) * CPU_PRESCALER)) >= 65535.0f ? 0xFFFF : \
+     (uint16_t)(((float)F_CPU) / ((freq) * CPU_PRESCALER)))
+
+#define NOTE_TIMER_PERIOD_TABLE_LENGTH 128
+
+typedef struct {
+    uint8_t note;     // MIDI note number, or MIDI_NOTE_REST
+    uint8_t duration; // 64 is a whole note at the default tempo
+} audio_note_t;
+
+// A song being played, which is advanced once per timer period from the audio ISR
+typedef struct {
+    const audio_note_t* notes;   // In flash
+    float (*float_notes)[][2];   // In RAM, for songs made with the float note macros
+    uint16_t count;
+    uint16_t current;
+    // Both measured in timer counts, a rest advances 0xFFFF counts per tick
+    uint32_t elapsed;
+    uint32_t length;
+    uint16_t period;
+    bool repeat;
+    bool resting;
+} note_sequence_t;
+
+typedef enum {
+    NOTE_SEQUENCE_PLAYING,
+    NOTE_SEQUENCE_NEW_NOTE,
+    NOTE_SEQUENCE_FINISHED,
+} note_sequence_state_t;
+
+uint16_t note_period(uint8_t note);
+
+void note_sequence_start_P(note_sequence_t* seq, const audio_note_t* notes, uint16_t count, bool repeat, uint8_t tempo);
+void note_sequence_start(note_sequence_t* seq, float (*notes)[][2], uint16_t count, bool repeat, uint8_t tempo);
+// Called once per timer period, with the period that was actually used for it
+note_sequence_state_t note_sequence_advance(note_sequence_t* seq, uint16_t period, uint8_t tempo);
+// Timer periods until the current note or rest ends, when it is played with the given period
+uint32_t note_sequence_ticks(note_sequence_t* seq, uint16_t period);
+// Same as ticks calls of note_sequence_advance, for up to note_sequence_ticks periods
+note_sequence_state_t note_sequence_skip(note_sequence_t* seq, uint16_t period, uint16_t ticks, uint8_t tempo);
+float note_sequence_frequency(note_sequence_t* seq);
+
+#endif
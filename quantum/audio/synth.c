@@ -0,0 +1,139 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "synth.h"
+
+#ifdef SYNTH_SINE_WAVE
+const int16_t synth_sine_table[SYNTH_WAVETABLE_LENGTH] = {
+         0,    804,   1608,   2410,   3212,   4011,   4808,   5602,   6393,   7179,   7962,   8739,
+      9512,  10278,  11039,  11793,  12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+     18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,  23170,  23731,  24279,  24811,
+     25329,  25832,  26319,  26790,  27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+     30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,  32137,  32285,  32412,  32521,
+     32609,  32678,  32728,  32757,  32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+     32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,  30273,  29956,  29621,  29268,
+     28898,  28510,  28105,  27683,  27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+     23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,  18204,  17530,  16846,  16151,
+     15446,  14732,  14010,  13279,  12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+      6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,      0,   -804,  -1608,  -2410,
+     -3212,  -4011,  -4808,  -5602,  -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+    -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+    -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580,
+    -31356, -31113, -30852, -30571, -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403,
+    -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,  -6393,  -5602,  -4808,  -4011,
+     -3212,  -2410,  -1608,   -804,
+};
+#endif
+
+static synth_voice_t synth_voices[SYNTH_VOICES];
+#ifdef SYNTH_SINE_WAVE
+static const int16_t* wavetable = synth_sine_table;
+#else
+static const int16_t* wavetable = 0;
+#endif
+
+void synth_init(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        synth_voices[i].phase = 0;
+        synth_voices[i].increment = 0;
+        synth_voices[i].duty = 0x80000000;
+        synth_voices[i].amplitude = 0;
+    }
+}
+
+void synth_set_wavetable(const int16_t* table) {
+    wavetable = table;
+}
+
+uint32_t synth_phase_increment(float frequency) {
+    if (frequency <= 0 || frequency >= SYNTH_SAMPLE_RATE / 2) {
+        return 0;
+    }
+    return (uint32_t)(frequency * (4294967296.0f / SYNTH_SAMPLE_RATE));
+}
+
+void synth_voice_set(uint8_t voice, float frequency, float timbre, int16_t amplitude) {
+    if (voice >= SYNTH_VOICES) {
+        return;
+    }
+    synth_voice_t* v = &synth_voices[voice];
+    v->increment = synth_phase_increment(frequency);
+    if (timbre <= 0) {
+        v->duty = 0;
+    } else if (timbre >= 1) {
+        v->duty = 0xFFFFFFFF;
+    } else {
+        v->duty = (uint32_t)(timbre * 4294967296.0f);
+    }
+    v->amplitude = amplitude > SYNTH_AMPLITUDE_MAX ? SYNTH_AMPLITUDE_MAX : amplitude;
+}
+
+void synth_voice_stop(uint8_t voice) {
+    if (voice < SYNTH_VOICES) {
+        synth_voices[voice].increment = 0;
+        synth_voices[voice].phase = 0;
+    }
+}
+
+void synth_stop_all(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        synth_voice_stop(i);
+    }
+}
+
+bool synth_is_active(void) {
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (synth_voices[i].increment) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void synth_render(uint16_t* buffer, size_t count) {
+    synth_voice_t* active[SYNTH_VOICES];
+    uint8_t num_active = 0;
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        if (synth_voices[i].increment && synth_voices[i].amplitude) {
+            active[num_active++] = &synth_voices[i];
+        }
+    }
+
+    for (size_t s = 0; s < count; s++) {
+        int32_t mix = 0;
+        for (uint8_t i = 0; i < num_active; i++) {
+            synth_voice_t* v = active[i];
+            if (wavetable) {
+                mix += ((int32_t)wavetable[v->phase >> 24] * v->amplitude) >> 15;
+            } else {
+                mix += v->phase < v->duty ? v->amplitude : -v->amplitude;
+            }
+            v->phase += v->increment;
+        }
+        mix += SYNTH_SAMPLE_MIDPOINT;
+        if (mix < 0) {
+            mix = 0;
+        } else if (mix > SYNTH_SAMPLE_MAX) {
+            mix = SYNTH_SAMPLE_MAX;
+        }
+        buffer[s] = mix;
+    }
+}
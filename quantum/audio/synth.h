@@ -0,0 +1,70 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Software mixer for the DAC audio driver, which renders all voices into one stream of samples
+// at a fixed sample rate. Voices are only changed between blocks, rendering is integer only.
+
+#ifndef SYNTH_SAMPLE_RATE
+    #define SYNTH_SAMPLE_RATE 32000
+#endif
+
+#ifndef SYNTH_VOICES
+    #define SYNTH_VOICES 8
+#endif
+
+// Samples rendered at a time, which is half of the DMA buffer
+#ifndef SYNTH_BLOCK_SIZE
+    #define SYNTH_BLOCK_SIZE 256
+#endif
+
+// Wavetables are indexed by the top 8 bits of the phase
+#define SYNTH_WAVETABLE_LENGTH 256
+
+// 12-bit DAC samples
+#define SYNTH_SAMPLE_MAX 4095
+#define SYNTH_SAMPLE_MIDPOINT 2048
+#define SYNTH_AMPLITUDE_MAX 2047
+
+typedef struct {
+    uint32_t phase;     // 2^32 is one cycle
+    uint32_t increment; // Phase step per sample, 0 when the voice is off
+    uint32_t duty;      // Pulse width, as a fraction of 2^32
+    int16_t amplitude;
+} synth_voice_t;
+
+// Voices play pulse waves unless SYNTH_SINE_WAVE is defined, which builds in a sine table and plays that
+#ifdef SYNTH_SINE_WAVE
+extern const int16_t synth_sine_table[SYNTH_WAVETABLE_LENGTH];
+#endif
+
+void synth_init(void);
+// The waveform of all voices, either a table of SYNTH_WAVETABLE_LENGTH samples or NULL for a pulse wave
+void synth_set_wavetable(const int16_t* table);
+uint32_t synth_phase_increment(float frequency);
+// Starts or changes a voice, keeping its phase so that the waveform stays continuous
+void synth_voice_set(uint8_t voice, float frequency, float timbre, int16_t amplitude);
+void synth_voice_stop(uint8_t voice);
+void synth_stop_all(void);
+bool synth_is_active(void);
+void synth_render(uint16_t* buffer, size_t count);
+
+#endif
@@ -0,0 +1,223 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "progmem.h"
+#include "musical_notes.h"
+#include "audio_queue.h"
+}
+
+#define TEST_SONG \
+    Q__NOTE(_E4), Q__NOTE(_E4), E__NOTE(_F4), Q__NOTE(_REST), \
+    QD_NOTE(_G4), S__NOTE(_BF4), H__NOTE(_C6), W__NOTE(_B1), \
+    FLASH_NOTE(_C8, 255),
+
+#undef MUSICAL_NOTE
+#define MUSICAL_NOTE(note, duration) FLASH_NOTE(note, duration)
+static const audio_note_t song[] PROGMEM = SONG(TEST_SONG);
+static const uint16_t song_count = sizeof(song) / sizeof(song[0]);
+
+static const uint8_t tempo = 250;
+
+uint16_t audio_queue_steps;
+
+class AudioQueue : public testing::Test {
+public:
+    AudioQueue() {
+        audio_queue_clear(&queue);
+        queue.ticks_played = 0;
+        queue.underruns = 0;
+    }
+
+    // Runs the ISR once, and keeps track of the most steps it has taken in one call
+    const audio_event_t* isr_tick() {
+        audio_queue_steps = 0;
+        const audio_event_t* event = audio_queue_tick(&queue);
+        max_steps_per_tick = std::max(max_steps_per_tick, (int)audio_queue_steps);
+        return event;
+    }
+
+    // The period heard during each tick, when the song is advanced from the ISR like before
+    std::vector<uint16_t> render_in_isr() {
+        std::vector<uint16_t> periods;
+        note_sequence_t seq;
+        note_sequence_start_P(&seq, song, song_count, false, tempo);
+        do {
+            periods.push_back(seq.period);
+        } while (note_sequence_advance(&seq, seq.period, tempo) != NOTE_SEQUENCE_FINISHED);
+        return periods;
+    }
+
+    // Queues the song from the main loop, which only gets to run every few ticks
+    std::vector<uint16_t> render_from_queue(uint32_t ticks_per_loop) {
+        std::vector<uint16_t> periods;
+        note_sequence_t seq;
+        note_sequence_start_P(&seq, song, song_count, false, tempo);
+        bool finished = false;
+        bool queued = false;
+        uint16_t period = 0;
+        uint16_t duty = 0;
+        for (uint32_t tick = 0; tick < 10000000; tick++) {
+            if (tick % ticks_per_loop == 0) {
+                while (!queued && audio_queue_space(&queue)) {
+                    if (finished) {
+                        audio_queue_push(&queue, 0, 0, 0);
+                        queued = true;
+                    } else if (audio_queue_note(&queue, &seq, seq.period, seq.period / 2, 0xFFFF, tempo) == NOTE_SEQUENCE_FINISHED) {
+                        finished = true;
+                    }
+                }
+            }
+            // The ISR runs at the end of each period, the first one only starts the song
+            if (tick > 0) {
+                periods.push_back(duty ? period : 0);
+            }
+            const audio_event_t* event = isr_tick();
+            if (event) {
+                if (event->period == 0) {
+                    break;
+                }
+                period = event->period;
+                duty = event->duty;
+            }
+        }
+        return periods;
+    }
+
+    audio_queue_t queue;
+    int max_steps_per_tick = 0;
+};
+
+TEST_F(AudioQueue, events_come_out_in_order) {
+    EXPECT_TRUE(audio_queue_idle(&queue));
+    EXPECT_TRUE(audio_queue_push(&queue, 100, 50, 1));
+    EXPECT_TRUE(audio_queue_push(&queue, 200, 100, 1));
+    EXPECT_FALSE(audio_queue_idle(&queue));
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 100);
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 200);
+    EXPECT_EQ(audio_queue_tick(&queue), nullptr);
+}
+
+TEST_F(AudioQueue, full_queue_refuses_events) {
+    EXPECT_EQ(audio_queue_space(&queue), AUDIO_QUEUE_LENGTH - 1);
+    for (int i = 0; i < AUDIO_QUEUE_LENGTH - 1; i++) {
+        EXPECT_TRUE(audio_queue_push(&queue, 100 + i, 50, 1));
+    }
+    EXPECT_EQ(audio_queue_space(&queue), 0);
+    EXPECT_FALSE(audio_queue_push(&queue, 1, 1, 1));
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 100);
+    EXPECT_EQ(audio_queue_space(&queue), 1);
+}
+
+TEST_F(AudioQueue, event_lasts_for_its_ticks) {
+    audio_queue_push(&queue, 100, 50, 3);
+    audio_queue_push(&queue, 200, 100, 1);
+    EXPECT_NE(audio_queue_tick(&queue), nullptr);
+    EXPECT_EQ(audio_queue_tick(&queue), nullptr);
+    EXPECT_EQ(audio_queue_tick(&queue), nullptr);
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 200);
+    EXPECT_EQ(queue.ticks_played, 4);
+}
+
+TEST_F(AudioQueue, held_event_is_replaced_by_the_next_one) {
+    audio_queue_push(&queue, 100, 50, 0);
+    EXPECT_NE(audio_queue_tick(&queue), nullptr);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(audio_queue_tick(&queue), nullptr);
+    }
+    EXPECT_TRUE(audio_queue_idle(&queue));
+    EXPECT_EQ(queue.underruns, 0);
+    audio_queue_push(&queue, 200, 100, 0);
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 200);
+}
+
+TEST_F(AudioQueue, late_main_loop_is_counted_as_an_underrun) {
+    audio_queue_push(&queue, 100, 50, 2);
+    audio_queue_tick(&queue);
+    audio_queue_tick(&queue);
+    EXPECT_EQ(audio_queue_tick(&queue), nullptr);
+    EXPECT_EQ(queue.underruns, 1);
+    audio_queue_push(&queue, 200, 100, 1);
+    EXPECT_EQ(audio_queue_tick(&queue)->period, 200);
+}
+
+TEST_F(AudioQueue, rests_are_queued_as_silence) {
+    const audio_note_t rest[] = { FLASH_NOTE(_REST, 16) };
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, rest, 1, false, TEMPO_DEFAULT);
+    EXPECT_EQ(audio_queue_note(&queue, &seq, seq.period, 0, 0xFFFF, TEMPO_DEFAULT), NOTE_SEQUENCE_FINISHED);
+    const audio_event_t* event = audio_queue_tick(&queue);
+    EXPECT_EQ(event->period, AUDIO_QUEUE_SILENCE);
+    EXPECT_EQ(event->duty, 0);
+    EXPECT_EQ(event->ticks, 4);
+}
+
+TEST_F(AudioQueue, long_notes_are_split_into_several_events) {
+    const audio_note_t note[] = { FLASH_NOTE(_C8, 255) };
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, note, 1, false, 255);
+    uint32_t ticks = note_sequence_ticks(&seq, seq.period);
+    EXPECT_EQ(audio_queue_note(&queue, &seq, seq.period, 0, 1000, 255), NOTE_SEQUENCE_PLAYING);
+    EXPECT_EQ(audio_queue_tick(&queue)->ticks, 1000);
+    EXPECT_EQ(note_sequence_ticks(&seq, seq.period), ticks - 1000);
+}
+
+TEST_F(AudioQueue, song_plays_the_same_as_when_advanced_in_the_isr) {
+    std::vector<uint16_t> reference = render_in_isr();
+    for (uint32_t ticks_per_loop : {1, 3, 8}) {
+        SCOPED_TRACE(ticks_per_loop);
+        audio_queue_clear(&queue);
+        queue.underruns = 0;
+        std::vector<uint16_t> periods = render_from_queue(ticks_per_loop);
+        ASSERT_EQ(periods.size(), reference.size());
+        for (size_t i = 0; i < periods.size(); i++) {
+            ASSERT_EQ(periods[i], reference[i]) << "Tick " << i;
+        }
+        EXPECT_EQ(queue.underruns, 0);
+        EXPECT_LE(max_steps_per_tick, AUDIO_QUEUE_MAX_STEPS);
+    }
+}
+
+TEST_F(AudioQueue, full_queue_takes_no_more_isr_work) {
+    for (int i = 0; i < AUDIO_QUEUE_LENGTH - 1; i++) {
+        audio_queue_push(&queue, 100 + i, 50, 1);
+    }
+    isr_tick();
+    const int steps_when_full = max_steps_per_tick;
+    // The main loop keeps the queue full, the ISR still applies one event per call
+    for (int i = 0; i < 1000; i++) {
+        audio_queue_push(&queue, 100, 50, 1);
+        EXPECT_EQ(audio_queue_space(&queue), 0);
+        ASSERT_NE(isr_tick(), nullptr);
+    }
+    EXPECT_EQ(max_steps_per_tick, steps_when_full);
+    EXPECT_LE(max_steps_per_tick, AUDIO_QUEUE_MAX_STEPS);
+}
+
+TEST_F(AudioQueue, starved_queue_takes_no_more_isr_work) {
+    audio_queue_push(&queue, 100, 50, 2);
+    // The main loop stops refilling, the ISR underruns once and then only checks for new events
+    for (int i = 0; i < 1000; i++) {
+        isr_tick();
+    }
+    EXPECT_EQ(queue.underruns, 1);
+    EXPECT_LE(max_steps_per_tick, AUDIO_QUEUE_MAX_STEPS);
+    max_steps_per_tick = 0;
+    isr_tick();
+    EXPECT_LT(max_steps_per_tick, AUDIO_QUEUE_MAX_STEPS);
+}
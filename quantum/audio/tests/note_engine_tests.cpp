@@ -0,0 +1,280 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <utility>
+extern "C" {
+#include "progmem.h"
+#include "musical_notes.h"
+#include "note_engine.h"
+}
+
+typedef std::vector<std::pair<uint16_t, uint32_t>> timeline_t;
+
+static const uint32_t max_ticks = 1000000;
+static const uint32_t timer_frequency = F_CPU / CPU_PRESCALER;
+
+#define TEST_SONG \
+    Q__NOTE(_E4), Q__NOTE(_E4), E__NOTE(_F4), Q__NOTE(_REST), \
+    QD_NOTE(_G4), S__NOTE(_BF4), H__NOTE(_C6), W__NOTE(_B1),
+
+static float float_song[][2] = SONG(TEST_SONG);
+
+#undef MUSICAL_NOTE
+#define MUSICAL_NOTE(note, duration) FLASH_NOTE(note, duration)
+static const audio_note_t flash_song[] PROGMEM = SONG(TEST_SONG);
+
+// The periods of each tick, merged into (period, number of ticks) runs
+static timeline_t render(note_sequence_t* seq, uint8_t tempo) {
+    timeline_t timeline;
+    for (uint32_t i = 0; i < max_ticks; i++) {
+        uint16_t period = seq->period;
+        if (timeline.empty() || timeline.back().first != period) {
+            timeline.push_back(std::make_pair(period, 0));
+        }
+        timeline.back().second++;
+        if (note_sequence_advance(seq, period, tempo) == NOTE_SEQUENCE_FINISHED) {
+            break;
+        }
+    }
+    return timeline;
+}
+
+// The song playback of the float based audio ISR, which the note engine replaced
+static timeline_t render_float_reference(float (*notes)[][2], uint16_t count, uint8_t tempo) {
+    timeline_t timeline;
+    uint16_t current_note = 0;
+    float note_frequency = (*notes)[0][0];
+    float note_length = ((*notes)[0][1] / 4) * (((float)tempo) / 100);
+    uint16_t note_position = 0;
+    bool note_resting = false;
+    for (uint32_t i = 0; i < max_ticks; i++) {
+        uint16_t period = note_frequency > 0 ? (uint16_t)(((float)F_CPU) / (note_frequency * CPU_PRESCALER)) : 0;
+        if (timeline.empty() || timeline.back().first != period) {
+            timeline.push_back(std::make_pair(period, 0));
+        }
+        timeline.back().second++;
+
+        note_position++;
+        bool end_of_note;
+        if (period > 0 && !note_resting) {
+            end_of_note = (note_position >= (note_length / period * 0xFFFF - 1));
+        } else {
+            end_of_note = (note_position >= (note_length));
+        }
+
+        if (end_of_note) {
+            current_note++;
+            if (current_note >= count) {
+                break;
+            }
+            if (!note_resting) {
+                note_resting = true;
+                current_note--;
+                if ((*notes)[current_note][0] == (*notes)[current_note + 1][0]) {
+                    note_frequency = 0;
+                } else {
+                    note_frequency = (*notes)[current_note][0];
+                }
+                note_length = 1;
+            } else {
+                note_resting = false;
+                note_frequency = (*notes)[current_note][0];
+                note_length = ((*notes)[current_note][1] / 4) * (((float)tempo) / 100);
+            }
+            note_position = 0;
+        }
+    }
+    return timeline;
+}
+
+// Samples the square wave output of the timer, and measures its frequency from the rising edges
+static float measure_frequency(const timeline_t& timeline, uint32_t sample_rate) {
+    std::vector<bool> samples;
+    double time = 0;
+    double next_sample = 0;
+    for (auto& run : timeline) {
+        double period = (double)run.first / timer_frequency;
+        for (uint32_t i = 0; i < run.second; i++) {
+            while (next_sample < time + period) {
+                samples.push_back(next_sample - time < period / 2);
+                next_sample += 1.0 / sample_rate;
+            }
+            time += period;
+        }
+    }
+    std::vector<size_t> edges;
+    for (size_t i = 1; i < samples.size(); i++) {
+        if (samples[i] && !samples[i - 1]) {
+            edges.push_back(i);
+        }
+    }
+    if (edges.size() < 2) {
+        return 0;
+    }
+    return (float)(edges.size() - 1) * sample_rate / (edges.back() - edges.front());
+}
+
+TEST(NoteEngine, periods_match_the_note_frequencies) {
+    const std::pair<uint8_t, float> notes[] = {
+        {MIDI_NOTE_B1, NOTE_B1}, {MIDI_NOTE_C2, NOTE_C2}, {MIDI_NOTE_FS2, NOTE_FS2},
+        {MIDI_NOTE_C3, NOTE_C3}, {MIDI_NOTE_GS3, NOTE_GS3}, {MIDI_NOTE_C4, NOTE_C4},
+        {MIDI_NOTE_A4, NOTE_A4}, {MIDI_NOTE_BF4, NOTE_BF4}, {MIDI_NOTE_E5, NOTE_E5},
+        {MIDI_NOTE_CS6, NOTE_CS6}, {MIDI_NOTE_G7, NOTE_G7}, {MIDI_NOTE_B8, NOTE_B8},
+    };
+    // The float note frequencies are rounded to 0.01 Hz, so allow up to one cent of difference
+    for (auto& note : notes) {
+        float period = (float)timer_frequency / note.second;
+        EXPECT_NEAR(note_period(note.first), period, period * 0.0006f + 1) << "MIDI note " << (int)note.first;
+    }
+}
+
+TEST(NoteEngine, rest_and_out_of_range_notes_have_no_period) {
+    EXPECT_EQ(note_period(MIDI_NOTE_REST), 0);
+    EXPECT_EQ(note_period(128), 0);
+    EXPECT_EQ(note_period(255), 0);
+}
+
+TEST(NoteEngine, very_low_notes_are_clamped_to_the_timer_range) {
+    EXPECT_EQ(note_period(1), 0xFFFF);
+    EXPECT_EQ(note_period(MIDI_NOTE_C0), 0xFFFF);
+}
+
+TEST(NoteEngine, flash_song_plays_the_same_as_the_float_reference) {
+    const uint16_t count = sizeof(flash_song) / sizeof(flash_song[0]);
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, flash_song, count, false, TEMPO_DEFAULT);
+    timeline_t timeline = render(&seq, TEMPO_DEFAULT);
+    timeline_t reference = render_float_reference(&float_song, count, TEMPO_DEFAULT);
+    ASSERT_EQ(timeline.size(), reference.size());
+    for (size_t i = 0; i < timeline.size(); i++) {
+        // The float note frequencies are rounded to 0.01 Hz, so allow up to one cent of difference
+        EXPECT_NEAR(timeline[i].first, reference[i].first, reference[i].first * 0.0006 + 1) << "Run " << i;
+        EXPECT_NEAR(timeline[i].second, reference[i].second, 1) << "Run " << i;
+    }
+}
+
+TEST(NoteEngine, float_song_plays_the_same_as_the_float_reference) {
+    const uint16_t count = sizeof(float_song) / sizeof(float_song[0]);
+    const uint8_t tempo = 73;
+    note_sequence_t seq;
+    note_sequence_start(&seq, &float_song, count, false, tempo);
+    timeline_t timeline = render(&seq, tempo);
+    timeline_t reference = render_float_reference(&float_song, count, tempo);
+    ASSERT_EQ(timeline.size(), reference.size());
+    for (size_t i = 0; i < timeline.size(); i++) {
+        EXPECT_EQ(timeline[i].first, reference[i].first) << "Run " << i;
+        EXPECT_NEAR(timeline[i].second, reference[i].second, 1) << "Run " << i;
+    }
+}
+
+TEST(NoteEngine, same_pitch_notes_are_separated_by_a_silent_gap) {
+    const audio_note_t song[] = { FLASH_NOTE(_E4, 16), FLASH_NOTE(_E4, 16) };
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, song, 2, false, TEMPO_DEFAULT);
+    timeline_t timeline = render(&seq, TEMPO_DEFAULT);
+    ASSERT_EQ(timeline.size(), 3);
+    EXPECT_EQ(timeline[0].first, note_period(MIDI_NOTE_E4));
+    EXPECT_EQ(timeline[1].first, 0);
+    EXPECT_EQ(timeline[1].second, 1);
+    EXPECT_EQ(timeline[2].first, note_period(MIDI_NOTE_E4));
+}
+
+TEST(NoteEngine, notes_last_for_their_tempo_scaled_duration) {
+    const audio_note_t song[] = { FLASH_NOTE(_A4, 64) };
+    for (uint8_t tempo : {50, 100, 200}) {
+        note_sequence_t seq;
+        note_sequence_start_P(&seq, song, 1, false, tempo);
+        timeline_t timeline = render(&seq, tempo);
+        ASSERT_EQ(timeline.size(), 1);
+        uint32_t counts = timeline[0].first * timeline[0].second;
+        uint32_t expected = 16UL * tempo / 100 * 0xFFFF;
+        EXPECT_NEAR(counts, expected, timeline[0].first);
+    }
+}
+
+TEST(NoteEngine, new_note_is_reported_once_per_note) {
+    const audio_note_t song[] = { FLASH_NOTE(_C4, 4), FLASH_NOTE(_D4, 4), FLASH_NOTE(_E4, 4) };
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, song, 3, false, TEMPO_DEFAULT);
+    int new_notes = 0;
+    note_sequence_state_t state;
+    do {
+        state = note_sequence_advance(&seq, seq.period, TEMPO_DEFAULT);
+        if (state == NOTE_SEQUENCE_NEW_NOTE) {
+            new_notes++;
+        }
+    } while (state != NOTE_SEQUENCE_FINISHED);
+    EXPECT_EQ(new_notes, 2);
+}
+
+TEST(NoteEngine, repeating_song_starts_over) {
+    const audio_note_t song[] = { FLASH_NOTE(_C4, 4), FLASH_NOTE(_G4, 4) };
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, song, 2, true, TEMPO_DEFAULT);
+    for (int i = 0; i < 10000; i++) {
+        ASSERT_NE(note_sequence_advance(&seq, seq.period, TEMPO_DEFAULT), NOTE_SEQUENCE_FINISHED);
+    }
+    timeline_t timeline = render(&seq, TEMPO_DEFAULT);
+    bool played_c = false;
+    bool played_g = false;
+    for (auto& run : timeline) {
+        played_c |= run.first == note_period(MIDI_NOTE_C4);
+        played_g |= run.first == note_period(MIDI_NOTE_G4);
+    }
+    EXPECT_TRUE(played_c);
+    EXPECT_TRUE(played_g);
+}
+
+TEST(NoteEngine, rendered_waveform_has_the_note_pitch) {
+    const std::pair<uint8_t, float> notes[] = {
+        {MIDI_NOTE_C4, NOTE_C4}, {MIDI_NOTE_A4, NOTE_A4}, {MIDI_NOTE_FS5, NOTE_FS5}, {MIDI_NOTE_C6, NOTE_C6},
+    };
+    for (auto& note : notes) {
+        const audio_note_t song[] = { {note.first, 64} };
+        note_sequence_t seq;
+        note_sequence_start_P(&seq, song, 1, false, TEMPO_DEFAULT);
+        timeline_t timeline = render(&seq, TEMPO_DEFAULT);
+        EXPECT_NEAR(measure_frequency(timeline, 48000), note.second, note.second * 0.002f) << "MIDI note " << (int)note.first;
+    }
+}
+
+TEST(NoteEngine, skipping_to_the_end_of_each_note_matches_advancing_per_tick) {
+    const uint16_t count = sizeof(flash_song) / sizeof(flash_song[0]);
+    note_sequence_t seq;
+    note_sequence_start_P(&seq, flash_song, count, false, TEMPO_DEFAULT);
+    timeline_t timeline;
+    note_sequence_state_t state;
+    do {
+        uint32_t ticks = note_sequence_ticks(&seq, seq.period);
+        timeline.push_back(std::make_pair(seq.period, ticks));
+        state = note_sequence_skip(&seq, seq.period, ticks, TEMPO_DEFAULT);
+    } while (state != NOTE_SEQUENCE_FINISHED);
+
+    note_sequence_start_P(&seq, flash_song, count, false, TEMPO_DEFAULT);
+    timeline_t reference = render(&seq, TEMPO_DEFAULT);
+    // The runs of the reference merge the notes and gaps that have the same period
+    timeline_t merged;
+    for (auto& run : timeline) {
+        if (!merged.empty() && merged.back().first == run.first) {
+            merged.back().second += run.second;
+        } else {
+            merged.push_back(run);
+        }
+    }
+    EXPECT_EQ(merged, reference);
+}
@@ -0,0 +1,18 @@
+audio_note_engine_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/note_engine_tests.cpp \
+	$(QUANTUM_PATH)/audio/note_engine.c
+
+audio_note_engine_DEFS := -DF_CPU=16000000
+
+audio_synth_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/synth_tests.cpp \
+	$(QUANTUM_PATH)/audio/synth.c
+
+audio_synth_DEFS := -DSYNTH_SINE_WAVE
+
+audio_queue_SRC :=\
+	$(QUANTUM_PATH)/audio/tests/audio_queue_tests.cpp \
+	$(QUANTUM_PATH)/audio/audio_queue.c \
+	$(QUANTUM_PATH)/audio/note_engine.c
+
+audio_queue_DEFS := -DF_CPU=16000000 -DAUDIO_QUEUE_COUNT_STEPS
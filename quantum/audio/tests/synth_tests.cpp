@@ -0,0 +1,151 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <cmath>
+extern "C" {
+#include "musical_notes.h"
+#include "synth.h"
+}
+
+class Synth : public testing::Test {
+public:
+    Synth() {
+        synth_init();
+        synth_set_wavetable(synth_sine_table);
+    }
+    ~Synth() {
+        synth_set_wavetable(NULL);
+    }
+
+    // Renders a number of DMA half buffers, like the DAC callback does
+    std::vector<uint16_t> render(size_t blocks) {
+        std::vector<uint16_t> wav(blocks * SYNTH_BLOCK_SIZE);
+        for (size_t i = 0; i < blocks; i++) {
+            synth_render(&wav[i * SYNTH_BLOCK_SIZE], SYNTH_BLOCK_SIZE);
+        }
+        return wav;
+    }
+
+    // Power of a single frequency in the rendered samples
+    static double power(const std::vector<uint16_t>& wav, float frequency) {
+        double coeff = 2 * cos(2 * M_PI * frequency / SYNTH_SAMPLE_RATE);
+        double s1 = 0, s2 = 0;
+        for (uint16_t sample : wav) {
+            double s = ((double)sample - SYNTH_SAMPLE_MIDPOINT) + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s;
+        }
+        return (s1 * s1 + s2 * s2 - coeff * s1 * s2) / wav.size();
+    }
+
+    static float measure_frequency(const std::vector<uint16_t>& wav) {
+        std::vector<size_t> crossings;
+        for (size_t i = 1; i < wav.size(); i++) {
+            if (wav[i - 1] < SYNTH_SAMPLE_MIDPOINT && wav[i] >= SYNTH_SAMPLE_MIDPOINT) {
+                crossings.push_back(i);
+            }
+        }
+        if (crossings.size() < 2) {
+            return 0;
+        }
+        return (float)(crossings.size() - 1) * SYNTH_SAMPLE_RATE / (crossings.back() - crossings.front());
+    }
+};
+
+TEST_F(Synth, is_silent_without_voices) {
+    EXPECT_FALSE(synth_is_active());
+    for (uint16_t sample : render(4)) {
+        ASSERT_EQ(sample, SYNTH_SAMPLE_MIDPOINT);
+    }
+}
+
+TEST_F(Synth, voice_plays_at_its_frequency) {
+    for (float frequency : {NOTE_C2, NOTE_A4, NOTE_E6, NOTE_C8}) {
+        synth_init();
+        synth_voice_set(0, frequency, TIMBRE_50, SYNTH_AMPLITUDE_MAX);
+        EXPECT_TRUE(synth_is_active());
+        std::vector<uint16_t> wav = render(SYNTH_SAMPLE_RATE / SYNTH_BLOCK_SIZE);
+        EXPECT_NEAR(measure_frequency(wav), frequency, frequency * 0.001f) << frequency << " Hz";
+    }
+}
+
+TEST_F(Synth, chord_has_a_peak_at_each_note) {
+    synth_voice_set(0, NOTE_C4, TIMBRE_50, SYNTH_AMPLITUDE_MAX / 3);
+    synth_voice_set(1, NOTE_E4, TIMBRE_50, SYNTH_AMPLITUDE_MAX / 3);
+    synth_voice_set(2, NOTE_G4, TIMBRE_50, SYNTH_AMPLITUDE_MAX / 3);
+    std::vector<uint16_t> wav = render(64);
+    double noise = 0;
+    for (float frequency : {NOTE_D4, NOTE_F4, NOTE_A4, NOTE_C5, 1000.0f}) {
+        noise = std::max(noise, power(wav, frequency));
+    }
+    for (float frequency : {NOTE_C4, NOTE_E4, NOTE_G4}) {
+        EXPECT_GT(power(wav, frequency), noise * 100) << frequency << " Hz";
+    }
+}
+
+TEST_F(Synth, stopped_voice_is_no_longer_heard) {
+    synth_voice_set(0, NOTE_C4, TIMBRE_50, SYNTH_AMPLITUDE_MAX / 2);
+    synth_voice_set(1, NOTE_G4, TIMBRE_50, SYNTH_AMPLITUDE_MAX / 2);
+    render(4);
+    synth_voice_stop(1);
+    std::vector<uint16_t> wav = render(64);
+    EXPECT_GT(power(wav, NOTE_C4), power(wav, NOTE_G4) * 100);
+    synth_stop_all();
+    EXPECT_FALSE(synth_is_active());
+}
+
+TEST_F(Synth, waveform_is_continuous_across_blocks) {
+    synth_voice_set(0, NOTE_A4, TIMBRE_50, SYNTH_AMPLITUDE_MAX);
+    std::vector<uint16_t> blocks = render(8);
+    synth_init();
+    synth_voice_set(0, NOTE_A4, TIMBRE_50, SYNTH_AMPLITUDE_MAX);
+    std::vector<uint16_t> whole(8 * SYNTH_BLOCK_SIZE);
+    synth_render(whole.data(), whole.size());
+    EXPECT_EQ(blocks, whole);
+}
+
+TEST_F(Synth, pulse_width_follows_the_timbre) {
+    synth_set_wavetable(NULL);
+    for (float timbre : {TIMBRE_12, TIMBRE_25, TIMBRE_50, TIMBRE_75}) {
+        synth_init();
+        synth_voice_set(0, NOTE_A4, timbre, SYNTH_AMPLITUDE_MAX);
+        std::vector<uint16_t> wav = render(64);
+        size_t high = 0;
+        for (uint16_t sample : wav) {
+            high += sample > SYNTH_SAMPLE_MIDPOINT;
+        }
+        EXPECT_NEAR((float)high / wav.size(), timbre, 0.01f) << "Timbre " << timbre;
+    }
+}
+
+TEST_F(Synth, mix_of_all_voices_saturates_instead_of_wrapping) {
+    synth_set_wavetable(NULL);
+    for (uint8_t i = 0; i < SYNTH_VOICES; i++) {
+        synth_voice_set(i, NOTE_A4, TIMBRE_50, SYNTH_AMPLITUDE_MAX);
+    }
+    std::vector<uint16_t> wav = render(4);
+    EXPECT_EQ(wav[0], SYNTH_SAMPLE_MAX);
+    for (uint16_t sample : wav) {
+        ASSERT_TRUE(sample == 0 || sample == SYNTH_SAMPLE_MAX) << sample;
+    }
+}
+
+TEST_F(Synth, frequencies_above_nyquist_are_not_played) {
+    synth_voice_set(0, SYNTH_SAMPLE_RATE, TIMBRE_50, SYNTH_AMPLITUDE_MAX);
+    EXPECT_FALSE(synth_is_active());
+}
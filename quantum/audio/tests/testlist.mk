@@ -0,0 +1,4 @@
+TEST_LIST +=\
+	audio_note_engine\
+	audio_synth\
+	audio_queue
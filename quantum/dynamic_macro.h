@@ -19,6 +19,14 @@
 #define DYNAMIC_MACROS_H
 
 #include "action_layer.h"
+#include "timer.h"
+#ifdef DYNAMIC_MACRO_TIMED_PLAYBACK
+#include <string.h>
+#include "deadline.h"
+#endif
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+#include "eeprom.h"
+#endif
 
 #ifndef DYNAMIC_MACRO_SIZE
 /* May be overridden with a custom value. Be aware that the effective
@@ -26,11 +34,11 @@
  * because of the down-event and up-event. This is not a bug, it's the
  * intended behavior.
  *
- * Usually it should be fine to set the macro size to at least 256 but
- * there have been reports of it being too much in some users' cases,
- * so 128 is considered a safe default.
+ * Each event takes two bytes, so the default buffer uses 768 bytes of
+ * RAM, as much as 128 events did when they were stored as whole
+ * keyrecord_t structs. Lower it if your keyboard runs out of RAM.
  */
-#define DYNAMIC_MACRO_SIZE 128
+#define DYNAMIC_MACRO_SIZE 384
 #endif
 
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
@@ -45,6 +53,28 @@ enum dynamic_macro_keycodes {
     DYN_MACRO_PLAY2,
 };
 
+/* A recorded event. The high byte is the key's index in the matrix,
+ * row * MATRIX_COLS + col. The low byte holds whether the key was
+ * pressed, whether it was a tap and the delay since the previous event
+ * in the format described at dynamic_macro_encode_delay().
+ *
+ * Delays longer than a single event can hold are stored as pause
+ * events before it, which have DYNAMIC_MACRO_PAUSE as their key.
+ */
+typedef uint16_t dynamic_macro_event_t;
+
+#define DYNAMIC_MACRO_PRESSED 0x80
+#define DYNAMIC_MACRO_TAPPED 0x40
+#define DYNAMIC_MACRO_DELAY_MASK 0x3F
+#define DYNAMIC_MACRO_PAUSE 0xFF
+#define DYNAMIC_MACRO_MAX_DELAY 960
+
+#if MATRIX_ROWS * MATRIX_COLS >= DYNAMIC_MACRO_PAUSE
+#error "Dynamic macros only support matrices with less than 255 keys"
+#endif
+
+#define DYNAMIC_MACRO_EVENT_KEY(EVENT) ((uint8_t)((EVENT) >> 8))
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -64,6 +94,44 @@ void dynamic_macro_led_blink(void)
 #define DYNAMIC_MACRO_CURRENT_CAPACITY(BEGIN, END2) \
     ((int)(direction * ((END2) - (BEGIN)) + 1))
 
+/**
+ * Encode a delay in milliseconds into the 6 bits an event has for it.
+ * It's stored like a tiny float, with 3 bits of exponent and 3 bits of
+ * mantissa: exact up to 15ms and within 1/8 of the delay up to
+ * DYNAMIC_MACRO_MAX_DELAY. The delay is rounded down, the recording
+ * adds what is left over to the next event so that the errors don't
+ * add up over the macro.
+ */
+uint8_t dynamic_macro_encode_delay(uint16_t delay)
+{
+    if (delay < 8) {
+        return delay;
+    }
+    if (delay >= DYNAMIC_MACRO_MAX_DELAY) {
+        return DYNAMIC_MACRO_DELAY_MASK;
+    }
+    uint8_t exponent = 1;
+    while (delay >= 16) {
+        delay >>= 1;
+        exponent++;
+    }
+    return exponent << 3 | (delay - 8);
+}
+
+uint16_t dynamic_macro_decode_delay(uint8_t code)
+{
+    uint8_t exponent = code >> 3;
+    uint8_t mantissa = code & 7;
+
+    if (exponent == 0) {
+        return mantissa;
+    }
+    return (uint16_t)(8 + mantissa) << (exponent - 1);
+}
+
+/* The time the recorded delays have added up to so far. */
+static uint16_t dynamic_macro_record_time;
+
 /**
  * Start recording of the dynamic macro.
  *
@@ -71,7 +139,7 @@ void dynamic_macro_led_blink(void)
  * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
  */
 void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+    dynamic_macro_event_t **macro_pointer, dynamic_macro_event_t *macro_buffer)
 {
     dprintln("dynamic macro recording: started");
 
@@ -82,15 +150,134 @@ void dynamic_macro_record_start(
     *macro_pointer = macro_buffer;
 }
 
+/**
+ * Replay a single recorded event. Pause events are skipped, they only
+ * hold a delay.
+ */
+void dynamic_macro_play_event(dynamic_macro_event_t event)
+{
+    uint8_t key = DYNAMIC_MACRO_EVENT_KEY(event);
+
+    if (key == DYNAMIC_MACRO_PAUSE) {
+        return;
+    }
+
+    keyrecord_t record = {
+        .event = {
+            .key = { .row = key / MATRIX_COLS, .col = key % MATRIX_COLS },
+            .pressed = event & DYNAMIC_MACRO_PRESSED,
+            .time = (timer_read() | 1), /* time should not be 0 */
+        },
+    };
+#ifndef NO_ACTION_TAPPING
+    record.tap.count = (event & DYNAMIC_MACRO_TAPPED) ? 1 : 0;
+#endif
+    process_record(&record);
+}
+
+#ifdef DYNAMIC_MACRO_TIMED_PLAYBACK
+/* The macro being played back. Its events are replayed from the main
+ * loop, each after its recorded delay, so that the keyboard keeps
+ * scanning in the meantime. */
+static struct {
+    dynamic_macro_event_t *pointer;
+    dynamic_macro_event_t *end;
+    int8_t direction;
+    deadline_token_t token;
+    uint32_t saved_layer_state;
+    /* The keys the macro has pressed and not released yet, one bit
+     * per key in the matrix. */
+    uint8_t held[(MATRIX_ROWS * MATRIX_COLS + 7) / 8];
+} dynamic_macro_playback;
+
+/**
+ * Release the keys the macro is holding. The keys the user holds are
+ * left alone, since the keyboard is scanned during the playback.
+ */
+void dynamic_macro_play_release(void)
+{
+    for (uint8_t key = 0; key < MATRIX_ROWS * MATRIX_COLS; key++) {
+        if (dynamic_macro_playback.held[key / 8] & (1 << (key % 8))) {
+            dynamic_macro_play_event((dynamic_macro_event_t)key << 8);
+        }
+    }
+    memset(dynamic_macro_playback.held, 0, sizeof(dynamic_macro_playback.held));
+}
+
+/**
+ * Stop the timed playback, releasing whatever the macro is holding.
+ */
+void dynamic_macro_play_stop(void)
+{
+    if (dynamic_macro_playback.token == DEADLINE_INVALID) {
+        return;
+    }
+
+    deadline_cancel(dynamic_macro_playback.token);
+    dynamic_macro_playback.token = DEADLINE_INVALID;
+
+    dynamic_macro_play_release();
+
+    layer_state = dynamic_macro_playback.saved_layer_state;
+}
+
+/**
+ * Replay the events that are due and return the delay until the next
+ * one, 0 when the macro has been played to the end.
+ */
+uint32_t dynamic_macro_play_step(uint32_t deadline, void *arg)
+{
+    while (dynamic_macro_playback.pointer != dynamic_macro_playback.end) {
+        dynamic_macro_event_t event = *dynamic_macro_playback.pointer;
+        dynamic_macro_playback.pointer += dynamic_macro_playback.direction;
+
+        uint8_t key = DYNAMIC_MACRO_EVENT_KEY(event);
+        if (key != DYNAMIC_MACRO_PAUSE) {
+            if (event & DYNAMIC_MACRO_PRESSED) {
+                dynamic_macro_playback.held[key / 8] |= 1 << (key % 8);
+            } else {
+                dynamic_macro_playback.held[key / 8] &= ~(1 << (key % 8));
+            }
+        }
+
+        dynamic_macro_play_event(event);
+
+        /* The event may have stopped the playback itself. */
+        if (dynamic_macro_playback.token == DEADLINE_INVALID) {
+            return 0;
+        }
+
+        if (dynamic_macro_playback.pointer != dynamic_macro_playback.end) {
+            uint16_t delay = dynamic_macro_decode_delay(
+                *dynamic_macro_playback.pointer & DYNAMIC_MACRO_DELAY_MASK);
+            if (delay) {
+                return delay;
+            }
+        }
+    }
+
+    dynamic_macro_playback.token = DEADLINE_INVALID;
+
+    dynamic_macro_play_release();
+
+    layer_state = dynamic_macro_playback.saved_layer_state;
+    return 0;
+}
+#endif
+
 /**
  * Play the dynamic macro.
  *
+ * With DYNAMIC_MACRO_TIMED_PLAYBACK the events are replayed with the
+ * delays they were recorded with, and this returns right away.
+ * Otherwise they are all replayed at once.
+ *
  * @param macro_buffer[in] The beginning of the macro buffer being played.
  * @param macro_end[in]    The element after the last macro buffer element.
  * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
  */
 void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+    dynamic_macro_event_t *macro_buffer, dynamic_macro_event_t *macro_end, int8_t direction)
 {
     dprintf("dynamic macro: slot %d playback\n", DYNAMIC_MACRO_CURRENT_SLOT());
 
@@ -99,8 +286,23 @@ void dynamic_macro_play(
     clear_keyboard();
     layer_clear();
 
+#ifdef DYNAMIC_MACRO_TIMED_PLAYBACK
+    if (macro_buffer != macro_end) {
+        dynamic_macro_playback.pointer = macro_buffer;
+        dynamic_macro_playback.end = macro_end;
+        dynamic_macro_playback.direction = direction;
+        dynamic_macro_playback.saved_layer_state = saved_layer_state;
+        /* The first event is never delayed. */
+        dynamic_macro_playback.token = deadline_schedule(0, dynamic_macro_play_step, NULL);
+        if (dynamic_macro_playback.token != DEADLINE_INVALID) {
+            return;
+        }
+        dprintln("dynamic macro: no deadline left, playing without delays");
+    }
+#endif
+
     while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
+        dynamic_macro_play_event(*macro_buffer);
         macro_buffer += direction;
     }
 
@@ -119,24 +321,61 @@ void dynamic_macro_play(
  * @param record[in]     The current keypress.
  */
 void dynamic_macro_record_key(
-    keyrecord_t *macro_buffer,
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro2_end,
+    dynamic_macro_event_t *macro_buffer,
+    dynamic_macro_event_t **macro_pointer,
+    dynamic_macro_event_t *macro2_end,
     int8_t direction,
     keyrecord_t *record)
 {
+    /* Only keys in the matrix can be replayed. */
+    if (record->event.key.row >= MATRIX_ROWS || record->event.key.col >= MATRIX_COLS) {
+        dprintln("dynamic macro: ignoring an event outside of the matrix");
+        return;
+    }
+
     /* If we've just started recording, ignore all the key releases. */
     if (!record->event.pressed && *macro_pointer == macro_buffer) {
         dprintln("dynamic macro: ignoring a leading key-up event");
         return;
     }
 
+    /* The first event is the start of the macro's time. */
+    if (*macro_pointer == macro_buffer) {
+        dynamic_macro_record_time = record->event.time;
+    }
+
+    uint16_t delay = record->event.time - dynamic_macro_record_time;
+    uint8_t pauses = 0;
+    while (delay > DYNAMIC_MACRO_MAX_DELAY) {
+        delay -= DYNAMIC_MACRO_MAX_DELAY;
+        pauses++;
+    }
+
     /* The other end of the other macro is the last buffer element it
      * is safe to use before overwriting the other macro.
      */
-    if (*macro_pointer - direction != macro2_end) {
-        **macro_pointer = *record;
+    if (DYNAMIC_MACRO_CURRENT_LENGTH(*macro_pointer, macro2_end) + 1 > pauses) {
+        for (; pauses > 0; pauses--) {
+            **macro_pointer = (dynamic_macro_event_t)DYNAMIC_MACRO_PAUSE << 8
+                | dynamic_macro_encode_delay(DYNAMIC_MACRO_MAX_DELAY);
+            *macro_pointer += direction;
+            dynamic_macro_record_time += DYNAMIC_MACRO_MAX_DELAY;
+        }
+
+        uint8_t code = dynamic_macro_encode_delay(delay);
+        dynamic_macro_event_t event = (dynamic_macro_event_t)(
+            record->event.key.row * MATRIX_COLS + record->event.key.col) << 8 | code;
+        if (record->event.pressed) {
+            event |= DYNAMIC_MACRO_PRESSED;
+        }
+#ifndef NO_ACTION_TAPPING
+        if (record->tap.count > 0) {
+            event |= DYNAMIC_MACRO_TAPPED;
+        }
+#endif
+        **macro_pointer = event;
         *macro_pointer += direction;
+        dynamic_macro_record_time += dynamic_macro_decode_delay(code);
     } else {
         dynamic_macro_led_blink();
     }
@@ -153,18 +392,20 @@ void dynamic_macro_record_key(
  * pointer to the end of the macro.
  */
 void dynamic_macro_record_end(
-    keyrecord_t *macro_buffer,
-    keyrecord_t *macro_pointer,
+    dynamic_macro_event_t *macro_buffer,
+    dynamic_macro_event_t *macro_pointer,
     int8_t direction,
-    keyrecord_t **macro_end)
+    dynamic_macro_event_t **macro_end)
 {
     dynamic_macro_led_blink();
 
     /* Do not save the keys being held when stopping the recording,
-     * i.e. the keys used to access the layer DYN_REC_STOP is on.
+     * i.e. the keys used to access the layer DYN_REC_STOP is on, nor
+     * the pauses before them.
      */
     while (macro_pointer != macro_buffer &&
-           (macro_pointer - direction)->event.pressed) {
+           (DYNAMIC_MACRO_EVENT_KEY(*(macro_pointer - direction)) == DYNAMIC_MACRO_PAUSE ||
+            (*(macro_pointer - direction) & DYNAMIC_MACRO_PRESSED))) {
         dprintln("dynamic macro: trimming a trailing key-down event");
         macro_pointer -= direction;
     }
@@ -177,6 +418,94 @@ void dynamic_macro_record_end(
     *macro_end = macro_pointer;
 }
 
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+/* The macros are kept in the EEPROM at DYNAMIC_MACRO_EEPROM_ADDR, as
+ * this header followed by a copy of the macro buffer. Only the part of
+ * the buffer a macro uses is written when it is recorded.
+ */
+typedef struct {
+    uint16_t magic;
+    uint16_t size;
+    uint16_t length[2];
+} dynamic_macro_eeprom_header_t;
+
+/* Changes with the matrix, since events store the key's index in it. */
+#define DYNAMIC_MACRO_EEPROM_MAGIC (uint16_t)(0xD300 | MATRIX_COLS)
+#define DYNAMIC_MACRO_EEPROM_HEADER ((dynamic_macro_eeprom_header_t *)(DYNAMIC_MACRO_EEPROM_ADDR))
+#define DYNAMIC_MACRO_EEPROM_BUFFER \
+    ((dynamic_macro_event_t *)(DYNAMIC_MACRO_EEPROM_ADDR + sizeof(dynamic_macro_eeprom_header_t)))
+
+/* Cleared to load the macros again with the next key event. */
+static bool dynamic_macro_loaded = false;
+
+/**
+ * Load the macros from the EEPROM again with the next key event, e.g.
+ * after something else has written them. Don't call it while a macro
+ * is being recorded or played back.
+ */
+void dynamic_macro_reload(void)
+{
+    dynamic_macro_loaded = false;
+}
+
+/**
+ * Load the macros saved in the EEPROM, or set up an empty copy there if
+ * it doesn't hold any.
+ */
+void dynamic_macro_load(
+    dynamic_macro_event_t *macro_buffer,
+    dynamic_macro_event_t **macro_end,
+    dynamic_macro_event_t **r_macro_end)
+{
+    dynamic_macro_eeprom_header_t header;
+    eeprom_read_block(&header, DYNAMIC_MACRO_EEPROM_HEADER, sizeof(header));
+
+    if (header.magic != DYNAMIC_MACRO_EEPROM_MAGIC || header.size != DYNAMIC_MACRO_SIZE ||
+        header.length[0] + header.length[1] > DYNAMIC_MACRO_SIZE) {
+        dprintln("dynamic macro: no macros saved");
+        header = (dynamic_macro_eeprom_header_t){
+            .magic = DYNAMIC_MACRO_EEPROM_MAGIC,
+            .size = DYNAMIC_MACRO_SIZE,
+        };
+        eeprom_update_block(&header, DYNAMIC_MACRO_EEPROM_HEADER, sizeof(header));
+        return;
+    }
+
+    uint16_t r_start = DYNAMIC_MACRO_SIZE - header.length[1];
+    eeprom_read_block(macro_buffer, DYNAMIC_MACRO_EEPROM_BUFFER,
+                      header.length[0] * sizeof(dynamic_macro_event_t));
+    eeprom_read_block(macro_buffer + r_start, DYNAMIC_MACRO_EEPROM_BUFFER + r_start,
+                      header.length[1] * sizeof(dynamic_macro_event_t));
+    *macro_end = macro_buffer + header.length[0];
+    *r_macro_end = macro_buffer + r_start - 1;
+
+    dprintf("dynamic macro: loaded, lengths: %d, %d\n", header.length[0], header.length[1]);
+}
+
+/**
+ * Save a macro that has just been recorded. Its length is cleared
+ * while its events are written, so that a macro that was only partly
+ * written is never loaded.
+ */
+void dynamic_macro_save(
+    dynamic_macro_event_t *macro_buffer,
+    dynamic_macro_event_t *macro_begin,
+    dynamic_macro_event_t *macro_end,
+    int8_t direction)
+{
+    uint16_t length = DYNAMIC_MACRO_CURRENT_LENGTH(macro_begin, macro_end);
+    /* The second macro's events are stored in reverse, ending at the
+     * end of the buffer. */
+    uint16_t start = direction > 0 ? 0 : DYNAMIC_MACRO_SIZE - length;
+    uint16_t *length_address = &DYNAMIC_MACRO_EEPROM_HEADER->length[DYNAMIC_MACRO_CURRENT_SLOT() - 1];
+
+    eeprom_update_word(length_address, 0);
+    eeprom_update_block(macro_buffer + start, DYNAMIC_MACRO_EEPROM_BUFFER + start,
+                        length * sizeof(dynamic_macro_event_t));
+    eeprom_update_word(length_address, length);
+}
+#endif
+
 /* Handle the key events related to the dynamic macros. Should be
  * called from process_record_user() like this:
  *
@@ -213,30 +542,63 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
      * macros or one long macro and one short macro. Or even one empty
      * and one using the whole buffer.
      */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
+    static dynamic_macro_event_t macro_buffer[DYNAMIC_MACRO_SIZE];
 
     /* Pointer to the first buffer element after the first macro.
      * Initially points to the very beginning of the buffer since the
      * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
+    static dynamic_macro_event_t *macro_end = macro_buffer;
 
     /* The other end of the macro buffer. Serves as the beginning of
      * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
+    static dynamic_macro_event_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
 
     /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
+    static dynamic_macro_event_t *r_macro_end = r_macro_buffer;
 
     /* A persistent pointer to the current macro position (iterator)
      * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+    static dynamic_macro_event_t *macro_pointer = NULL;
 
     /* 0   - no macro is being recorded right now
      * 1,2 - either macro 1 or 2 is being recorded */
     static uint8_t macro_id = 0;
 
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    if (!dynamic_macro_loaded) {
+        /* Start out empty, in case the EEPROM doesn't hold any. */
+        macro_end = macro_buffer;
+        r_macro_end = r_macro_buffer;
+        dynamic_macro_load(macro_buffer, &macro_end, &r_macro_end);
+        dynamic_macro_loaded = true;
+    }
+#endif
+
     if (macro_id == 0) {
         /* No macro recording in progress. */
+#ifdef DYNAMIC_MACRO_TIMED_PLAYBACK
+        if (dynamic_macro_playback.token != DEADLINE_INVALID) {
+            switch (keycode) {
+            case DYN_REC_STOP:
+                /* Stop the macro being played back. */
+                if (record->event.pressed) {
+                    dprintln("dynamic macro: playback stopped");
+                    dynamic_macro_play_stop();
+                }
+                return false;
+            case DYN_MACRO_PLAY1:
+            case DYN_MACRO_PLAY2:
+                dprintln("dynamic macro: ignoring macro play key while playing");
+                return false;
+            case DYN_REC_START1:
+            case DYN_REC_START2:
+                if (!record->event.pressed) {
+                    dynamic_macro_play_stop();
+                }
+                break;
+            }
+        }
+#endif
         if (!record->event.pressed) {
             switch (keycode) {
             case DYN_REC_START1:
@@ -266,9 +628,15 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
                 switch (macro_id) {
                 case 1:
                     dynamic_macro_record_end(macro_buffer, macro_pointer, +1, &macro_end);
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+                    dynamic_macro_save(macro_buffer, macro_buffer, macro_end, +1);
+#endif
                     break;
                 case 2:
                     dynamic_macro_record_end(r_macro_buffer, macro_pointer, -1, &r_macro_end);
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+                    dynamic_macro_save(macro_buffer, r_macro_buffer, r_macro_end, -1);
+#endif
                     break;
                 }
                 macro_id = 0;
@@ -299,5 +667,6 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 #undef DYNAMIC_MACRO_CURRENT_SLOT
 #undef DYNAMIC_MACRO_CURRENT_LENGTH
 #undef DYNAMIC_MACRO_CURRENT_CAPACITY
+#undef DYNAMIC_MACRO_EVENT_KEY
 
 #endif
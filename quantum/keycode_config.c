@@ -18,7 +18,23 @@
 
 extern keymap_config_t keymap_config;
 
-uint16_t keycode_config(uint16_t keycode) {
+/* The keycodes that keymap_config can change */
+static const uint8_t swappable_keycodes[] = {
+    KC_CAPSLOCK, KC_LOCKING_CAPS, KC_LCTL, KC_LALT, KC_LGUI, KC_RALT, KC_RGUI,
+    KC_GRAVE, KC_ESC, KC_BSLASH, KC_BSPACE
+};
+
+typedef struct {
+    uint8_t from;
+    uint8_t to;
+} keycode_patch_t;
+
+/* Only the swaps that are on, rebuilt when keymap_config changes */
+static keycode_patch_t patches[sizeof(swappable_keycodes)];
+static uint8_t patch_count = 0;
+static uint16_t patched_config = 0;
+
+static uint16_t keycode_swap(uint16_t keycode) {
 
     switch (keycode) {
         case KC_CAPSLOCK:
@@ -89,6 +105,30 @@ uint16_t keycode_config(uint16_t keycode) {
     }
 }
 
+static void keycode_config_update(void) {
+    patch_count = 0;
+    for (uint8_t i = 0; i < sizeof(swappable_keycodes); i++) {
+        uint8_t keycode = swappable_keycodes[i];
+        uint16_t swapped = keycode_swap(keycode);
+        if (swapped != keycode) {
+            patches[patch_count++] = (keycode_patch_t){ .from = keycode, .to = swapped };
+        }
+    }
+    patched_config = keymap_config.raw;
+}
+
+uint16_t keycode_config(uint16_t keycode) {
+    if (keymap_config.raw != patched_config) {
+        keycode_config_update();
+    }
+    for (uint8_t i = 0; i < patch_count; i++) {
+        if (patches[i].from == keycode) {
+            return patches[i].to;
+        }
+    }
+    return keycode;
+}
+
 uint8_t mod_config(uint8_t mod) {
     if (keymap_config.swap_lalt_lgui) {
         if ((mod & MOD_RGUI) == MOD_LGUI) {
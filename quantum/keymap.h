@@ -49,6 +49,11 @@ uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key);
 // translates function id to action
 uint16_t keymap_function_id_to_action( uint16_t function_id );
 
+#ifdef ACTION_TABLE_LAYERS
+// forgets the converted actions, call it when keymap_key_to_keycode() returns something else
+void action_table_invalidate(void);
+#endif
+
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
 extern const uint16_t fn_actions[];
 
@@ -36,16 +36,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 extern keymap_config_t keymap_config;
 
 #include <inttypes.h>
+#include <string.h>
 
-/* converts key to action */
-action_t action_for_key(uint8_t layer, keypos_t key)
+/* converts keycode to action */
+static action_t keycode_to_action(uint16_t keycode)
 {
-    // 16bit keycodes - important
-    uint16_t keycode = keymap_key_to_keycode(layer, key);
-
-    // keycode remapping
-    keycode = keycode_config(keycode);
-
     action_t action;
     uint8_t action_layer, when, mod;
 
@@ -164,6 +159,47 @@ action_t action_for_key(uint8_t layer, keypos_t key)
     return action;
 }
 
+#ifdef ACTION_TABLE_LAYERS
+/* actions of the first ACTION_TABLE_LAYERS layers, converted on first use */
+static action_t action_table[ACTION_TABLE_LAYERS][MATRIX_ROWS][MATRIX_COLS];
+static uint8_t action_table_valid[ACTION_TABLE_LAYERS][MATRIX_ROWS][(MATRIX_COLS + 7) / 8];
+static uint16_t action_table_config = 0;
+
+void action_table_invalidate(void)
+{
+    memset(action_table_valid, 0, sizeof(action_table_valid));
+}
+#endif
+
+/* converts key to action */
+action_t action_for_key(uint8_t layer, keypos_t key)
+{
+#ifdef ACTION_TABLE_LAYERS
+    if (layer < ACTION_TABLE_LAYERS) {
+        // swaps and mod taps depend on keymap_config
+        if (keymap_config.raw != action_table_config) {
+            action_table_invalidate();
+            action_table_config = keymap_config.raw;
+        }
+        uint8_t *valid = &action_table_valid[layer][key.row][key.col / 8];
+        uint8_t bit = 1 << (key.col % 8);
+        if (!(*valid & bit)) {
+            action_table[layer][key.row][key.col] = keycode_to_action(keycode_config(keymap_key_to_keycode(layer, key)));
+            *valid |= bit;
+        }
+        return action_table[layer][key.row][key.col];
+    }
+#endif
+
+    // 16bit keycodes - important
+    uint16_t keycode = keymap_key_to_keycode(layer, key);
+
+    // keycode remapping
+    keycode = keycode_config(keycode);
+
+    return keycode_to_action(keycode);
+}
+
 __attribute__ ((weak))
 const uint16_t PROGMEM fn_actions[] = {
 
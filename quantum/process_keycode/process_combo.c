@@ -16,9 +16,10 @@
 
 #include "process_combo.h"
 #include "print.h"
+#include "deadline.h"
 
 
-#define COMBO_TIMER_ELAPSED -1
+#define COMBO_TIMER_ELAPSED UINT16_MAX
 
 
 __attribute__ ((weak))
@@ -33,6 +34,13 @@ void process_combo_event(uint8_t combo_index, bool pressed) {
 
 static uint8_t current_combo_index = 0;
 
+// Times out the combos that were started, DEADLINE_INVALID while none is
+static deadline_token_t combo_deadline = DEADLINE_INVALID;
+// Set when no deadline was free, so that the scan has to check the timers
+static bool combo_deadline_missed = false;
+
+static uint32_t combo_timeout(uint32_t deadline, void *arg);
+
 static inline void send_combo(uint16_t action, bool pressed)
 {
     if (action) {
@@ -76,6 +84,10 @@ static bool process_single_combo(combo_t *combo, uint16_t keycode, keyrecord_t *
                 combo->timer = COMBO_TIMER_ELAPSED;
             } else { /* Combo key was pressed */
                 combo->timer = timer_read();
+                if (combo_deadline == DEADLINE_INVALID) {
+                    combo_deadline = deadline_schedule(COMBO_TERM + 1, combo_timeout, NULL);
+                    combo_deadline_missed = combo_deadline == DEADLINE_INVALID;
+                }
 #ifdef COMBO_ALLOW_ACTION_KEYS
                 combo->prev_record = *record;
 #else
@@ -124,17 +136,24 @@ bool process_combo(uint16_t keycode, keyrecord_t *record)
     return !is_combo_key;
 }
 
-void matrix_scan_combo(void)
+/* Ends the combos that weren't completed within COMBO_TERM, and returns the
+ * time until the next one ends, or 0 when none is started
+ */
+static uint16_t timeout_combos(void)
 {
+    uint16_t next = 0;
+
     for (int i = 0; i < COMBO_COUNT; ++i) {
         // Do not treat the (weak) key_combos too strict.
         #pragma GCC diagnostic push
         #pragma GCC diagnostic ignored "-Warray-bounds"
         combo_t *combo = &key_combos[i];
         #pragma GCC diagnostic pop
-        if (combo->timer &&
-            combo->timer != COMBO_TIMER_ELAPSED && 
-            timer_elapsed(combo->timer) > COMBO_TERM) {
+        if (!combo->timer || combo->timer == COMBO_TIMER_ELAPSED) {
+            continue;
+        }
+        uint16_t elapsed = timer_elapsed(combo->timer);
+        if (elapsed > COMBO_TERM) {
             
             /* This disables the combo, meaning key events for this
              * combo will be handled by the next processors in the chain 
@@ -149,6 +168,26 @@ void matrix_scan_combo(void)
             unregister_code16(combo->prev_key);
             register_code16(combo->prev_key);
 #endif
+        } else if (!next || COMBO_TERM + 1 - elapsed < next) {
+            next = COMBO_TERM + 1 - elapsed;
         }
     }
+    return next;
+}
+
+static uint32_t combo_timeout(uint32_t deadline, void *arg)
+{
+    uint16_t next = timeout_combos();
+    if (!next) {
+        combo_deadline = DEADLINE_INVALID;
+    }
+    return next;
+}
+
+void matrix_scan_combo(void)
+{
+    // The deadline times the combos out, unless none was free
+    if (combo_deadline_missed) {
+        combo_deadline_missed = timeout_combos() != 0;
+    }
 }
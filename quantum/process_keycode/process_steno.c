@@ -15,7 +15,7 @@
  */
 #include "process_steno.h"
 #include "quantum_keycodes.h"
-#include "eeprom.h"
+#include "eeconfig.h"
 #include "keymap_steno.h"
 #include "virtser.h"
 #include <string.h>
@@ -62,6 +62,8 @@ static uint8_t state[MAX_STATE_SIZE] = {0};
 static uint8_t chord[MAX_STATE_SIZE] = {0};
 static int8_t pressed = 0;
 static steno_mode_t mode;
+// Keys can come in before the boot has got to steno_init(), so they bring it up themselves
+static bool initialized = false;
 
 static const uint8_t boltmap[64] PROGMEM = {
   TXB_NUL, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM,
@@ -72,30 +74,57 @@ static const uint8_t boltmap[64] PROGMEM = {
   TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_Z_R
 };
 
+// Gemini PR packs 7 keys into each byte, this has the byte in the high bits and the mask in
+// the low ones
+#define GEMINI_CODE(key) (((key) / 7) << 8 | 1 << (6 - (key) % 7))
+#define GEMINI_CODES_7(n) GEMINI_CODE(n), GEMINI_CODE(n + 1), GEMINI_CODE(n + 2), GEMINI_CODE(n + 3), \
+  GEMINI_CODE(n + 4), GEMINI_CODE(n + 5), GEMINI_CODE(n + 6)
+
+static const uint16_t geminimap[42] PROGMEM = {
+  GEMINI_CODES_7(0), GEMINI_CODES_7(7), GEMINI_CODES_7(14),
+  GEMINI_CODES_7(21), GEMINI_CODES_7(28), GEMINI_CODES_7(35)
+};
+
 static void steno_clear_state(void) {
   memset(state, 0, sizeof(state));
   memset(chord, 0, sizeof(chord));
 }
 
-static void send_steno_state(uint8_t size, bool send_empty) {
-  for (uint8_t i = 0; i < size; ++i) {
-    if (chord[i] || send_empty) {
-      virtser_send(chord[i]);
+// TX Bolt sends only the groups that have keys down, and a 0 to end the chord
+static uint8_t steno_encode_bolt(const uint8_t *chord, uint8_t *packet) {
+  uint8_t length = 0;
+  for (uint8_t i = 0; i < BOLT_STATE_SIZE; ++i) {
+    if (chord[i]) {
+      packet[length++] = chord[i];
     }
   }
+  packet[length++] = 0; // terminating byte
+  return length;
+}
+
+// Gemini PR always sends all six bytes, the first with its top bit set
+static uint8_t steno_encode_gemini(const uint8_t *chord, uint8_t *packet) {
+  memcpy(packet, chord, GEMINI_STATE_SIZE);
+  packet[0] |= 0x80; // Indicate start of packet
+  return GEMINI_STATE_SIZE;
 }
 
 void steno_init() {
+  if (initialized) {
+    return;
+  }
   if (!eeconfig_is_enabled()) {
     eeconfig_init();
   }
-  mode = eeprom_read_byte(EECONFIG_STENOMODE);
+  mode = eeconfig_read_steno_mode();
+  initialized = true;
 }
 
 void steno_set_mode(steno_mode_t new_mode) {
   steno_clear_state();
+  initialized = true;
   mode = new_mode;
-  eeprom_update_byte(EECONFIG_STENOMODE, mode);
+  eeconfig_update_steno_mode(mode);
 }
 
 /* override to intercept chords right before they get sent.
@@ -110,18 +139,21 @@ bool postprocess_steno_user(uint16_t keycode, keyrecord_t *record, steno_mode_t
 __attribute__ ((weak))
 bool process_steno_user(uint16_t keycode, keyrecord_t *record) { return true; }
 
+// The whole chord is handed to the virtual serial port at once, so that it
+// goes to the host in one packet
 static void send_steno_chord(void) {
   if (send_steno_chord_user(mode, chord)) {
+    uint8_t packet[MAX_STATE_SIZE + 1];
+    uint8_t length = 0;
     switch(mode) {
       case STENO_MODE_BOLT:
-	send_steno_state(BOLT_STATE_SIZE, false);
-	virtser_send(0); // terminating byte
+	length = steno_encode_bolt(chord, packet);
 	break;
       case STENO_MODE_GEMINI:
-	chord[0] |= 0x80; // Indicate start of packet
-	send_steno_state(GEMINI_STATE_SIZE, true);
+	length = steno_encode_gemini(chord, packet);
 	break;
     }
+    virtser_send_buffer(packet, length);
   }
   steno_clear_state();
 }
@@ -146,8 +178,9 @@ static bool update_state_bolt(uint8_t key, bool press) {
 }
 
 static bool update_state_gemini(uint8_t key, bool press) {
-  int idx = key / 7;
-  uint8_t bit = 1 << (6 - (key % 7));
+  uint16_t code = pgm_read_word(geminimap + key);
+  uint8_t idx = code >> 8;
+  uint8_t bit = code & 0xff;
   if (press) {
     state[idx] |= bit;
     chord[idx] |= bit;
@@ -181,9 +214,11 @@ bool process_steno(uint16_t keycode, keyrecord_t *record) {
       if (!process_steno_user(keycode, record)) {
 	return false;
       }
+      steno_init();
       switch(mode) {
 	case STENO_MODE_BOLT:
 	  update_state_bolt(keycode - QK_STENO, IS_PRESSED(record->event));
+	  break;
 	case STENO_MODE_GEMINI:
 	  update_state_gemini(keycode - QK_STENO, IS_PRESSED(record->event));
       }
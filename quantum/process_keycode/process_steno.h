@@ -22,6 +22,12 @@
   #error "must have virtser enabled to use steno"
 #endif
 
+// A stroke is sent when its last key is released, so every key that changed in a
+// scan is processed in that scan, instead of one key per scan
+#ifndef QMK_KEYS_PER_SCAN
+  #define QMK_KEYS_PER_SCAN (MATRIX_ROWS * MATRIX_COLS)
+#endif
+
 typedef enum { STENO_MODE_BOLT, STENO_MODE_GEMINI } steno_mode_t;
 
 bool process_steno(uint16_t keycode, keyrecord_t *record);
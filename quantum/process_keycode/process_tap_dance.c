@@ -15,12 +15,21 @@
  */
 #include "quantum.h"
 #include "action_tapping.h"
+#include "deadline.h"
 
 uint8_t get_oneshot_mods(void);
 
 static uint16_t last_td;
 static int8_t highest_td = -1;
 
+// Dances in flight, so that idle scans and key presses don't look at every dance
+static uint8_t active_td[TAP_DANCE_MAX_ACTIVE];
+static uint8_t active_td_count = 0;
+// Set when more dances were in flight than fit, until all of them are done
+static bool active_td_overflow = false;
+// Set when a dance in flight got no deadline, so that the scan has to check the timers
+static bool td_deadline_missed = false;
+
 void qk_tap_dance_pair_on_each_tap (qk_tap_dance_state_t *state, void *user_data) {
   qk_tap_dance_pair_t *pair = (qk_tap_dance_pair_t *)user_data;
 
@@ -110,23 +119,98 @@ static inline void process_tap_dance_action_on_reset (qk_tap_dance_action_t *act
   send_keyboard_report();
 }
 
-void preprocess_tap_dance(uint16_t keycode, keyrecord_t *record) {
-  qk_tap_dance_action_t *action;
+static inline uint16_t get_tap_dance_term (qk_tap_dance_action_t *action)
+{
+  return action->custom_tapping_term > 0 ? action->custom_tapping_term : TAPPING_TERM;
+}
+
+static void add_active_tap_dance (uint8_t idx)
+{
+  for (uint8_t i = 0; i < active_td_count; i++) {
+    if (active_td[i] == idx)
+      return;
+  }
+  if (active_td_count < TAP_DANCE_MAX_ACTIVE) {
+    active_td[active_td_count++] = idx;
+  } else {
+    active_td_overflow = true;
+  }
+}
+
+static void remove_active_tap_dance (uint8_t idx)
+{
+  for (uint8_t i = 0; i < active_td_count; i++) {
+    if (active_td[i] == idx) {
+      active_td[i] = active_td[--active_td_count];
+      break;
+    }
+  }
+  if (active_td_overflow && active_td_count == 0) {
+    // Only the dances that didn't fit may still be in flight
+    for (int i = 0; i <= highest_td; i++) {
+      if (tap_dance_actions[i].state.count)
+        return;
+    }
+    active_td_overflow = false;
+  }
+}
+
+static void finish_tap_dance (qk_tap_dance_action_t *action)
+{
+  if (action->state.count) {
+    process_tap_dance_action_on_dance_finished (action);
+    reset_tap_dance (&action->state);
+  }
+}
+
+static uint32_t tap_dance_timeout (uint32_t deadline, void *arg)
+{
+  qk_tap_dance_action_t *action = (qk_tap_dance_action_t *)arg;
+
+  action->state.deadline = DEADLINE_INVALID;
+  finish_tap_dance (action);
+  return 0;
+}
+
+// Ends the dance once its tapping term is over, counted from the latest tap
+static void start_tap_dance_term (qk_tap_dance_action_t *action)
+{
+  // It is over once more than the tapping term has passed
+  uint32_t delay = get_tap_dance_term(action) + 1;
+
+  if (!deadline_extend(action->state.deadline, delay)) {
+    action->state.deadline = deadline_schedule(delay, tap_dance_timeout, action);
+    if (action->state.deadline == DEADLINE_INVALID)
+      td_deadline_missed = true;
+  }
+}
 
+static void interrupt_tap_dance (qk_tap_dance_action_t *action, uint16_t keycode)
+{
+  if (action->state.count) {
+    if (keycode == action->state.keycode && keycode == last_td)
+      return;
+    action->state.interrupted = true;
+    process_tap_dance_action_on_dance_finished (action);
+    reset_tap_dance (&action->state);
+  }
+}
+
+void preprocess_tap_dance(uint16_t keycode, keyrecord_t *record) {
   if (!record->event.pressed)
     return;
 
-  if (highest_td == -1)
+  if (active_td_count == 0 && !active_td_overflow)
     return;
 
-  for (int i = 0; i <= highest_td; i++) {
-    action = &tap_dance_actions[i];
-    if (action->state.count) {
-      if (keycode == action->state.keycode && keycode == last_td)
-        continue;
-      action->state.interrupted = true;
-      process_tap_dance_action_on_dance_finished (action);
-      reset_tap_dance (&action->state);
+  if (active_td_overflow) {
+    for (int i = 0; i <= highest_td; i++) {
+      interrupt_tap_dance (&tap_dance_actions[i], keycode);
+    }
+  } else {
+    // Resetting a dance removes it from the active set, so walk it backwards
+    for (uint8_t i = active_td_count; i > 0; i--) {
+      interrupt_tap_dance (&tap_dance_actions[active_td[i - 1]], keycode);
     }
   }
 }
@@ -143,9 +227,11 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
     action->state.pressed = record->event.pressed;
     if (record->event.pressed) {
+      add_active_tap_dance (idx);
       action->state.keycode = keycode;
       action->state.count++;
       action->state.timer = timer_read();
+      start_tap_dance_term (action);
       action->state.oneshot_mods = get_oneshot_mods();
       action->state.weak_mods = get_mods();
       action->state.weak_mods |= get_weak_mods();
@@ -166,26 +252,35 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
 
 
-void matrix_scan_tap_dance () {
-  if (highest_td == -1)
-    return;
-  uint16_t tap_user_defined;
+static void finish_expired_tap_dance (qk_tap_dance_action_t *action)
+{
+  if (timer_elapsed (action->state.timer) > get_tap_dance_term(action)) {
+    finish_tap_dance (action);
+  }
+}
 
-  for (uint8_t i = 0; i <= highest_td; i++) {
+// Only needed for the dances that got no deadline
+static void finish_expired_tap_dances (void)
+{
+  td_deadline_missed = false;
+  for (int i = 0; i <= highest_td; i++) {
     qk_tap_dance_action_t *action = &tap_dance_actions[i];
-    if(action->custom_tapping_term > 0 ) {
-      tap_user_defined = action->custom_tapping_term;
-    }
-    else{
-      tap_user_defined = TAPPING_TERM;
-    }
-    if (action->state.count && timer_elapsed (action->state.timer) > tap_user_defined) {
-      process_tap_dance_action_on_dance_finished (action);
-      reset_tap_dance (&action->state);
-    }
+    if (action->state.deadline != DEADLINE_INVALID)
+      continue;
+    finish_expired_tap_dance (action);
+    if (action->state.count && !action->state.finished)
+      td_deadline_missed = true;
   }
 }
 
+void matrix_scan_tap_dance () {
+  // The deadlines end the dances in flight, unless one wasn't free
+  if (!td_deadline_missed)
+    return;
+
+  finish_expired_tap_dances();
+}
+
 void reset_tap_dance (qk_tap_dance_state_t *state) {
   qk_tap_dance_action_t *action;
 
@@ -196,8 +291,11 @@ void reset_tap_dance (qk_tap_dance_state_t *state) {
 
   process_tap_dance_action_on_reset (action);
 
+  deadline_cancel (state->deadline);
+  state->deadline = DEADLINE_INVALID;
   state->count = 0;
   state->interrupted = false;
   state->finished = false;
   last_td = 0;
+  remove_active_tap_dance (state->keycode - QK_TAP_DANCE);
 }
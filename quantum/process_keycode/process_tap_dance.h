@@ -20,6 +20,12 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include "deadline.h"
+
+// Dances that can be in flight at once before falling back to checking all of them
+#ifndef TAP_DANCE_MAX_ACTIVE
+#define TAP_DANCE_MAX_ACTIVE 8
+#endif
 
 typedef struct
 {
@@ -28,6 +34,7 @@ typedef struct
   uint8_t weak_mods;
   uint16_t keycode;
   uint16_t timer;
+  deadline_token_t deadline;
   bool interrupted;
   bool pressed;
   bool finished;
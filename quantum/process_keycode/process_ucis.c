@@ -15,6 +15,7 @@
  */
 
 #include "process_ucis.h"
+#include <string.h>
 
 qk_ucis_state_t qk_ucis_state;
 
@@ -32,32 +33,32 @@ void qk_ucis_start_user(void) {
   unicode_input_finish();
 }
 
-static bool is_uni_seq(char *seq) {
+// The symbol typed before the final key, as text to compare to the table. False if it
+// has keys that no symbol can have.
+static bool get_typed_symbol(char *symbol) {
   uint8_t i;
 
-  for (i = 0; seq[i]; i++) {
-    uint16_t code;
-    if (('1' <= seq[i]) && (seq[i] <= '0'))
-      code = seq[i] - '1' + KC_1;
+  for (i = 0; i < qk_ucis_state.count - 1; i++) {
+    uint16_t code = qk_ucis_state.codes[i];
+    if (KC_A <= code && code <= KC_Z)
+      symbol[i] = code - KC_A + 'a';
+    else if (KC_1 <= code && code <= KC_9)
+      symbol[i] = code - KC_1 + '1';
+    else if (code == KC_0)
+      symbol[i] = '0';
     else
-      code = seq[i] - 'a' + KC_A;
-
-    if (i > qk_ucis_state.count || qk_ucis_state.codes[i] != code)
       return false;
   }
-
-  return (qk_ucis_state.codes[i] == KC_ENT ||
-          qk_ucis_state.codes[i] == KC_SPC);
+  symbol[i] = 0;
+  return true;
 }
 
 __attribute__((weak))
 void qk_ucis_symbol_fallback (void) {
   for (uint8_t i = 0; i < qk_ucis_state.count - 1; i++) {
-    uint8_t code = qk_ucis_state.codes[i];
-    register_code(code);
-    unregister_code(code);
-    wait_ms(UNICODE_TYPE_DELAY);
+    send_string_tap(qk_ucis_state.codes[i], false);
   }
+  send_string_flush();
 }
 
 void register_ucis(const char *hex) {
@@ -81,11 +82,10 @@ void register_ucis(const char *hex) {
     }
 
     if (kc) {
-      register_code (kc);
-      unregister_code (kc);
-      wait_ms (UNICODE_TYPE_DELAY);
+      send_string_tap(kc, false);
     }
   }
+  send_string_flush();
 }
 
 bool process_ucis (uint16_t keycode, keyrecord_t *record) {
@@ -119,22 +119,24 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
     bool symbol_found = false;
 
     for (i = qk_ucis_state.count; i > 0; i--) {
-      register_code (KC_BSPC);
-      unregister_code (KC_BSPC);
-      wait_ms(UNICODE_TYPE_DELAY);
+      send_string_tap(KC_BSPC, false);
     }
+    send_string_flush();
 
     if (keycode == KC_ESC) {
       qk_ucis_state.in_progress = false;
       return false;
     }
 
+    char symbol[UCIS_MAX_SYMBOL_LENGTH + 1];
     unicode_input_start();
-    for (i = 0; ucis_symbol_table[i].symbol; i++) {
-      if (is_uni_seq (ucis_symbol_table[i].symbol)) {
-        symbol_found = true;
-        register_ucis(ucis_symbol_table[i].code + 2);
-        break;
+    if (get_typed_symbol(symbol)) {
+      for (i = 0; ucis_symbol_table[i].symbol; i++) {
+        if (strcmp(ucis_symbol_table[i].symbol, symbol) == 0) {
+          symbol_found = true;
+          register_ucis(ucis_symbol_table[i].code + 2);
+          break;
+        }
       }
     }
     if (!symbol_found) {
@@ -31,7 +31,8 @@ typedef struct {
 
 typedef struct {
   uint8_t count;
-  uint16_t codes[UCIS_MAX_SYMBOL_LENGTH];
+  // The symbol and the key that ends it
+  uint16_t codes[UCIS_MAX_SYMBOL_LENGTH + 1];
   bool in_progress:1;
 } qk_ucis_state_t;
 
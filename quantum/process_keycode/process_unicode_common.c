@@ -15,7 +15,7 @@
  */
 
 #include "process_unicode_common.h"
-#include "eeprom.h"
+#include "eeconfig.h"
 
 static uint8_t input_mode;
 uint8_t mods;
@@ -23,7 +23,7 @@ uint8_t mods;
 void set_unicode_input_mode(uint8_t os_target)
 {
   input_mode = os_target;
-  eeprom_update_byte(EECONFIG_UNICODEMODE, os_target);
+  eeconfig_update_unicode_mode(os_target);
 }
 
 uint8_t get_unicode_input_mode(void) {
@@ -32,44 +32,46 @@ uint8_t get_unicode_input_mode(void) {
 
 __attribute__((weak))
 void unicode_input_start (void) {
-  // save current mods
-  mods = keyboard_report->mods;
-
-  // unregister all mods to start from clean state
-  if (mods & MOD_BIT(KC_LSFT)) unregister_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) unregister_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) unregister_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) unregister_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) unregister_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) unregister_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) unregister_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) unregister_code(KC_RGUI);
+  // save current mods, and start from a clean state in the same report as the
+  // first keys of the sequence
+  mods = get_mods();
+  clear_mods();
 
   switch(input_mode) {
   case UC_OSX:
-    register_code(KC_LALT);
+    add_mods(MOD_BIT(KC_LALT));
+    send_keyboard_report();
     break;
   case UC_OSX_RALT:
-    register_code(KC_RALT);
+    add_mods(MOD_BIT(KC_RALT));
+    send_keyboard_report();
     break;
   case UC_LNX:
-    register_code(KC_LCTL);
-    register_code(KC_LSFT);
-    register_code(KC_U);
-    unregister_code(KC_U);
-    unregister_code(KC_LSFT);
-    unregister_code(KC_LCTL);
+    add_mods(MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT));
+    add_key(KC_U);
+    send_keyboard_report();
+    del_key(KC_U);
+    clear_mods();
+    send_keyboard_report();
     break;
   case UC_WIN:
-    register_code(KC_LALT);
-    register_code(KC_PPLS);
-    unregister_code(KC_PPLS);
+    add_mods(MOD_BIT(KC_LALT));
+    add_key(KC_PPLS);
+    send_keyboard_report();
+    del_key(KC_PPLS);
+    send_keyboard_report();
     break;
   case UC_WINC:
-    register_code(KC_RALT);
-    unregister_code(KC_RALT);
-    register_code(KC_U);
-    unregister_code(KC_U);
+    add_mods(MOD_BIT(KC_RALT));
+    send_keyboard_report();
+    clear_mods();
+    add_key(KC_U);
+    send_keyboard_report();
+    del_key(KC_U);
+    send_keyboard_report();
+    break;
+  default:
+    if (mods) send_keyboard_report();
   }
   wait_ms(UNICODE_TYPE_DELAY);
 }
@@ -79,44 +81,38 @@ void unicode_input_finish (void) {
   switch(input_mode) {
     case UC_OSX:
     case UC_WIN:
-      unregister_code(KC_LALT);
+      del_mods(MOD_BIT(KC_LALT));
       break;
     case UC_OSX_RALT:
-      unregister_code(KC_RALT);
+      del_mods(MOD_BIT(KC_RALT));
       break;
     case UC_LNX:
-      register_code(KC_SPC);
-      unregister_code(KC_SPC);
+      add_key(KC_SPC);
+      send_keyboard_report();
+      del_key(KC_SPC);
       break;
   }
 
-  // reregister previously set mods
-  if (mods & MOD_BIT(KC_LSFT)) register_code(KC_LSFT);
-  if (mods & MOD_BIT(KC_RSFT)) register_code(KC_RSFT);
-  if (mods & MOD_BIT(KC_LCTL)) register_code(KC_LCTL);
-  if (mods & MOD_BIT(KC_RCTL)) register_code(KC_RCTL);
-  if (mods & MOD_BIT(KC_LALT)) register_code(KC_LALT);
-  if (mods & MOD_BIT(KC_RALT)) register_code(KC_RALT);
-  if (mods & MOD_BIT(KC_LGUI)) register_code(KC_LGUI);
-  if (mods & MOD_BIT(KC_RGUI)) register_code(KC_RGUI);
+  // reregister previously set mods, in the same report as the release
+  set_mods(mods);
+  send_keyboard_report();
 }
 
+static const uint8_t PROGMEM hex_keycodes[] = {
+  KC_0, KC_1, KC_2, KC_3, KC_4, KC_5, KC_6, KC_7,
+  KC_8, KC_9, KC_A, KC_B, KC_C, KC_D, KC_E, KC_F
+};
+
 __attribute__((weak))
 uint16_t hex_to_keycode(uint8_t hex)
 {
-  if (hex == 0x0) {
-    return KC_0;
-  } else if (hex < 0xA) {
-    return KC_1 + (hex - 0x1);
-  } else {
-    return KC_A + (hex - 0xA);
-  }
+  return pgm_read_byte(&hex_keycodes[hex & 0xF]);
 }
 
 void register_hex(uint16_t hex) {
   for(int i = 3; i >= 0; i--) {
     uint8_t digit = ((hex >> (i*4)) & 0xF);
-    register_code(hex_to_keycode(digit));
-    unregister_code(hex_to_keycode(digit));
+    send_string_tap(hex_to_keycode(digit), false);
   }
+  send_string_flush();
 }
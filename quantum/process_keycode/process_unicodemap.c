@@ -30,15 +30,14 @@ void register_hex32(uint32_t hex) {
     uint8_t digit = ((hex >> (i*4)) & 0xF);
     if (digit == 0) {
       if (!onzerostart) {
-        register_code(hex_to_keycode(digit));
-        unregister_code(hex_to_keycode(digit));
+        send_string_tap(hex_to_keycode(digit), false);
       }
     } else {
-      register_code(hex_to_keycode(digit));
-      unregister_code(hex_to_keycode(digit));
+      send_string_tap(hex_to_keycode(digit), false);
       onzerostart = false;
     }
   }
+  send_string_flush();
 }
 
 __attribute__((weak))
@@ -162,6 +162,7 @@ void reset_keyboard(void) {
 #ifdef BOOTLOADER_CATERINA
   *(uint16_t *)0x0800 = 0x7777; // these two are a-star-specific
 #endif
+  eeconfig_flush();
   bootloader_jump();
 }
 
@@ -719,10 +720,74 @@ void send_string_P(const char *str) {
   send_string_with_delay_P(str, 0);
 }
 
+/* Keys that send_string() holds down. Characters are typed by adding their key to the
+ * report, and keys are only released when a key has to be typed again or the report
+ * is full. Keys are added in ascending order only, so the host sees them pressed in
+ * the right order whether it goes by report position or by usage. Shift stays held
+ * for runs of shifted characters. */
+static uint8_t string_keys[SEND_STRING_MAX_KEYS];
+static uint8_t string_key_count = 0;
+static bool string_shifted = false;
+
+static void send_string_release(void) {
+    for (uint8_t i = 0; i < string_key_count; i++) {
+        del_key(string_keys[i]);
+    }
+    string_key_count = 0;
+}
+
+void send_string_flush(void) {
+    if (!string_key_count && !string_shifted) return;
+    send_string_release();
+    if (string_shifted) {
+        del_weak_mods(MOD_BIT(KC_LSFT));
+        string_shifted = false;
+    }
+    send_keyboard_report();
+}
+
+void send_string_tap(uint8_t keycode, bool shifted) {
+    if (keycode == KC_NO) return;
+
+    for (uint8_t i = 0; i < string_key_count; i++) {
+        if (string_keys[i] == keycode) {
+            // has to be released before it can be typed again
+            send_string_release();
+            send_keyboard_report();
+            break;
+        }
+    }
+    if (string_key_count && (string_key_count == SEND_STRING_MAX_KEYS || keycode < string_keys[string_key_count - 1])) {
+        // released in the same report as the new key is pressed
+        send_string_release();
+    }
+
+    if (shifted != string_shifted) {
+        if (shifted) {
+            add_weak_mods(MOD_BIT(KC_LSFT));
+        } else {
+            del_weak_mods(MOD_BIT(KC_LSFT));
+        }
+        string_shifted = shifted;
+    }
+    add_key(keycode);
+    string_keys[string_key_count++] = keycode;
+    send_keyboard_report();
+}
+
+static void send_string_char(char ascii_code) {
+    uint8_t keycode = pgm_read_byte(&ascii_to_keycode_lut[(uint8_t)ascii_code]);
+    bool shifted = pgm_read_byte(&ascii_to_shift_lut[(uint8_t)ascii_code]);
+    send_string_tap(keycode, shifted);
+}
+
 void send_string_with_delay(const char *str, uint8_t interval) {
     while (1) {
         char ascii_code = *str;
         if (!ascii_code) break;
+        if ((uint8_t)ascii_code <= 3 || interval) {
+          send_string_flush();
+        }
         if (ascii_code == 1) {
           // tap
           uint8_t keycode = *(++str);
@@ -736,19 +801,25 @@ void send_string_with_delay(const char *str, uint8_t interval) {
           // up
           uint8_t keycode = *(++str);
           unregister_code(keycode);
-        } else {
+        } else if (interval) {
           send_char(ascii_code);
+        } else {
+          send_string_char(ascii_code);
         }
         ++str;
         // interval
         { uint8_t ms = interval; while (ms--) wait_ms(1); }
     }
+    send_string_flush();
 }
 
 void send_string_with_delay_P(const char *str, uint8_t interval) {
     while (1) {
         char ascii_code = pgm_read_byte(str);
         if (!ascii_code) break;
+        if ((uint8_t)ascii_code <= 3 || interval) {
+          send_string_flush();
+        }
         if (ascii_code == 1) {
           // tap
           uint8_t keycode = pgm_read_byte(++str);
@@ -762,13 +833,16 @@ void send_string_with_delay_P(const char *str, uint8_t interval) {
           // up
           uint8_t keycode = pgm_read_byte(++str);
           unregister_code(keycode);
-        } else {
+        } else if (interval) {
           send_char(ascii_code);
+        } else {
+          send_string_char(ascii_code);
         }
         ++str;
         // interval
         { uint8_t ms = interval; while (ms--) wait_ms(1); }
     }
+    send_string_flush();
 }
 
 void send_char(char ascii_code) {
@@ -845,12 +919,7 @@ void matrix_init_quantum() {
   #ifdef BACKLIGHT_ENABLE
     backlight_init_ports();
   #endif
-  #ifdef AUDIO_ENABLE
-    audio_init();
-  #endif
-  #ifdef RGB_MATRIX_ENABLE
-    rgb_matrix_init_drivers();
-  #endif
+  // audio and the RGB matrix drivers are brought up after the first scans by keyboard_task()
   matrix_init_kb();
 }
 
@@ -862,6 +931,7 @@ uint8_t rgb_matrix_task_counter = 0;
 
 void matrix_scan_quantum() {
   #if defined(AUDIO_ENABLE)
+    audio_task();
     matrix_scan_music();
   #endif
 
@@ -138,6 +138,10 @@ extern uint32_t default_layer_state;
 #define SS_RALT(string) SS_DOWN(X_RALT) string SS_UP(X_RALT)
 
 #define SEND_STRING(str) send_string_P(PSTR(str))
+// Keys held down at once while typing a string, 1 types one key per report
+#ifndef SEND_STRING_MAX_KEYS
+  #define SEND_STRING_MAX_KEYS 6
+#endif
 extern const bool ascii_to_shift_lut[0x80];
 extern const uint8_t ascii_to_keycode_lut[0x80];
 void send_string(const char *str);
@@ -145,6 +149,9 @@ void send_string_with_delay(const char *str, uint8_t interval);
 void send_string_P(const char *str);
 void send_string_with_delay_P(const char *str, uint8_t interval);
 void send_char(char ascii_code);
+// Types a key the way send_string() does, it may stay down until send_string_flush()
+void send_string_tap(uint8_t keycode, bool shifted);
+void send_string_flush(void);
 
 // For tri-layer
 void update_tri_layer(uint8_t layer1, uint8_t layer2, uint8_t layer3);
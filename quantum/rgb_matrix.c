@@ -37,10 +37,6 @@ rgb_config_t rgb_matrix_config;
     #define RGB_DISABLE_WHEN_USB_SUSPENDED false
 #endif
 
-#ifndef EECONFIG_RGB_MATRIX
-    #define EECONFIG_RGB_MATRIX EECONFIG_RGBLIGHT
-#endif
-
 bool g_suspend_state = false;
 
 // Global tick at 20 Hz
@@ -56,11 +52,20 @@ uint32_t g_any_key_hit = 0;
 #define PI 3.14159265
 #endif
 
+// Shares the rgblight config in the eeconfig store, unless given its own address
 uint32_t eeconfig_read_rgb_matrix(void) {
+#ifdef EECONFIG_RGB_MATRIX
   return eeprom_read_dword(EECONFIG_RGB_MATRIX);
+#else
+  return eeconfig_read_rgb();
+#endif
 }
 void eeconfig_update_rgb_matrix(uint32_t val) {
+#ifdef EECONFIG_RGB_MATRIX
   eeprom_update_dword(EECONFIG_RGB_MATRIX, val);
+#else
+  eeconfig_update_rgb(val);
+#endif
 }
 void eeconfig_update_rgb_matrix_default(void) {
   dprintf("eeconfig_update_rgb_matrix_default\n");
@@ -102,7 +107,13 @@ void map_row_column_to_led( uint8_t row, uint8_t column, uint8_t *led_i, uint8_t
 }
 
 
+// The drivers are brought up after the first scans, see keyboard_init()
+static bool rgb_matrix_drivers_initialized = false;
+
 void rgb_matrix_update_pwm_buffers(void) {
+    if (!rgb_matrix_drivers_initialized) {
+        return;
+    }
     IS31FL3731_update_pwm_buffers( DRIVER_ADDR_1, DRIVER_ADDR_2 );
     IS31FL3731_update_led_control_registers( DRIVER_ADDR_1, DRIVER_ADDR_2 );
 }
@@ -734,6 +745,7 @@ void rgb_matrix_init_drivers(void) {
     }
     // This actually updates the LED drivers
     IS31FL3731_update_led_control_registers( DRIVER_ADDR_1, DRIVER_ADDR_2 );
+    rgb_matrix_drivers_initialized = true;
 
     // TODO: put the 1 second startup delay here?
 
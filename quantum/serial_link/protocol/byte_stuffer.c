@@ -38,7 +38,13 @@ typedef struct byte_stuffer_state {
     uint8_t data[MAX_FRAME_SIZE];
 }byte_stuffer_state_t;
 
+// The worst case overhead is one code byte for every 254 bytes of data,
+// plus the first code byte and the terminating zero
+#define MAX_ENCODED_FRAME_SIZE (MAX_FRAME_SIZE + MAX_FRAME_SIZE / 254 + 2)
+
 static byte_stuffer_state_t states[NUM_LINKS];
+// All frames are sent from the same thread, so one transmit buffer is enough
+static uint8_t send_buffer[MAX_ENCODED_FRAME_SIZE];
 
 void init_byte_stuffer_state(byte_stuffer_state_t* state) {
     state->next_zero = 0;
@@ -53,8 +59,7 @@ void init_byte_stuffer(void) {
     }
 }
 
-void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
-    byte_stuffer_state_t* state = &states[link];
+static void recv_byte(byte_stuffer_state_t* state, uint8_t link, uint8_t data) {
     // Start of a new frame
     if (state->next_zero == 0) {
         state->next_zero = data;
@@ -67,6 +72,7 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
     if (data == 0) {
         if (state->next_zero == 0) {
             // The frame is completed
+            // It's decoded in place, so the upper layers receive a pointer to the state buffer
             if (state->data_pos > 0) {
                 validator_recv_frame(link, state->data, state->data_pos);
             }
@@ -102,41 +108,68 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
     }
 }
 
-static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
-    send_data(link, &num_non_zero, 1);
-    if (end > start) {
-        send_data(link, start, end-start);
+void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
+    recv_byte(&states[link], link, data);
+}
+
+void byte_stuffer_recv_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    byte_stuffer_state_t* state = &states[link];
+    const uint8_t* end = data + size;
+    while (data < end) {
+        recv_byte(state, link, *data++);
     }
 }
 
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    const uint8_t zero = 0;
-    if (size > 0) {
-        uint16_t num_non_zero = 1;
-        uint8_t* end = data + size;
-        uint8_t* start = data;
+    frame_segment_t segment = {
+        .data = data,
+        .size = size
+    };
+    byte_stuffer_send_segments(link, &segment, 1);
+}
+
+void byte_stuffer_send_segments(uint8_t link, const frame_segment_t* segments, uint8_t num_segments) {
+    uint16_t size = 0;
+    uint8_t i;
+    for (i=0;i<num_segments;i++) {
+        size += segments[i].size;
+    }
+    // The receiver would discard a bigger frame anyway
+    if (size == 0 || size > MAX_FRAME_SIZE) {
+        return;
+    }
+
+    // The code byte of each block is filled in when the block is completed
+    uint8_t* code = send_buffer;
+    uint8_t* out = send_buffer + 1;
+    uint8_t num_non_zero = 1;
+    for (i=0;i<num_segments;i++) {
+        const uint8_t* data = segments[i].data;
+        const uint8_t* end = data + segments[i].size;
         while (data < end) {
             if (num_non_zero == 0xFF) {
                 // There's more data after big non-zero block
-                // So send it, and start a new block
-                send_block(link, start, data, num_non_zero);
-                start = data;
+                // So close it, and start a new block
+                *code = num_non_zero;
+                code = out++;
                 num_non_zero = 1;
             }
             else {
                 if (*data == 0) {
-                    // A zero encountered, so send the block
-                    send_block(link, start, data, num_non_zero);
-                    start = data + 1;
+                    // A zero encountered, so close the block
+                    *code = num_non_zero;
+                    code = out++;
                     num_non_zero = 1;
                 }
                 else {
+                    *out++ = *data;
                     num_non_zero++;
                 }
                 ++data;
             }
         }
-        send_block(link, start, data, num_non_zero);
-        send_data(link, &zero, 1);
     }
+    *code = num_non_zero;
+    *out++ = 0;
+    send_data(link, send_buffer, out - send_buffer);
 }
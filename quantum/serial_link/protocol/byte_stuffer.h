@@ -30,8 +30,17 @@ SOFTWARE.
 #define MAX_FRAME_SIZE 1024
 #define NUM_LINKS 2
 
+// A piece of a frame, the frame sent is the concatenation of all segments
+typedef struct {
+    const uint8_t* data;
+    uint16_t size;
+} frame_segment_t;
+
 void init_byte_stuffer(void);
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data);
+void byte_stuffer_recv_data(uint8_t link, const uint8_t* data, uint16_t size);
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size);
+// Encodes all segments into a single buffer, which is sent with one send_data call
+void byte_stuffer_send_segments(uint8_t link, const frame_segment_t* segments, uint8_t num_segments);
 
 #endif
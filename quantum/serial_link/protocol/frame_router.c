@@ -28,6 +28,15 @@ SOFTWARE.
 
 static bool is_master;
 
+// The destination byte is appended as a separate segment, so the caller's buffer is left untouched
+static void send_with_destination(uint8_t link, const uint8_t* data, uint16_t size, uint8_t destination) {
+    frame_segment_t segments[] = {
+        { .data = data, .size = size },
+        { .data = &destination, .size = 1 },
+    };
+    validator_send_segments(link, segments, 2);
+}
+
 void router_set_master(bool master) {
    is_master = master;
 }
@@ -56,14 +65,12 @@ void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
 void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
     if (destination == 0) {
         if (!is_master) {
-            data[size] = 1;
-            validator_send_frame(UP_LINK, data, size + 1);
+            send_with_destination(UP_LINK, data, size, 1);
         }
     }
     else {
         if (is_master) {
-            data[size] = destination;
-            validator_send_frame(DOWN_LINK, data, size + 1);
+            send_with_destination(DOWN_LINK, data, size, destination);
         }
     }
 }
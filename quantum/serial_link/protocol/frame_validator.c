@@ -95,10 +95,15 @@ const uint32_t poly8_lookup[256] =
  0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-static uint32_t crc32_byte(uint8_t *p, uint32_t bytelength)
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, uint32_t bytelength)
 {
-    uint32_t crc = 0xffffffff;
     while (bytelength-- !=0) crc = poly8_lookup[((uint8_t) crc ^ *(p++))] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t crc32_byte(uint8_t *p, uint32_t bytelength)
+{
+    uint32_t crc = crc32_update(0xffffffff, p, bytelength);
     // return (~crc); also works
     return (crc ^ 0xffffffff);
 }
@@ -115,7 +120,28 @@ void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size) {
 }
 
 void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    uint32_t crc = crc32_byte(data, size);
-    memcpy(data + size, &crc, 4);
-    byte_stuffer_send_frame(link, data, size + 4);
+    frame_segment_t segment = {
+        .data = data,
+        .size = size
+    };
+    validator_send_segments(link, &segment, 1);
+}
+
+#define MAX_SEGMENTS 4
+
+void validator_send_segments(uint8_t link, const frame_segment_t* segments, uint8_t num_segments) {
+    if (num_segments >= MAX_SEGMENTS) {
+        return;
+    }
+    frame_segment_t all_segments[MAX_SEGMENTS];
+    uint32_t crc = 0xffffffff;
+    uint8_t i;
+    for (i=0;i<num_segments;i++) {
+        crc = crc32_update(crc, segments[i].data, segments[i].size);
+        all_segments[i] = segments[i];
+    }
+    crc ^= 0xffffffff;
+    all_segments[num_segments].data = (const uint8_t*)&crc;
+    all_segments[num_segments].size = 4;
+    byte_stuffer_send_segments(link, all_segments, num_segments + 1);
 }
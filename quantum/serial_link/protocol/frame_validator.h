@@ -26,9 +26,11 @@ SOFTWARE.
 #define SERIAL_LINK_FRAME_VALIDATOR_H
 
 #include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
 
 void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size);
-// The buffer pointed to by the data needs 4 additional bytes
 void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size);
+// Sends the segments followed by their CRC, the data itself is not modified
+void validator_send_segments(uint8_t link, const frame_segment_t* segments, uint8_t num_segments);
 
 #endif
@@ -51,8 +51,10 @@ public:
 
     void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
         std::copy(data, data + size, std::back_inserter(sent_data));
+        num_writes++;
     }
     std::vector<uint8_t> sent_data;
+    int num_writes = 0;
 
     static ByteStuffer* Instance;
 };
@@ -481,3 +483,66 @@ TEST_F(ByteStuffer, sends_and_receives_full_roundtrip_254_bytes_and_then_zero) {
        byte_stuffer_recv_byte(1, d);
     }
 }
+
+TEST_F(ByteStuffer, sends_the_whole_frame_in_one_write) {
+    uint8_t data[] = {0, 0x55, 0, 0, 9, 8, 0};
+    byte_stuffer_send_frame(0, data, sizeof(data));
+    uint8_t expected[] = {1, 2, 0x55, 1, 3, 9, 8, 1, 0};
+    EXPECT_THAT(sent_data, ElementsAreArray(expected));
+    EXPECT_EQ(num_writes, 1);
+}
+
+TEST_F(ByteStuffer, sends_segments_as_one_frame) {
+    uint8_t first[] = {9, 0};
+    uint8_t second[] = {0x68};
+    uint8_t third[] = {0, 0x55, 0};
+    frame_segment_t segments[] = {
+        { .data = first, .size = sizeof(first) },
+        { .data = second, .size = sizeof(second) },
+        { .data = third, .size = sizeof(third) },
+    };
+    byte_stuffer_send_segments(0, segments, 3);
+    uint8_t expected[] = {2, 9, 2, 0x68, 2, 0x55, 1, 0};
+    EXPECT_THAT(sent_data, ElementsAreArray(expected));
+    EXPECT_EQ(num_writes, 1);
+}
+
+TEST_F(ByteStuffer, sends_long_block_split_between_segments) {
+    uint8_t first[200];
+    uint8_t second[100];
+    uint8_t all[300];
+    int i;
+    for(i=0;i<300;i++) {
+        all[i] = i % 255 + 1;
+    }
+    std::copy(all, all + 200, first);
+    std::copy(all + 200, all + 300, second);
+    frame_segment_t segments[] = {
+        { .data = first, .size = sizeof(first) },
+        { .data = second, .size = sizeof(second) },
+    };
+    byte_stuffer_send_segments(0, segments, 2);
+    std::vector<uint8_t> segmented = sent_data;
+    sent_data.clear();
+    byte_stuffer_send_frame(0, all, sizeof(all));
+    EXPECT_THAT(segmented, ElementsAreArray(sent_data));
+}
+
+TEST_F(ByteStuffer, does_not_send_frames_bigger_than_max_frame_size) {
+    static uint8_t data[MAX_FRAME_SIZE + 1];
+    byte_stuffer_send_frame(0, data, sizeof(data));
+    EXPECT_EQ(num_writes, 0);
+}
+
+TEST_F(ByteStuffer, sends_and_receives_max_frame_size_with_recv_data) {
+    static uint8_t original_data[MAX_FRAME_SIZE];
+    int i;
+    for(i=0;i<MAX_FRAME_SIZE;i++) {
+        original_data[i] = i % 7;
+    }
+    byte_stuffer_send_frame(0, original_data, sizeof(original_data));
+    EXPECT_EQ(num_writes, 1);
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(original_data)));
+    byte_stuffer_recv_data(1, sent_data.data(), sent_data.size());
+}
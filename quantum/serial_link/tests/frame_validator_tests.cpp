@@ -24,6 +24,7 @@ SOFTWARE.
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include <vector>
 extern "C" {
 #include "serial_link/protocol/frame_validator.h"
 }
@@ -55,8 +56,12 @@ void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size) {
     FrameValidator::Instance->route_incoming_frame(link, data, size);
 }
 
-void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    FrameValidator::Instance->byte_stuffer_send_frame(link, data, size);
+void byte_stuffer_send_segments(uint8_t link, const frame_segment_t* segments, uint8_t num_segments) {
+    std::vector<uint8_t> frame;
+    for (uint8_t i=0;i<num_segments;i++) {
+        frame.insert(frame.end(), segments[i].data, segments[i].data + segments[i].size);
+    }
+    FrameValidator::Instance->byte_stuffer_send_frame(link, frame.data(), frame.size());
 }
 }
 
@@ -113,3 +118,26 @@ TEST_F(FrameValidator, sends_five_bytes_with_correct_crc) {
         .With(Args<1, 2>(ElementsAreArray(expected)));
     validator_send_frame(0, original, 5);
 }
+
+TEST_F(FrameValidator, does_not_modify_the_sent_data) {
+    uint8_t original[] = {1, 2, 3, 4, 5, 0, 0, 0, 0};
+    uint8_t expected[] = {1, 2, 3, 4, 5, 0xF4, 0x99, 0x0B, 0x47};
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(expected)));
+    validator_send_frame(0, original, 5);
+    uint8_t unmodified[] = {1, 2, 3, 4, 5, 0, 0, 0, 0};
+    EXPECT_THAT(original, ElementsAreArray(unmodified));
+}
+
+TEST_F(FrameValidator, sends_segments_with_crc_of_the_whole_frame) {
+    uint8_t first[] = {1, 2};
+    uint8_t second[] = {3, 4, 5};
+    frame_segment_t segments[] = {
+        { .data = first, .size = sizeof(first) },
+        { .data = second, .size = sizeof(second) },
+    };
+    uint8_t expected[] = {1, 2, 3, 4, 5, 0xF4, 0x99, 0x0B, 0x47};
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(expected)));
+    validator_send_segments(0, segments, 2);
+}
@@ -0,0 +1,84 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <cstring>
+
+extern "C" {
+#include "keymap.h"
+extern uint16_t keycode_overrides[2][MATRIX_ROWS][MATRIX_COLS];
+}
+
+class ActionTable : public TestFixture {
+public:
+    ~ActionTable() {
+        memset(keycode_overrides, 0, sizeof(keycode_overrides));
+        keymap_config.raw = 0;
+        action_table_invalidate();
+    }
+
+    void tap(uint8_t col, uint8_t row, uint8_t keycode, TestDriver& driver) {
+        press_key(col, row);
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(keycode)));
+        keyboard_task();
+        release_key(col, row);
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+        keyboard_task();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+};
+
+TEST_F(ActionTable, ACachedLayerKeepsItsActionsUntilInvalidated) {
+    TestDriver driver;
+    tap(0, 0, KC_A, driver);
+
+    keycode_overrides[0][0][0] = KC_D;
+    tap(0, 0, KC_A, driver);
+
+    action_table_invalidate();
+    tap(0, 0, KC_D, driver);
+}
+
+TEST_F(ActionTable, SwappedKeysFollowTheKeymapConfig) {
+    TestDriver driver;
+    tap(5, 0, KC_LCTL, driver);
+
+    keymap_config.swap_control_capslock = true;
+    tap(5, 0, KC_CAPSLOCK, driver);
+
+    keymap_config.swap_control_capslock = false;
+    tap(5, 0, KC_LCTL, driver);
+}
+
+TEST_F(ActionTable, LayersAboveTheTableAreNotCached) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    press_key(9, 0);
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    tap(0, 0, KC_C, driver);
+
+    keycode_overrides[1][0][0] = KC_E;
+    tap(0, 0, KC_E, driver);
+
+    keymap_config.swap_control_capslock = true;
+    tap(5, 0, KC_CAPSLOCK, driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(testing::AnyNumber());
+    release_key(9, 0);
+    keyboard_task();
+}
@@ -15,7 +15,9 @@
  */
 
 #include "test_common.hpp"
+extern "C" {
 #include "action_tapping.h"
+}
 
 using testing::_;
 using testing::InSequence;
@@ -95,3 +97,121 @@ TEST_F(Tapping, ANewTapWithinTappingTermIsBuggy) {
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT))).Times(1);
     idle_for(TAPPING_TERM);
 }
+
+TEST_F(Tapping, TypingAKeyWithin_SHFT_T_KeyReportsNothingWithoutPermissiveHold) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    // Everything waits for the release of the tapping key
+    idle_for(TAPPING_TERM / 2);
+}
+
+TEST_F(Tapping, TypingManyKeysWithin_SHFT_T_KeySettlesItAsHoldWithoutLosingKeys) {
+    TestDriver driver;
+    InSequence s;
+    waiting_buffer_stats = {};
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    // The buffer fills up, and the tapping key is settled as hold
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    for (int i = 0; i < 12; i++) {
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    }
+    for (int i = 0; i < 12; i++) {
+        press_key(0, 0);
+        run_one_scan_loop();
+        release_key(0, 0);
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(waiting_buffer_stats.high_water, WAITING_BUFFER_SIZE - 1);
+    EXPECT_EQ(waiting_buffer_stats.forced, 1);
+
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Tapping, ATapKeyTypedWithin_SHFT_T_KeyIsSettledWhenTheBufferFills) {
+    TestDriver driver;
+    InSequence s;
+    waiting_buffer_stats = {};
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    press_key(9, 0);
+    run_one_scan_loop();
+    for (int i = 0; i < 3; i++) {
+        press_key(0, 0);
+        run_one_scan_loop();
+        release_key(0, 0);
+        run_one_scan_loop();
+    }
+    // Both tap keys are settled as hold, and nothing is left waiting for the second one
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_LCTL)));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_LCTL, KC_A)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_LCTL)));
+    }
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_LCTL, KC_A)));
+    press_key(0, 0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(waiting_buffer_stats.forced, 2);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_LCTL)));
+    run_one_scan_loop();
+    release_key(9, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Tapping, Releasing_SHFT_T_KeyWhenTheBufferIsFullKeepsTheKeys) {
+    TestDriver driver;
+    InSequence s;
+    waiting_buffer_stats = {};
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    for (int i = 0; i < 3; i++) {
+        press_key(0, 0);
+        run_one_scan_loop();
+        release_key(0, 0);
+        run_one_scan_loop();
+    }
+    press_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(waiting_buffer_stats.high_water, WAITING_BUFFER_SIZE - 1);
+
+    // The release has no room to wait. The interrupted tap falls back to its modifier
+    // and is settled as hold, and every key typed during it follows
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT))).Times(2);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    }
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    release_key(7, 0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(waiting_buffer_stats.forced, 1);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
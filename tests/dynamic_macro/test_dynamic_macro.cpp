@@ -0,0 +1,273 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+extern "C" {
+#include "eeprom.h"
+#include "timer.h"
+void dynamic_macro_reload(void);
+}
+#include <string>
+#include <vector>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+using testing::InvokeWithoutArgs;
+
+// The layout of the macros in the EEPROM, see dynamic_macro.h
+#define HEADER_ADDR 32
+#define BUFFER_ADDR (HEADER_ADDR + 8)
+#define KEY_A 0
+#define KEY_B 1
+#define REC_START1 2
+#define REC_STOP 4
+#define PLAY1 5
+
+class DynamicMacro : public TestFixture {
+protected:
+    struct Change {
+        uint32_t time;
+        std::string keys;
+    };
+
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+
+    // Records every report the macro sends while it plays, as the keys that are down
+    std::vector<Change> play(TestDriver& driver, uint8_t col, unsigned duration) {
+        std::vector<Change> changes;
+        auto log = [&](const char* keys) {
+            if (changes.empty() || changes.back().keys != keys) {
+                changes.push_back({timer_read32(), keys});
+            }
+        };
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).WillRepeatedly(InvokeWithoutArgs([&]() { log(""); }));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A))).WillRepeatedly(InvokeWithoutArgs([&]() { log("A"); }));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B))).WillRepeatedly(InvokeWithoutArgs([&]() { log("B"); }));
+        tap(col);
+        idle_for(duration);
+        testing::Mock::VerifyAndClearExpectations(&driver);
+        // The clearing of the keyboard before the macro starts
+        if (!changes.empty() && changes.front().keys == "") {
+            changes.erase(changes.begin());
+        }
+        return changes;
+    }
+
+    uint16_t saved_length(uint8_t slot) {
+        return eeprom_read_word((const uint16_t*)(HEADER_ADDR + 4 + 2 * slot));
+    }
+};
+
+static void expect_delay(uint32_t from, uint32_t to, uint32_t delay) {
+    EXPECT_LE(to - from, delay + 1);
+    EXPECT_GE(to - from, delay - delay / 8);
+}
+
+TEST_F(DynamicMacro, AMacroSavedInTheEepromIsLoaded) {
+    TestDriver driver;
+    const uint16_t header[] = {0xD300 | MATRIX_COLS, DYNAMIC_MACRO_SIZE, 2, 0};
+    // A pressed, then released 20ms later
+    const uint16_t events[] = {KEY_A << 8 | 0x80, KEY_A << 8 | 0x12};
+    eeprom_write_block(header, (void*)HEADER_ADDR, sizeof(header));
+    eeprom_write_block(events, (void*)BUFFER_ADDR, sizeof(events));
+    // The macros are loaded with the next key event
+    dynamic_macro_reload();
+
+    auto changes = play(driver, PLAY1, 50);
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes[0].keys, "A");
+    EXPECT_EQ(changes[1].keys, "");
+    expect_delay(changes[0].time, changes[1].time, 20);
+}
+
+TEST_F(DynamicMacro, AMacroIsPlayedBackWithItsTiming) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    press_key(KEY_A, 0);
+    idle_for(100);
+    release_key(KEY_A, 0);
+    idle_for(300);
+    press_key(KEY_B, 0);
+    idle_for(5);
+    release_key(KEY_B, 0);
+    idle_for(40);
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    auto changes = play(driver, PLAY1, 500);
+    ASSERT_EQ(changes.size(), 4);
+    EXPECT_EQ(changes[0].keys, "A");
+    EXPECT_EQ(changes[1].keys, "");
+    EXPECT_EQ(changes[2].keys, "B");
+    EXPECT_EQ(changes[3].keys, "");
+    // What a delay is rounded off by is added to the next one, so it's the time from
+    // the start that stays close to the recording
+    expect_delay(changes[0].time, changes[1].time, 100);
+    expect_delay(changes[0].time, changes[2].time, 400);
+    expect_delay(changes[0].time, changes[3].time, 405);
+    EXPECT_EQ(saved_length(0), 4);
+}
+
+TEST_F(DynamicMacro, ALongPauseIsKept) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    tap(KEY_A);
+    idle_for(2500);
+    tap(KEY_B);
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    auto changes = play(driver, PLAY1, 2600);
+    ASSERT_EQ(changes.size(), 4);
+    EXPECT_EQ(changes[0].keys, "A");
+    EXPECT_EQ(changes[2].keys, "B");
+    expect_delay(changes[0].time, changes[2].time, 2502);
+    // Two pause events hold the most part of it
+    EXPECT_EQ(saved_length(0), 6);
+}
+
+TEST_F(DynamicMacro, TheStopKeyEndsThePlayback) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    press_key(KEY_A, 0);
+    idle_for(500);
+    release_key(KEY_A, 0);
+    tap(KEY_B);
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    tap(PLAY1);
+    idle_for(100);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(REC_STOP);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(600);
+}
+
+TEST_F(DynamicMacro, KeysHeldAtTheEndAreNotSaved) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    tap(KEY_B);
+    press_key(KEY_A, 0);
+    run_one_scan_loop();
+    tap(REC_STOP);
+    release_key(KEY_A, 0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_EQ(saved_length(0), 2);
+    auto changes = play(driver, PLAY1, 50);
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes[0].keys, "B");
+}
+
+TEST_F(DynamicMacro, TheSecondMacroIsSavedAtTheEndOfTheBuffer) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1 + 1);
+    tap(KEY_B);
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_EQ(saved_length(1), 2);
+    const uint16_t* last = (const uint16_t*)(BUFFER_ADDR + 2 * (DYNAMIC_MACRO_SIZE - 1));
+    EXPECT_EQ(eeprom_read_word(last), KEY_B << 8 | 0x80);
+    auto changes = play(driver, PLAY1 + 1, 50);
+    ASSERT_EQ(changes.size(), 2);
+    EXPECT_EQ(changes[0].keys, "B");
+}
+
+TEST_F(DynamicMacro, AnEmptyEepromLoadsNoMacro) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    tap(KEY_A);
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    const uint16_t header[4] = {};
+    eeprom_write_block(header, (void*)HEADER_ADDR, sizeof(header));
+    dynamic_macro_reload();
+    auto changes = play(driver, PLAY1, 50);
+    EXPECT_EQ(changes.size(), 0);
+}
+
+TEST_F(DynamicMacro, StoppingThePlaybackLeavesTheKeysTheUserHolds) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    press_key(KEY_A, 0);
+    idle_for(500);
+    release_key(KEY_A, 0);
+    run_one_scan_loop();
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    tap(PLAY1);
+    idle_for(100);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B)));
+    press_key(KEY_B, 0);
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    tap(REC_STOP);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(600);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_key(KEY_B, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(DynamicMacro, TheEndOfThePlaybackLeavesTheKeysTheUserHolds) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    tap(REC_START1);
+    press_key(KEY_A, 0);
+    idle_for(200);
+    release_key(KEY_A, 0);
+    run_one_scan_loop();
+    tap(REC_STOP);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    tap(PLAY1);
+    idle_for(100);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B)));
+    press_key(KEY_B, 0);
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    idle_for(300);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    release_key(KEY_B, 0);
+    run_one_scan_loop();
+}
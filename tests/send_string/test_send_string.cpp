@@ -0,0 +1,150 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using testing::_;
+using testing::Invoke;
+
+#define EXPECT_REPORT(report, ...) do { \
+    report_keyboard_t actual = (report); \
+    testing::Matcher<report_keyboard_t&> matcher = KeyboardReport(__VA_ARGS__); \
+    EXPECT_TRUE(matcher.Matches(actual)) << actual; \
+} while (0)
+
+// Types what a host would see for the reports, pressed keys in report order, or in
+// usage order for hosts that go by that
+static std::string type(const std::vector<report_keyboard_t>& reports, bool usage_order) {
+    std::string text;
+    std::vector<uint8_t> previous;
+    for (auto& report : reports) {
+        std::vector<uint8_t> keys;
+        for (uint8_t key : report.keys) {
+            if (key) {
+                keys.push_back(key);
+            }
+        }
+        std::vector<uint8_t> pressed;
+        for (uint8_t key : keys) {
+            if (std::find(previous.begin(), previous.end(), key) == previous.end()) {
+                pressed.push_back(key);
+            }
+        }
+        if (usage_order) {
+            std::sort(pressed.begin(), pressed.end());
+        }
+        bool shifted = report.mods & MOD_BIT(KC_LSFT);
+        for (uint8_t key : pressed) {
+            for (int c = 0; c < 0x80; c++) {
+                if (ascii_to_keycode_lut[c] == key && ascii_to_shift_lut[c] == shifted) {
+                    text += (char)c;
+                    break;
+                }
+            }
+        }
+        previous = keys;
+    }
+    return text;
+}
+
+class SendString : public TestFixture {
+public:
+    std::vector<report_keyboard_t> reports;
+
+    void send(TestDriver& driver, const char* str) {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+            reports.push_back(report);
+        }));
+        send_string(str);
+    }
+
+    void expect_typed(const char* str) {
+        EXPECT_EQ(type(reports, false), str);
+        EXPECT_EQ(type(reports, true), str);
+        ASSERT_FALSE(reports.empty());
+        EXPECT_REPORT(reports.back());
+    }
+};
+
+TEST_F(SendString, KeysInOrderArePressedTogether) {
+    TestDriver driver;
+    send(driver, "abcdef");
+    expect_typed("abcdef");
+    // One report per key, and one to release them all
+    EXPECT_EQ(reports.size(), 7);
+}
+
+TEST_F(SendString, AKeyIsReleasedWhenTheNextOneComesBefore) {
+    TestDriver driver;
+    send(driver, "ba");
+    expect_typed("ba");
+    EXPECT_EQ(reports.size(), 3);
+    EXPECT_REPORT(reports[1], KC_A);
+}
+
+TEST_F(SendString, RepeatedKeysAreReleasedInBetween) {
+    TestDriver driver;
+    send(driver, "hello");
+    expect_typed("hello");
+    EXPECT_EQ(reports.size(), 7);
+}
+
+TEST_F(SendString, ShiftIsHeldForShiftedRuns) {
+    TestDriver driver;
+    send(driver, "ABC");
+    expect_typed("ABC");
+    EXPECT_EQ(reports.size(), 4);
+    EXPECT_REPORT(reports[2], KC_LSFT, KC_A, KC_B, KC_C);
+}
+
+TEST_F(SendString, MixedCaseSentence) {
+    TestDriver driver;
+    const char* text = "Hello, World! The quick brown fox jumps over the lazy dog.";
+    send(driver, text);
+    expect_typed(text);
+    // Used to be two or four reports for every character
+    EXPECT_LT(reports.size(), strlen(text) * 3 / 2);
+}
+
+TEST_F(SendString, NoMoreKeysThanFitInTheReport) {
+    TestDriver driver;
+    send(driver, "abcdefghijklmnop");
+    expect_typed("abcdefghijklmnop");
+    for (auto& report : reports) {
+        EXPECT_LE(std::count_if(report.keys, report.keys + KEYBOARD_REPORT_KEYS, [](uint8_t key) { return key != 0; }), SEND_STRING_MAX_KEYS);
+    }
+}
+
+TEST_F(SendString, KeyCodesAreTappedOnTheirOwn) {
+    TestDriver driver;
+    send(driver, "ab" SS_TAP(X_ENTER) "c");
+    expect_typed("ab\nc");
+    EXPECT_REPORT(reports[2]);
+    EXPECT_REPORT(reports[3], KC_ENTER);
+}
+
+TEST_F(SendString, AnIntervalTypesOneKeyAtATime) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+        reports.push_back(report);
+    }));
+    send_string_with_delay("aB", 1);
+    expect_typed("aB");
+    EXPECT_EQ(reports.size(), 6);
+}
@@ -0,0 +1,140 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+extern "C" {
+#include "process_steno.h"
+}
+
+typedef std::vector<uint8_t> packet_t;
+
+static std::vector<packet_t> packets;
+
+extern "C" void virtser_send_buffer(const uint8_t* data, uint8_t length) {
+    packets.push_back(packet_t(data, data + length));
+}
+
+class Steno : public TestFixture {
+public:
+    Steno() {
+        packets.clear();
+    }
+
+    void chord(std::vector<std::pair<uint8_t, uint8_t>> keys) {
+        for (auto& key : keys) {
+            press_key(key.first, key.second);
+            run_one_scan_loop();
+        }
+        for (auto& key : keys) {
+            release_key(key.first, key.second);
+            run_one_scan_loop();
+        }
+    }
+};
+
+TEST_F(Steno, GeminiChordIsOnePacket) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_GEMINI);
+    // S- T- A O -E -U -Z
+    chord({{0, 0}, {1, 0}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {8, 0}});
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x80, 0x40 | 0x10, 0x20 | 0x10, 0x08 | 0x04, 0x00, 0x01};
+    EXPECT_EQ(packets[0], expected);
+}
+
+TEST_F(Steno, GeminiSendsEmptyBytes) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_GEMINI);
+    // #
+    chord({{9, 0}});
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x80 | 0x20, 0, 0, 0, 0, 0};
+    EXPECT_EQ(packets[0], expected);
+}
+
+TEST_F(Steno, BoltChordIsOnePacket) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_BOLT);
+    // S- T- K- A O * -E -U -F -Z
+    chord({{0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {0, 1}, {5, 0}, {6, 0}, {7, 0}, {8, 0}});
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x07, 0x40 | 0x02 | 0x04 | 0x08 | 0x10 | 0x20, 0x80 | 0x01, 0xc0 | 0x08, 0};
+    EXPECT_EQ(packets[0], expected);
+}
+
+TEST_F(Steno, BoltLeavesOutEmptyGroups) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_BOLT);
+    // A -Z
+    chord({{3, 0}, {8, 0}});
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x42, 0xc8, 0};
+    EXPECT_EQ(packets[0], expected);
+}
+
+TEST_F(Steno, ChordIsSentWhenTheLastKeyIsReleased) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_GEMINI);
+    press_key(0, 0);
+    run_one_scan_loop();
+    press_key(1, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_TRUE(packets.empty());
+    release_key(1, 0);
+    run_one_scan_loop();
+    ASSERT_EQ(packets.size(), 1);
+    EXPECT_EQ(packets[0][1], 0x40 | 0x10);
+}
+
+TEST_F(Steno, StrokeOfKeysChangingInOneScanIsSentInThatScan) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_GEMINI);
+    // S- T- K- A O * -E -U -F -Z, all in the same scan
+    std::vector<std::pair<uint8_t, uint8_t>> keys = {
+        {0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {0, 1}, {5, 0}, {6, 0}, {7, 0}, {8, 0}
+    };
+    for (auto& key : keys) {
+        press_key(key.first, key.second);
+    }
+    run_one_scan_loop();
+    EXPECT_TRUE(packets.empty());
+    for (auto& key : keys) {
+        release_key(key.first, key.second);
+    }
+    run_one_scan_loop();
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x80, 0x40 | 0x10 | 0x08, 0x20 | 0x10 | 0x08, 0x08 | 0x04 | 0x02, 0x00, 0x01};
+    EXPECT_EQ(packets[0], expected);
+}
+
+TEST_F(Steno, StrokesInConsecutiveScans) {
+    TestDriver driver;
+    steno_set_mode(STENO_MODE_BOLT);
+    for (int i = 0; i < 10; i++) {
+        press_key(3, 0);
+        press_key(8, 0);
+        run_one_scan_loop();
+        release_key(3, 0);
+        release_key(8, 0);
+        run_one_scan_loop();
+    }
+    ASSERT_EQ(packets.size(), 10);
+    packet_t expected = {0x42, 0xc8, 0};
+    EXPECT_EQ(packets[9], expected);
+}
@@ -0,0 +1,56 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+extern "C" {
+#include "eeconfig.h"
+#include "process_steno.h"
+}
+
+typedef std::vector<uint8_t> packet_t;
+
+static std::vector<packet_t> packets;
+
+extern "C" void virtser_send_buffer(const uint8_t* data, uint8_t length) {
+    packets.push_back(packet_t(data, data + length));
+}
+
+// Its own binary, so that nothing has scanned the matrix and steno_init() hasn't run yet
+class StenoBoot : public TestFixture {};
+
+TEST_F(StenoBoot, AChordStartedBeforeStenoIsUpIsSentInTheSavedMode) {
+    TestDriver driver;
+    if (!eeconfig_is_enabled()) {
+        eeconfig_init();
+    }
+    eeconfig_update_steno_mode(STENO_MODE_GEMINI);
+    EXPECT_TRUE(keyboard_init_pending());
+    EXPECT_EQ(keyboard_boot_stats.first_scan, 0);
+
+    // #, pressed in the first scan
+    press_key(9, 0);
+    run_one_scan_loop();
+    EXPECT_FALSE(keyboard_init_pending());
+    EXPECT_NE(keyboard_boot_stats.first_scan, 0);
+    EXPECT_GE(keyboard_boot_stats.done, keyboard_boot_stats.ready);
+    release_key(9, 0);
+    run_one_scan_loop();
+
+    ASSERT_EQ(packets.size(), 1);
+    packet_t expected = {0x80 | 0x20, 0, 0, 0, 0, 0};
+    EXPECT_EQ(packets[0], expected);
+}
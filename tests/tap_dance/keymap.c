@@ -0,0 +1,44 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+// Lots of dances, which only cost anything while they are in flight
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0    1      2      3      4      5      6      7      8      9
+        {TD(0), TD(1), KC_C,  TD(TAP_DANCE_COUNT - 1), KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+#define DOUBLE ACTION_TAP_DANCE_DOUBLE(KC_X, KC_Y)
+
+static void short_dance_finished(qk_tap_dance_state_t *state, void *user_data) {
+    register_code(KC_D);
+}
+
+static void short_dance_reset(qk_tap_dance_state_t *state, void *user_data) {
+    unregister_code(KC_D);
+}
+
+qk_tap_dance_action_t tap_dance_actions[TAP_DANCE_COUNT] = {
+    [0] = ACTION_TAP_DANCE_DOUBLE(KC_A, KC_B),
+    [1] = ACTION_TAP_DANCE_FN_ADVANCED_TIME(NULL, short_dance_finished, short_dance_reset, 50),
+    [2 ... TAP_DANCE_COUNT - 1] = DOUBLE,
+};
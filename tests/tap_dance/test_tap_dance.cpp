@@ -0,0 +1,180 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+extern "C" {
+#include "action_tapping.h"
+#include "deadline.h"
+}
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+class TapDance : public TestFixture {};
+
+TEST_F(TapDance, ATapSendsTheFirstKeyAfterTheTappingTerm) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM - 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    idle_for(3);
+}
+
+TEST_F(TapDance, ADoubleTapSendsTheSecondKeyRightAway) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM);
+}
+
+TEST_F(TapDance, AnotherKeyEndsTheDance) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    press_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C)));
+    run_one_scan_loop();
+    release_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM);
+}
+
+TEST_F(TapDance, ADanceWithItsOwnTappingTermEndsSooner) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(1, 0);
+    run_one_scan_loop();
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(49);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    idle_for(3);
+}
+
+TEST_F(TapDance, HoldingADanceKeepsItUntilReleased) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    idle_for(TAPPING_TERM + 2);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM);
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    run_one_scan_loop();
+}
+
+static uint32_t never_due(uint32_t deadline, void *arg) {
+    return 0;
+}
+
+TEST_F(TapDance, ADanceStillEndsWhenNoDeadlineIsFree) {
+    TestDriver driver;
+    InSequence s;
+
+    std::vector<deadline_token_t> taken;
+    for (deadline_token_t token; (token = deadline_schedule(UINT32_MAX / 2, never_due, NULL)) != DEADLINE_INVALID;) {
+        taken.push_back(token);
+    }
+
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM - 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    idle_for(3);
+
+    for (deadline_token_t token : taken) {
+        deadline_cancel(token);
+    }
+}
+
+// The scan used to check the timer of every dance up to the highest one used
+static void scan_all_tap_dances(void) {
+    for (int i = 0; i < TAP_DANCE_COUNT; i++) {
+        qk_tap_dance_action_t *action = &tap_dance_actions[i];
+        uint16_t term = action->custom_tapping_term > 0 ? action->custom_tapping_term : TAPPING_TERM;
+        if (action->state.count && timer_elapsed(action->state.timer) > term) {
+            reset_tap_dance(&action->state);
+        }
+    }
+}
+
+template<typename F>
+static double nanoseconds_per_call(F f) {
+    const int calls = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++) {
+        f();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / calls;
+}
+
+TEST_F(TapDance, BenchmarkIdleScan) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+
+    // Use the last dance, so that every dance would be checked
+    press_key(3, 0);
+    run_one_scan_loop();
+    release_key(3, 0);
+    idle_for(TAPPING_TERM + 2);
+
+    double idle = nanoseconds_per_call(matrix_scan_tap_dance);
+    double all = nanoseconds_per_call(scan_all_tap_dances);
+    printf("[ BENCHMARK] idle tap dance scan: %.1f ns, checking all %d dances: %.1f ns\n", idle, TAP_DANCE_COUNT, all);
+    EXPECT_LT(idle, all);
+}
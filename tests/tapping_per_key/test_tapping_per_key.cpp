@@ -0,0 +1,275 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+extern "C" {
+#include "action_tapping.h"
+}
+
+using testing::_;
+using testing::InSequence;
+
+static uint16_t tapping_term = TAPPING_TERM;
+static bool adaptive_tapping = false;
+static bool permissive_hold = false;
+static bool hold_on_other_key_press = false;
+static bool retro_tapping = false;
+
+extern "C" {
+uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record) {
+    if (adaptive_tapping) {
+        return adaptive_tapping_term();
+    }
+    return keycode == SFT_T(KC_P) ? tapping_term : TAPPING_TERM;
+}
+
+bool get_permissive_hold(uint16_t keycode, keyrecord_t *record) {
+    return permissive_hold;
+}
+
+bool get_hold_on_other_key_press(uint16_t keycode, keyrecord_t *record) {
+    return hold_on_other_key_press;
+}
+
+bool get_retro_tapping(uint16_t keycode, keyrecord_t *record) {
+    return retro_tapping;
+}
+}
+
+class TappingPerKey : public TestFixture {
+public:
+    TappingPerKey() {
+        reset_options();
+    }
+
+    ~TappingPerKey() {
+        // A tap keeps the term it was started with, so let it run out first
+        TestDriver driver;
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(testing::AnyNumber());
+        clear_all_keys();
+        idle_for(tapping_term + 10);
+        testing::Mock::VerifyAndClearExpectations(&driver);
+        reset_options();
+    }
+
+    void reset_options() {
+        tapping_term = TAPPING_TERM;
+        adaptive_tapping = false;
+        permissive_hold = false;
+        hold_on_other_key_press = false;
+        retro_tapping = false;
+        adaptive_tapping_term_reset();
+    }
+};
+
+TEST_F(TappingPerKey, HoldA_SHFT_T_KeyWithShorterTappingTermReportsShiftEarlier) {
+    TestDriver driver;
+    InSequence s;
+    tapping_term = 100;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(tapping_term - 1);
+    // The event times are rounded to odd numbers
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(2);
+}
+
+TEST_F(TappingPerKey, TapA_SHFT_T_KeyWithLongerTappingTermReportsKey) {
+    TestDriver driver;
+    InSequence s;
+    tapping_term = 400;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(300);
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, TypingAKeyWithin_SHFT_T_KeyReportsShiftedKeyWithPermissiveHold) {
+    TestDriver driver;
+    InSequence s;
+    permissive_hold = true;
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, PressingAKeyWithin_SHFT_T_KeyReportsShiftImmediatelyWithHoldOnOtherKeyPress) {
+    TestDriver driver;
+    InSequence s;
+    hold_on_other_key_press = true;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, TapA_SHFT_T_KeyStillReportsKeyWithHoldOnOtherKeyPress) {
+    TestDriver driver;
+    InSequence s;
+    hold_on_other_key_press = true;
+
+    press_key(7, 0);
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, HoldA_SHFT_T_KeyWithoutInterruptionReportsKeyWithRetroTapping) {
+    TestDriver driver;
+    InSequence s;
+    retro_tapping = true;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(TAPPING_TERM + 1);
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, HoldA_SHFT_T_KeyWithInterruptionReportsNoKeyWithRetroTapping) {
+    TestDriver driver;
+    InSequence s;
+    retro_tapping = true;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(TAPPING_TERM + 1);
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingPerKey, AdaptiveTappingTermShrinksWithFastTyping) {
+    TestDriver driver;
+    adaptive_tapping = true;
+    EXPECT_EQ(adaptive_tapping_term(), TAPPING_TERM);
+
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(testing::AnyNumber());
+    for (int i = 0; i < 16; i++) {
+        press_key(0, 0);
+        idle_for(40);
+        release_key(0, 0);
+        idle_for(40);
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(adaptive_tapping_term(), ADAPTIVE_TAPPING_TERM_MIN);
+
+    InSequence s;
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(ADAPTIVE_TAPPING_TERM_MIN - 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(2);
+}
+
+TEST_F(TappingPerKey, AdaptiveTappingTermGrowsBackWithSlowTyping) {
+    TestDriver driver;
+    adaptive_tapping = true;
+
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(testing::AnyNumber());
+    for (int i = 0; i < 16; i++) {
+        press_key(0, 0);
+        idle_for(40);
+        release_key(0, 0);
+        idle_for(40);
+    }
+    EXPECT_LT(adaptive_tapping_term(), TAPPING_TERM);
+    for (int i = 0; i < 16; i++) {
+        press_key(0, 0);
+        idle_for(TAPPING_TERM);
+        release_key(0, 0);
+        idle_for(40);
+    }
+    EXPECT_EQ(adaptive_tapping_term(), TAPPING_TERM);
+}
+
+TEST_F(TappingPerKey, AdaptiveTappingTermIsTakenWhenTheTapStarts) {
+    TestDriver driver;
+    adaptive_tapping = true;
+
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(testing::AnyNumber());
+    for (int i = 0; i < 16; i++) {
+        press_key(0, 0);
+        idle_for(60);
+        release_key(0, 0);
+        idle_for(60);
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    uint16_t term = adaptive_tapping_term();
+    EXPECT_GT(term, ADAPTIVE_TAPPING_TERM_MIN + 10);
+
+    InSequence s;
+    press_key(8, 0);
+    run_one_scan_loop();
+    // Quick taps of another key while it is pending shorten the term for the next tap
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    for (int i = 0; i < 2; i++) {
+        press_key(1, 0);
+        run_one_scan_loop();
+        release_key(1, 0);
+        run_one_scan_loop();
+    }
+    EXPECT_LT(adaptive_tapping_term(), term - 10);
+    idle_for(term - 10 - 4);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    // but this one is still a tap, the other key isn't typed on layer 1
+    release_key(8, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P, KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P, KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_P)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
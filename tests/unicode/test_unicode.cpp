@@ -0,0 +1,175 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+extern "C" {
+#include "process_unicode_common.h"
+#include "process_ucis.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+#include <vector>
+#include <algorithm>
+
+using testing::_;
+using testing::Invoke;
+
+struct key_press_t {
+    uint8_t mods;
+    uint8_t key;
+    bool operator==(const key_press_t& other) const { return mods == other.mods && key == other.key; }
+};
+
+std::ostream& operator<<(std::ostream& stream, const key_press_t& value) {
+    return stream << "(" << (int)value.mods << ", " << (int)value.key << ")";
+}
+
+class Unicode : public TestFixture {
+public:
+    std::vector<report_keyboard_t> reports;
+
+    // Reports go out once per millisecond, like a host polling every frame
+    void record(TestDriver& driver) {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+            reports.push_back(report);
+            advance_time(1);
+        }));
+    }
+
+    // The keys as the host sees them pressed, with the mods held at the time
+    std::vector<key_press_t> presses() {
+        std::vector<key_press_t> result;
+        std::vector<uint8_t> previous;
+        for (auto& report : reports) {
+            std::vector<uint8_t> keys;
+            for (uint8_t key : report.keys) {
+                if (key) {
+                    keys.push_back(key);
+                    if (std::find(previous.begin(), previous.end(), key) == previous.end()) {
+                        result.push_back({report.mods, key});
+                    }
+                }
+            }
+            previous = keys;
+        }
+        return result;
+    }
+
+    void type(uint16_t code) {
+        unicode_input_start();
+        register_hex(code);
+        unicode_input_finish();
+    }
+};
+
+#define CTRL_SHIFT (MOD_BIT(KC_LCTL) | MOD_BIT(KC_LSFT))
+#define LALT MOD_BIT(KC_LALT)
+
+TEST_F(Unicode, LinuxSequence) {
+    TestDriver driver;
+    record(driver);
+    set_unicode_input_mode(UC_LNX);
+    type(0x2328);
+    std::vector<key_press_t> expected = {
+        {CTRL_SHIFT, KC_U}, {0, KC_2}, {0, KC_3}, {0, KC_2}, {0, KC_8}, {0, KC_SPC}
+    };
+    EXPECT_EQ(presses(), expected);
+    EXPECT_EQ(reports.back().mods, 0);
+    // Used to be 16 reports
+    EXPECT_EQ(reports.size(), 10);
+}
+
+TEST_F(Unicode, MacSequenceHoldsAlt) {
+    TestDriver driver;
+    record(driver);
+    set_unicode_input_mode(UC_OSX);
+    type(0x00E9);
+    std::vector<key_press_t> expected = {
+        {LALT, KC_0}, {LALT, KC_0}, {LALT, KC_E}, {LALT, KC_9}
+    };
+    EXPECT_EQ(presses(), expected);
+    EXPECT_EQ(reports.front().mods, LALT);
+    EXPECT_EQ(reports.back().mods, 0);
+}
+
+TEST_F(Unicode, WindowsSequence) {
+    TestDriver driver;
+    record(driver);
+    set_unicode_input_mode(UC_WIN);
+    type(0x00E9);
+    std::vector<key_press_t> expected = {
+        {LALT, KC_PPLS}, {LALT, KC_0}, {LALT, KC_0}, {LALT, KC_E}, {LALT, KC_9}
+    };
+    EXPECT_EQ(presses(), expected);
+    EXPECT_EQ(reports.back().mods, 0);
+}
+
+TEST_F(Unicode, HeldModsAreRestored) {
+    TestDriver driver;
+    record(driver);
+    set_unicode_input_mode(UC_LNX);
+    add_mods(MOD_BIT(KC_RSFT));
+    type(0x2328);
+    EXPECT_EQ(presses().front().mods, CTRL_SHIFT);
+    EXPECT_EQ(reports.back().mods, MOD_BIT(KC_RSFT));
+    EXPECT_EQ(get_mods(), MOD_BIT(KC_RSFT));
+    clear_mods();
+}
+
+TEST_F(Unicode, UcisFindsSymbolsWithDigits) {
+    TestDriver driver;
+    record(driver);
+    set_unicode_input_mode(UC_LNX);
+    qk_ucis_start();
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    press_key(1, 0);
+    run_one_scan_loop();
+    release_key(1, 0);
+    run_one_scan_loop();
+    reports.clear();
+    press_key(3, 0);
+    run_one_scan_loop();
+    release_key(3, 0);
+    run_one_scan_loop();
+    std::vector<key_press_t> expected = {
+        {0, KC_BSPC}, {0, KC_BSPC}, {0, KC_BSPC},
+        {CTRL_SHIFT, KC_U}, {0, KC_0}, {0, KC_0}, {0, KC_D}, {0, KC_7}, {0, KC_SPC}
+    };
+    EXPECT_EQ(presses(), expected);
+}
+
+TEST_F(Unicode, BenchmarkOutputRate) {
+    TestDriver driver;
+    record(driver);
+    const char* names[] = {"Mac", "Linux", "Windows"};
+    const uint8_t modes[] = {UC_OSX, UC_LNX, UC_WIN};
+    for (int m = 0; m < 3; m++) {
+        set_unicode_input_mode(modes[m]);
+        reports.clear();
+        set_time(0);
+        const int count = 100;
+        for (int i = 0; i < count; i++) {
+            type(0x2600 + i);
+        }
+        double seconds = timer_read32() / 1000.0;
+        printf("[ BENCHMARK] %s: %.1f reports per character, %.0f characters/s at one report per ms\n",
+            names[m], (double)reports.size() / count, count / seconds);
+        EXPECT_GT(count / seconds, 50);
+    }
+}
@@ -19,6 +19,8 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/util.c \
 	$(COMMON_DIR)/eeconfig.c \
 	$(COMMON_DIR)/report.c \
+	$(COMMON_DIR)/deadline.c \
+	$(COMMON_DIR)/mouse_merge.c \
 	$(PLATFORM_COMMON_DIR)/suspend.c \
 	$(PLATFORM_COMMON_DIR)/timer.c \
 	$(PLATFORM_COMMON_DIR)/bootloader.c \
@@ -90,6 +92,11 @@ ifeq ($(strip $(SLEEP_LED_ENABLE)), yes)
     TMK_COMMON_DEFS += -DNO_SUSPEND_POWER_DOWN
 endif
 
+ifeq ($(strip $(IDLE_SLEEP_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/idle.c
+    TMK_COMMON_DEFS += -DIDLE_SLEEP_ENABLE
+endif
+
 ifeq ($(strip $(NO_UART)), yes)
     TMK_COMMON_DEFS += -DNO_UART
 endif
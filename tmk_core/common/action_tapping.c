@@ -4,6 +4,7 @@
 #include "action_layer.h"
 #include "action_tapping.h"
 #include "keycode.h"
+#include "keymap.h"
 #include "timer.h"
 
 #ifdef DEBUG_ACTION
@@ -18,23 +19,63 @@
 #define IS_TAPPING_PRESSED()    (IS_TAPPING() && tapping_key.event.pressed)
 #define IS_TAPPING_RELEASED()   (IS_TAPPING() && !tapping_key.event.pressed)
 #define IS_TAPPING_KEY(k)       (IS_TAPPING() && KEYEQ(tapping_key.event.key, (k)))
-#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < TAPPING_TERM)
+#if defined(TAPPING_TERM_PER_KEY)
+#define TAPPING_KEY_TERM()      get_tapping_term(get_record_keycode(&tapping_key), &tapping_key)
+#elif defined(ADAPTIVE_TAPPING_TERM)
+#define TAPPING_KEY_TERM()      adaptive_tapping_term()
+#endif
+#ifdef TAPPING_KEY_TERM
+/* taken when the tapping key is pressed, so that the term of a pending tap stays put */
+#define LATCH_TAPPING_TERM()    (tapping_key_term = TAPPING_KEY_TERM())
+#define GET_TAPPING_TERM()      tapping_key_term
+#else
+#define LATCH_TAPPING_TERM()
+#define GET_TAPPING_TERM()      TAPPING_TERM
+#endif
+#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < GET_TAPPING_TERM())
+
+#if defined(PERMISSIVE_HOLD_PER_KEY)
+#define IS_PERMISSIVE_HOLD()    get_permissive_hold(get_record_keycode(&tapping_key), &tapping_key)
+#elif TAPPING_TERM >= 500 || defined PERMISSIVE_HOLD
+#define IS_PERMISSIVE_HOLD()    true
+#else
+#define IS_PERMISSIVE_HOLD()    false
+#endif
+
+#if defined(HOLD_ON_OTHER_KEY_PRESS_PER_KEY)
+#define IS_HOLD_ON_OTHER_KEY_PRESS()    get_hold_on_other_key_press(get_record_keycode(&tapping_key), &tapping_key)
+#elif defined(HOLD_ON_OTHER_KEY_PRESS)
+#define IS_HOLD_ON_OTHER_KEY_PRESS()    true
+#else
+#define IS_HOLD_ON_OTHER_KEY_PRESS()    false
+#endif
 
 
 static keyrecord_t tapping_key = {};
+#ifdef TAPPING_KEY_TERM
+static uint16_t tapping_key_term = TAPPING_TERM;
+#endif
 static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
 static uint8_t waiting_buffer_head = 0;
 static uint8_t waiting_buffer_tail = 0;
 
+waiting_buffer_stats_t waiting_buffer_stats = {};
+
 static bool process_tapping(keyrecord_t *record);
 static bool waiting_buffer_enq(keyrecord_t record);
 static void waiting_buffer_clear(void);
+static bool waiting_buffer_settle_tapping_key(void);
+static void waiting_buffer_settle(void);
 static bool waiting_buffer_typed(keyevent_t event);
 static bool waiting_buffer_has_anykey_pressed(void);
 static void waiting_buffer_scan_tap(void);
 static void debug_tapping_key(void);
 static void debug_waiting_buffer(void);
 
+#ifdef ADAPTIVE_TAPPING_TERM
+static void adaptive_tapping_term_track(keyevent_t event);
+#endif
+
 
 /** \brief Action Tapping Process
  *
@@ -42,11 +83,16 @@ static void debug_waiting_buffer(void);
  */
 void action_tapping_process(keyrecord_t record)
 {
+#ifdef ADAPTIVE_TAPPING_TERM
+    adaptive_tapping_term_track(record.event);
+#endif
     if (process_tapping(&record)) {
         if (!IS_NOEVENT(record.event)) {
             debug("processed: "); debug_record(record); debug("\n");
         }
-    } else {
+    } else if (!waiting_buffer_enq(record)) {
+        // make room by settling the tapping key, rather than dropping the event
+        waiting_buffer_settle();
         if (!waiting_buffer_enq(record)) {
             // clear all in case of overflow.
             debug("OVERFLOW: CLEAR ALL STATES\n");
@@ -100,12 +146,11 @@ bool process_tapping(keyrecord_t *keyp)
                     // enqueue
                     return false;
                 }
-#if TAPPING_TERM >= 500 || defined PERMISSIVE_HOLD
                 /* Process a key typed within TAPPING_TERM
                  * This can register the key before settlement of tapping,
                  * useful for long TAPPING_TERM but may prevent fast typing.
                  */
-                else if (IS_RELEASED(event) && waiting_buffer_typed(event)) {
+                else if (IS_PERMISSIVE_HOLD() && IS_RELEASED(event) && waiting_buffer_typed(event)) {
                     debug("Tapping: End. No tap. Interfered by typing key\n");
                     process_record(&tapping_key);
                     tapping_key = (keyrecord_t){};
@@ -113,7 +158,17 @@ bool process_tapping(keyrecord_t *keyp)
                     // enqueue
                     return false;
                 }
-#endif
+                /* Settle as hold as soon as another key is pressed within TAPPING_TERM,
+                 * instead of waiting for its release or the end of TAPPING_TERM.
+                 */
+                else if (IS_HOLD_ON_OTHER_KEY_PRESS() && IS_PRESSED(event)) {
+                    debug("Tapping: End. No tap. Interfered by pressed key\n");
+                    process_record(&tapping_key);
+                    tapping_key = (keyrecord_t){};
+                    debug_tapping_key();
+                    // enqueue
+                    return false;
+                }
                 /* Process release event of a key pressed before tapping starts
                  * Without this unexpected repeating will occur with having fast repeating setting
                  * https://github.com/tmk/tmk_keyboard/issues/60
@@ -171,6 +226,7 @@ bool process_tapping(keyrecord_t *keyp)
                         debug("Tapping: Start while last tap(1).\n");
                     }
                     tapping_key = *keyp;
+                    LATCH_TAPPING_TERM();
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -215,6 +271,7 @@ bool process_tapping(keyrecord_t *keyp)
                         debug("Tapping: Start while last timeout tap(1).\n");
                     }
                     tapping_key = *keyp;
+                    LATCH_TAPPING_TERM();
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -240,17 +297,20 @@ bool process_tapping(keyrecord_t *keyp)
                         debug("Tapping: Tap press("); debug_dec(keyp->tap.count); debug(")\n");
                         process_record(keyp);
                         tapping_key = *keyp;
+                        LATCH_TAPPING_TERM();
                         debug_tapping_key();
                         return true;
                     }
 #endif
                     // FIX: start new tap again
                     tapping_key = *keyp;
+                    LATCH_TAPPING_TERM();
                     return true;
                 } else if (is_tap_key(event.key)) {
                     // Sequential tap can be interfered with other tap key.
                     debug("Tapping: Start with interfering other tap.\n");
                     tapping_key = *keyp;
+                    LATCH_TAPPING_TERM();
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -281,6 +341,7 @@ bool process_tapping(keyrecord_t *keyp)
         if (event.pressed && is_tap_key(event.key)) {
             debug("Tapping: Start(Press tap key).\n");
             tapping_key = *keyp;
+            LATCH_TAPPING_TERM();
             process_record_tap_hint(&tapping_key);
             waiting_buffer_scan_tap();
             debug_tapping_key();
@@ -293,6 +354,124 @@ bool process_tapping(keyrecord_t *keyp)
 }
 
 
+/** \brief Get the keycode of a record
+ *
+ * Looks the key up in the keymap, for the per key tapping settings.
+ */
+uint16_t get_record_keycode(keyrecord_t *record)
+{
+    return keymap_key_to_keycode(layer_switch_get_layer(record->event.key), record->event.key);
+}
+
+/** \brief Tapping term of a key
+ *
+ * Used with TAPPING_TERM_PER_KEY.
+ */
+__attribute__ ((weak))
+uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record)
+{
+#ifdef ADAPTIVE_TAPPING_TERM
+    return adaptive_tapping_term();
+#else
+    return TAPPING_TERM;
+#endif
+}
+
+/** \brief Permissive hold of a key
+ *
+ * Used with PERMISSIVE_HOLD_PER_KEY.
+ */
+__attribute__ ((weak))
+bool get_permissive_hold(uint16_t keycode, keyrecord_t *record)
+{
+#if TAPPING_TERM >= 500 || defined PERMISSIVE_HOLD
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** \brief Hold on other key press of a key
+ *
+ * Used with HOLD_ON_OTHER_KEY_PRESS_PER_KEY.
+ */
+__attribute__ ((weak))
+bool get_hold_on_other_key_press(uint16_t keycode, keyrecord_t *record)
+{
+#ifdef HOLD_ON_OTHER_KEY_PRESS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** \brief Retro tapping of a key
+ *
+ * Used with RETRO_TAPPING_PER_KEY.
+ */
+__attribute__ ((weak))
+bool get_retro_tapping(uint16_t keycode, keyrecord_t *record)
+{
+#ifdef RETRO_TAPPING
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef ADAPTIVE_TAPPING_TERM
+/* Average time a key is held down while typing, times 4 */
+static uint16_t dwell_average_x4 = 4 * (TAPPING_TERM / ADAPTIVE_TAPPING_TERM_FACTOR);
+static keypos_t dwell_key;
+static uint16_t dwell_start;
+static bool dwell_pending = false;
+
+/** \brief Adaptive tapping term reset
+ *
+ * Forgets the typing speed, so that the term starts at TAPPING_TERM.
+ */
+void adaptive_tapping_term_reset(void)
+{
+    dwell_average_x4 = 4 * (TAPPING_TERM / ADAPTIVE_TAPPING_TERM_FACTOR);
+    dwell_pending = false;
+}
+
+/** \brief Adaptive tapping term
+ *
+ * A multiple of the average time keys are held down, between
+ * ADAPTIVE_TAPPING_TERM_MIN and TAPPING_TERM.
+ */
+uint16_t adaptive_tapping_term(void)
+{
+    uint16_t term = (dwell_average_x4 / 4) * ADAPTIVE_TAPPING_TERM_FACTOR;
+    if (term < ADAPTIVE_TAPPING_TERM_MIN) term = ADAPTIVE_TAPPING_TERM_MIN;
+    if (term > TAPPING_TERM) term = TAPPING_TERM;
+    return term;
+}
+
+/** \brief Adaptive tapping term tracking
+ *
+ * Measures how long the last pressed key is held down, and adds it to the
+ * moving average. Holds longer than TAPPING_TERM only count as TAPPING_TERM.
+ */
+static void adaptive_tapping_term_track(keyevent_t event)
+{
+    if (IS_NOEVENT(event)) return;
+
+    if (event.pressed) {
+        dwell_key = event.key;
+        dwell_start = event.time;
+        dwell_pending = true;
+    } else if (dwell_pending && KEYEQ(event.key, dwell_key)) {
+        uint16_t dwell = TIMER_DIFF_16(event.time, dwell_start);
+        if (dwell > TAPPING_TERM) dwell = TAPPING_TERM;
+        dwell_average_x4 = dwell_average_x4 - dwell_average_x4 / 4 + dwell;
+        dwell_pending = false;
+    }
+}
+#endif
+
+
 /** \brief Waiting buffer enq
  *
  * FIXME: Needs docs
@@ -304,13 +483,18 @@ bool waiting_buffer_enq(keyrecord_t record)
     }
 
     if ((waiting_buffer_head + 1) % WAITING_BUFFER_SIZE == waiting_buffer_tail) {
-        debug("waiting_buffer_enq: Over flow.\n");
+        debug("waiting_buffer_enq: Full.\n");
         return false;
     }
 
     waiting_buffer[waiting_buffer_head] = record;
     waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
 
+    uint8_t count = (waiting_buffer_head + WAITING_BUFFER_SIZE - waiting_buffer_tail) % WAITING_BUFFER_SIZE;
+    if (count > waiting_buffer_stats.high_water) {
+        waiting_buffer_stats.high_water = count;
+    }
+
     debug("waiting_buffer_enq: "); debug_waiting_buffer();
     return true;
 }
@@ -325,6 +509,53 @@ void waiting_buffer_clear(void)
     waiting_buffer_tail = 0;
 }
 
+/** \brief Waiting buffer settle tapping key
+ *
+ * Settles an undecided tapping key as hold, as that is what it is when this
+ * many keys are typed during it. A tap that was already released stops
+ * waiting for a sequential tap. Returns false if there was nothing to settle.
+ */
+bool waiting_buffer_settle_tapping_key(void)
+{
+    if (IS_TAPPING_PRESSED() && tapping_key.tap.count == 0) {
+        debug("Tapping: End. No tap. Waiting buffer full\n");
+        process_record(&tapping_key);
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        waiting_buffer_stats.forced++;
+        return true;
+    }
+    if (IS_TAPPING_RELEASED()) {
+        debug("Tapping: End. No sequential tap. Waiting buffer full\n");
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        return true;
+    }
+    return false;
+}
+
+/** \brief Waiting buffer settle
+ *
+ * Called when the buffer is full. Settles the tapping key and processes all
+ * the waiting events. An event that has to wait again, for a tap key pressed
+ * among them or because the tapping key has just timed out, is retried once
+ * that is settled too.
+ */
+void waiting_buffer_settle(void)
+{
+    waiting_buffer_settle_tapping_key();
+
+    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
+        keyrecord_t *record = &waiting_buffer[waiting_buffer_tail];
+        if (!process_tapping(record)) {
+            waiting_buffer_settle_tapping_key();
+            if (!process_tapping(record)) {
+                break;
+            }
+        }
+    }
+}
+
 /** \brief Waiting buffer typed
  *
  * FIXME: Needs docs
@@ -25,17 +25,51 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 //#define RETRO_TAPPING // Tap anyway, even after TAPPING_TERM, as long as there was no interruption
+//#define HOLD_ON_OTHER_KEY_PRESS // Hold as soon as another key is pressed within TAPPING_TERM
+
+/* Adaptive tapping term: TAPPING_TERM is the upper limit, the term shrinks
+ * to a multiple of the average time keys are held down while typing */
+#ifdef ADAPTIVE_TAPPING_TERM
+#ifndef ADAPTIVE_TAPPING_TERM_MIN
+#define ADAPTIVE_TAPPING_TERM_MIN       100
+#endif
+#ifndef ADAPTIVE_TAPPING_TERM_FACTOR
+#define ADAPTIVE_TAPPING_TERM_FACTOR    2
+#endif
+#endif
 
 /* tap count needed for toggling a feature */
 #ifndef TAPPING_TOGGLE
 #define TAPPING_TOGGLE  5
 #endif
 
+/* events held back while a tapping key is undecided, at most 255 */
+#ifndef WAITING_BUFFER_SIZE
 #define WAITING_BUFFER_SIZE 8
+#endif
 
 
 #ifndef NO_ACTION_TAPPING
+typedef struct {
+    uint8_t high_water;     // most events waiting at once
+    uint16_t forced;        // tapping keys settled as hold because the buffer was full
+} waiting_buffer_stats_t;
+
+extern waiting_buffer_stats_t waiting_buffer_stats;
+
 void action_tapping_process(keyrecord_t record);
+uint16_t get_record_keycode(keyrecord_t *record);
+
+/* Per key settings, only used when the matching *_PER_KEY is defined */
+uint16_t get_tapping_term(uint16_t keycode, keyrecord_t *record);
+bool get_permissive_hold(uint16_t keycode, keyrecord_t *record);
+bool get_hold_on_other_key_press(uint16_t keycode, keyrecord_t *record);
+bool get_retro_tapping(uint16_t keycode, keyrecord_t *record);
+
+#ifdef ADAPTIVE_TAPPING_TERM
+uint16_t adaptive_tapping_term(void);
+void adaptive_tapping_term_reset(void);
+#endif
 #endif
 
 #endif
@@ -10,6 +10,7 @@
 #include "timer.h"
 #include "led.h"
 #include "host.h"
+#include "eeconfig.h"
 
 #ifdef PROTOCOL_LUFA
 	#include "lufa.h"
@@ -43,7 +44,8 @@ __asm__ __volatile__ (  \
 
 /** \brief Suspend idle
  *
- * FIXME: needs doc
+ * Sleeps until the next interrupt. The timer interrupt wakes it every millisecond,
+ * so time is only an upper bound.
  */
 void suspend_idle(uint8_t time)
 {
@@ -126,6 +128,8 @@ static void power_down(uint8_t wdto)
  */
 void suspend_power_down(void)
 {
+    // The host may cut the power while suspended
+    eeconfig_flush();
 #ifndef NO_SUSPEND_POWER_DOWN
     power_down(WDTO_15MS);
 #endif
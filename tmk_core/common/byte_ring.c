@@ -0,0 +1,85 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "byte_ring.h"
+
+#ifdef __AVR__
+    #include <util/atomic.h>
+#else
+    // The host tests have no interrupts to keep out
+    #define ATOMIC_BLOCK(type) for (uint8_t atomic_done = 0; !atomic_done; atomic_done = 1)
+#endif
+
+static void count_dropped(byte_ring_t *ring) {
+    if (ring->dropped != UINT16_MAX) {
+        ring->dropped++;
+    }
+}
+
+void byte_ring_put(byte_ring_t *ring, uint8_t c) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (ring->count == ring->size) {
+            // Drop the oldest byte, which is overwritten below
+            ring->count--;
+            count_dropped(ring);
+        }
+        ring->buffer[ring->head] = c;
+        ring->head = (ring->head + 1) % ring->size;
+        ring->count++;
+    }
+}
+
+bool byte_ring_write(byte_ring_t *ring, const uint8_t *data, uint8_t size) {
+    bool written = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (size > ring->size - ring->count) {
+            count_dropped(ring);
+        } else {
+            for (uint8_t i = 0; i < size; i++) {
+                ring->buffer[ring->head] = data[i];
+                ring->head = (ring->head + 1) % ring->size;
+            }
+            ring->count += size;
+            written = true;
+        }
+    }
+    return written;
+}
+
+uint8_t byte_ring_count(const byte_ring_t *ring) {
+    return ring->count;
+}
+
+uint8_t byte_ring_read(byte_ring_t *ring, uint8_t *data, uint8_t size) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (size > ring->count) {
+            size = ring->count;
+        }
+        uint8_t tail = (ring->head + ring->size - ring->count) % ring->size;
+        for (uint8_t i = 0; i < size; i++) {
+            data[i] = ring->buffer[tail];
+            tail = (tail + 1) % ring->size;
+        }
+        ring->count -= size;
+    }
+    return size;
+}
+
+void byte_ring_clear(byte_ring_t *ring) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ring->count = 0;
+    }
+}
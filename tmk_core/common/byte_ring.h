@@ -0,0 +1,44 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A ring of bytes that output is held in until the main loop writes it to an endpoint in
+// whole packets, so that sending never waits for the host. The console prints to one from
+// the USB interrupt, so adding, reading and clearing are atomic.
+
+typedef struct {
+    uint8_t *buffer;
+    uint8_t size;
+    uint8_t head;
+    uint8_t count;
+    // What was dropped because the ring was full, saturates at UINT16_MAX
+    uint16_t dropped;
+} byte_ring_t;
+
+// A ring kept in an array of at most 255 bytes
+#define BYTE_RING(array) { (array), sizeof(array), 0, 0, 0 }
+
+// Adds a byte, dropping the oldest one when full. Counts dropped bytes.
+void byte_ring_put(byte_ring_t *ring, uint8_t c);
+// Adds all of the data, or none of it if it doesn't fit. Counts dropped writes.
+bool byte_ring_write(byte_ring_t *ring, const uint8_t *data, uint8_t size);
+uint8_t byte_ring_count(const byte_ring_t *ring);
+// Moves up to size bytes to data and returns how many
+uint8_t byte_ring_read(byte_ring_t *ring, uint8_t *data, uint8_t size);
+void byte_ring_clear(byte_ring_t *ring);
@@ -11,13 +11,13 @@
 #include "backlight.h"
 #include "suspend.h"
 #include "wait.h"
+#include "eeconfig.h"
 
 /** \brief suspend idle
  *
- * FIXME: needs doc
+ * Sleeps for time milliseconds, the idle thread halts the core meanwhile.
  */
 void suspend_idle(uint8_t time) {
-	// TODO: this is not used anywhere - what units is 'time' in?
 	wait_ms(time);
 }
 
@@ -33,6 +33,8 @@ void suspend_power_down(void) {
 	// on AVR, this enables the watchdog for 15ms (max), and goes to
 	// SLEEP_MODE_PWR_DOWN
 
+	// The host may cut the power while suspended
+	eeconfig_flush();
 	wait_ms(17);
 }
 
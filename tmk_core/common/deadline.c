@@ -0,0 +1,132 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "deadline.h"
+#include "timer.h"
+
+typedef struct {
+    uint32_t time;
+    deadline_callback_t callback;   // NULL when not in use
+    void *arg;
+} deadline_t;
+
+static deadline_t deadlines[DEADLINE_MAX];
+static uint8_t deadline_count = 0;
+// Earliest of the pending deadlines, only valid when deadline_count > 0
+static uint32_t deadline_earliest;
+
+static inline bool deadline_passed(uint32_t time, uint32_t now) {
+    return (int32_t)(now - time) >= 0;
+}
+
+static void update_earliest(uint32_t now) {
+    uint32_t earliest = UINT32_MAX;
+    for (uint8_t i = 0; i < DEADLINE_MAX; i++) {
+        if (deadlines[i].callback) {
+            uint32_t delay = deadline_passed(deadlines[i].time, now) ? 0 : deadlines[i].time - now;
+            if (delay < earliest) {
+                earliest = delay;
+            }
+        }
+    }
+    deadline_earliest = now + earliest;
+}
+
+static deadline_t* get_deadline(deadline_token_t token) {
+    if (token == DEADLINE_INVALID || token > DEADLINE_MAX || !deadlines[token - 1].callback) {
+        return NULL;
+    }
+    return &deadlines[token - 1];
+}
+
+deadline_token_t deadline_schedule(uint32_t delay, deadline_callback_t callback, void *arg) {
+    for (uint8_t i = 0; i < DEADLINE_MAX; i++) {
+        if (!deadlines[i].callback) {
+            uint32_t now = timer_read32();
+            deadlines[i].time = now + delay;
+            deadlines[i].callback = callback;
+            deadlines[i].arg = arg;
+            deadline_count++;
+            update_earliest(now);
+            return i + 1;
+        }
+    }
+    return DEADLINE_INVALID;
+}
+
+bool deadline_extend(deadline_token_t token, uint32_t delay) {
+    deadline_t* deadline = get_deadline(token);
+    if (!deadline) {
+        return false;
+    }
+    uint32_t now = timer_read32();
+    deadline->time = now + delay;
+    update_earliest(now);
+    return true;
+}
+
+bool deadline_cancel(deadline_token_t token) {
+    deadline_t* deadline = get_deadline(token);
+    if (!deadline) {
+        return false;
+    }
+    deadline->callback = NULL;
+    deadline_count--;
+    update_earliest(timer_read32());
+    return true;
+}
+
+uint32_t deadline_next(void) {
+    if (deadline_count == 0) {
+        return DEADLINE_NONE;
+    }
+    uint32_t now = timer_read32();
+    return deadline_passed(deadline_earliest, now) ? 0 : deadline_earliest - now;
+}
+
+void deadline_task(void) {
+    if (deadline_count == 0) {
+        return;
+    }
+    uint32_t now = timer_read32();
+    if (!deadline_passed(deadline_earliest, now)) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < DEADLINE_MAX; i++) {
+        deadline_t* deadline = &deadlines[i];
+        deadline_callback_t callback = deadline->callback;
+        if (!callback || !deadline_passed(deadline->time, now)) {
+            continue;
+        }
+        uint32_t delay = callback(deadline->time, deadline->arg);
+        if (deadline->callback != callback) {
+            // Cancelled by the callback after all
+            continue;
+        }
+        if (delay) {
+            // Keep the period, unless that is already behind
+            deadline->time += delay;
+            if (deadline_passed(deadline->time, now)) {
+                deadline->time = now + delay;
+            }
+        } else {
+            deadline->callback = NULL;
+            deadline_count--;
+        }
+    }
+    update_earliest(now);
+}
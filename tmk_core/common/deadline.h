@@ -0,0 +1,48 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runs callbacks at a point in time, so that features don't each have to check
+// their own timer on every scan. Times are 32-bit milliseconds from timer_read32().
+
+// Deadlines that can be pending at once
+#ifndef DEADLINE_MAX
+    #define DEADLINE_MAX 8
+#endif
+
+#define DEADLINE_NONE UINT32_MAX
+
+typedef uint8_t deadline_token_t;
+#define DEADLINE_INVALID 0
+
+// Called once the deadline has passed, with the time it was set for. Returns the delay
+// until it should be called again, or 0 when it is done.
+typedef uint32_t (*deadline_callback_t)(uint32_t deadline, void *arg);
+
+// Returns DEADLINE_INVALID when all deadlines are in use
+deadline_token_t deadline_schedule(uint32_t delay, deadline_callback_t callback, void *arg);
+// Moves a pending deadline to delay from now, false if it isn't pending anymore
+bool deadline_extend(deadline_token_t token, uint32_t delay);
+// Returns false if it isn't pending anymore. Callbacks return 0 instead of cancelling themselves.
+bool deadline_cancel(deadline_token_t token);
+// Milliseconds until the next deadline, 0 if it has passed or DEADLINE_NONE if there is none
+uint32_t deadline_next(void);
+// Runs the callbacks of the deadlines that have passed
+void deadline_task(void);
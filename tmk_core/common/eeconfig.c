@@ -1,31 +1,218 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "eeprom.h"
 #include "eeconfig.h"
+#include "deadline.h"
+
+/* Same layout as the settings at EECONFIG_DEBUG to EECONFIG_STENOMODE */
+typedef struct {
+    uint8_t debug;
+    uint8_t default_layer;
+    uint8_t keymap;
+    uint8_t mousekey_accel;
+    uint8_t backlight;
+    uint8_t audio;
+    uint32_t rgb;
+    uint8_t unicode_mode;
+    uint8_t steno_mode;
+} __attribute__ ((packed)) eeconfig_t;
+
+/* 16 bytes */
+typedef struct {
+    uint8_t sequence;   // One more than the slot written before it
+    uint8_t version;
+    uint16_t checksum;  // Of everything after it
+    eeconfig_t config;
+} __attribute__ ((packed)) eeconfig_slot_t;
+
+/* AVR has a real EEPROM, so the slots are kept at its end where they are out of
+ * the way. The EEPROM emulations on ARM level their wear themselves, and some
+ * only have 32 bytes, so there is one slot right after the old settings. With a
+ * single slot the old settings are written as well, as the copy to fall back to.
+ */
+#ifndef EECONFIG_SLOTS
+    #ifdef E2END
+        #define EECONFIG_SLOTS 4
+    #else
+        #define EECONFIG_SLOTS 1
+    #endif
+#endif
+
+#ifndef EECONFIG_STORE_ADDR
+    #ifdef E2END
+        #define EECONFIG_STORE_ADDR (E2END + 1 - EECONFIG_SLOTS * sizeof(eeconfig_slot_t))
+    #else
+        #define EECONFIG_STORE_ADDR 16
+    #endif
+#endif
+
+#define EECONFIG_SLOT(i) ((eeconfig_slot_t *)(EECONFIG_STORE_ADDR + (i) * sizeof(eeconfig_slot_t)))
+
+static eeconfig_t eeconfig;
+static bool eeconfig_loaded = false;
+static bool eeconfig_dirty = false;
+/* Slot that was written last, and its sequence number */
+static uint8_t eeconfig_slot = EECONFIG_SLOTS - 1;
+static uint8_t eeconfig_sequence = 0;
+static deadline_token_t eeconfig_commit_token = DEADLINE_INVALID;
+
+/* Fletcher-16 over the version and the settings */
+static uint16_t eeconfig_checksum(const eeconfig_slot_t *slot)
+{
+    const uint8_t *data = &slot->version;
+    uint16_t sum1 = 0, sum2 = 0;
+
+    sum1 = (sum1 + *data) % 255;
+    sum2 = (sum2 + sum1) % 255;
+    data = (const uint8_t *)&slot->config;
+    for (uint8_t i = 0; i < sizeof(eeconfig_t); i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return sum2 << 8 | sum1;
+}
+
+/** \brief eeconfig load
+ *
+ * Takes the settings from the newest slot that is intact, or from the old
+ * fixed addresses when no slot has been written yet, or with a single slot,
+ * when writing it was cut short.
+ */
+void eeconfig_load(void)
+{
+    bool found = false;
+
+    for (uint8_t i = 0; i < EECONFIG_SLOTS; i++) {
+        eeconfig_slot_t slot;
+        eeprom_read_block(&slot, EECONFIG_SLOT(i), sizeof(slot));
+        if (slot.version != EECONFIG_STORE_VERSION || slot.checksum != eeconfig_checksum(&slot)) {
+            continue;
+        }
+        if (!found || (int8_t)(slot.sequence - eeconfig_sequence) > 0) {
+            eeconfig = slot.config;
+            eeconfig_slot = i;
+            eeconfig_sequence = slot.sequence;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        eeprom_read_block(&eeconfig, EECONFIG_DEBUG, sizeof(eeconfig));
+        eeconfig_slot = EECONFIG_SLOTS - 1;
+    }
+
+    if (eeconfig_commit_token != DEADLINE_INVALID) {
+        deadline_cancel(eeconfig_commit_token);
+        eeconfig_commit_token = DEADLINE_INVALID;
+    }
+    eeconfig_dirty = false;
+    eeconfig_loaded = true;
+}
+
+static eeconfig_t *eeconfig_get(void)
+{
+    if (!eeconfig_loaded) {
+        eeconfig_load();
+    }
+    return &eeconfig;
+}
+
+/** \brief eeconfig flush
+ *
+ * Writes the settings into the slot after the one written last.
+ */
+void eeconfig_flush(void)
+{
+    if (eeconfig_commit_token != DEADLINE_INVALID) {
+        deadline_cancel(eeconfig_commit_token);
+        eeconfig_commit_token = DEADLINE_INVALID;
+    }
+    if (!eeconfig_dirty) {
+        return;
+    }
+
+    eeconfig_slot_t slot = {
+        .sequence = eeconfig_sequence + 1,
+        .version = EECONFIG_STORE_VERSION,
+        .config = eeconfig,
+    };
+    slot.checksum = eeconfig_checksum(&slot);
+
+#if EECONFIG_SLOTS == 1
+    // Written first, so that one of the two is whole if the power goes
+    eeprom_update_block(&eeconfig, EECONFIG_DEBUG, sizeof(eeconfig));
+#endif
+    eeconfig_slot = (eeconfig_slot + 1) % EECONFIG_SLOTS;
+    eeconfig_sequence = slot.sequence;
+    eeprom_update_block(&slot, EECONFIG_SLOT(eeconfig_slot), sizeof(slot));
+    eeconfig_dirty = false;
+}
+
+static uint32_t eeconfig_commit(uint32_t deadline, void *arg)
+{
+    eeconfig_commit_token = DEADLINE_INVALID;
+    eeconfig_flush();
+    return 0;
+}
+
+/* Restarts the wait for the settings to settle down */
+static void eeconfig_changed(void)
+{
+    eeconfig_dirty = true;
+    if (deadline_extend(eeconfig_commit_token, EECONFIG_COMMIT_DELAY)) {
+        return;
+    }
+    eeconfig_commit_token = deadline_schedule(EECONFIG_COMMIT_DELAY, eeconfig_commit, NULL);
+    if (eeconfig_commit_token == DEADLINE_INVALID) {
+        // Nothing to wait with, better write it now than lose it
+        eeconfig_flush();
+    }
+}
+
+#define EECONFIG_UPDATE(field, val) do { \
+    eeconfig_t *config = eeconfig_get(); \
+    if (config->field != (val)) { \
+        config->field = (val); \
+        eeconfig_changed(); \
+    } \
+} while (0)
+
+/** \brief eeconfig is dirty
+ *
+ * True while changes wait for EECONFIG_COMMIT_DELAY to pass.
+ */
+bool eeconfig_is_dirty(void)
+{
+    return eeconfig_dirty;
+}
 
 /** \brief eeconfig initialization
  *
- * FIXME: needs doc
+ * Resets the settings and writes them right away.
  */
 void eeconfig_init(void)
 {
     eeprom_update_word(EECONFIG_MAGIC,          EECONFIG_MAGIC_NUMBER);
-    eeprom_update_byte(EECONFIG_DEBUG,          0);
-    eeprom_update_byte(EECONFIG_DEFAULT_LAYER,  0);
-    eeprom_update_byte(EECONFIG_KEYMAP,         0);
-    eeprom_update_byte(EECONFIG_MOUSEKEY_ACCEL, 0);
+    eeconfig_t *config = eeconfig_get();
+    config->debug = 0;
+    config->default_layer = 0;
+    config->keymap = 0;
+    config->mousekey_accel = 0;
 #ifdef BACKLIGHT_ENABLE
-    eeprom_update_byte(EECONFIG_BACKLIGHT,      0);
+    config->backlight = 0;
 #endif
 #ifdef AUDIO_ENABLE
-    eeprom_update_byte(EECONFIG_AUDIO,             0xFF); // On by default
+    config->audio = 0xFF; // On by default
 #endif
 #if defined(RGBLIGHT_ENABLE) || defined(RGB_MATRIX_ENABLE)
-    eeprom_update_dword(EECONFIG_RGBLIGHT,      0);
+    config->rgb = 0;
 #endif
 #ifdef STENO_ENABLE
-    eeprom_update_byte(EECONFIG_STENOMODE,      0);
+    config->steno_mode = 0;
 #endif
+    eeconfig_dirty = true;
+    eeconfig_flush();
 }
 
 /** \brief eeconfig enable
@@ -59,46 +246,46 @@ bool eeconfig_is_enabled(void)
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_debug(void)      { return eeprom_read_byte(EECONFIG_DEBUG); }
+uint8_t eeconfig_read_debug(void)      { return eeconfig_get()->debug; }
 /** \brief eeconfig update debug
  *
  * FIXME: needs doc
  */
-void eeconfig_update_debug(uint8_t val) { eeprom_update_byte(EECONFIG_DEBUG, val); }
+void eeconfig_update_debug(uint8_t val) { EECONFIG_UPDATE(debug, val); }
 
 /** \brief eeconfig read default layer
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_default_layer(void)      { return eeprom_read_byte(EECONFIG_DEFAULT_LAYER); }
+uint8_t eeconfig_read_default_layer(void)      { return eeconfig_get()->default_layer; }
 /** \brief eeconfig update default layer
  *
  * FIXME: needs doc
  */
-void eeconfig_update_default_layer(uint8_t val) { eeprom_update_byte(EECONFIG_DEFAULT_LAYER, val); }
+void eeconfig_update_default_layer(uint8_t val) { EECONFIG_UPDATE(default_layer, val); }
 
 /** \brief eeconfig read keymap
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_keymap(void)      { return eeprom_read_byte(EECONFIG_KEYMAP); }
+uint8_t eeconfig_read_keymap(void)      { return eeconfig_get()->keymap; }
 /** \brief eeconfig update keymap
  *
  * FIXME: needs doc
  */
-void eeconfig_update_keymap(uint8_t val) { eeprom_update_byte(EECONFIG_KEYMAP, val); }
+void eeconfig_update_keymap(uint8_t val) { EECONFIG_UPDATE(keymap, val); }
 
 #ifdef BACKLIGHT_ENABLE
 /** \brief eeconfig read backlight
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_backlight(void)      { return eeprom_read_byte(EECONFIG_BACKLIGHT); }
+uint8_t eeconfig_read_backlight(void)      { return eeconfig_get()->backlight; }
 /** \brief eeconfig update backlight
  *
  * FIXME: needs doc
  */
-void eeconfig_update_backlight(uint8_t val) { eeprom_update_byte(EECONFIG_BACKLIGHT, val); }
+void eeconfig_update_backlight(uint8_t val) { EECONFIG_UPDATE(backlight, val); }
 #endif
 
 #ifdef AUDIO_ENABLE
@@ -106,10 +293,45 @@ void eeconfig_update_backlight(uint8_t val) { eeprom_update_byte(EECONFIG_BACKLI
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_audio(void)      { return eeprom_read_byte(EECONFIG_AUDIO); }
+uint8_t eeconfig_read_audio(void)      { return eeconfig_get()->audio; }
 /** \brief eeconfig update audio
  *
  * FIXME: needs doc
  */
-void eeconfig_update_audio(uint8_t val) { eeprom_update_byte(EECONFIG_AUDIO, val); }
+void eeconfig_update_audio(uint8_t val) { EECONFIG_UPDATE(audio, val); }
 #endif
+
+#if defined(RGBLIGHT_ENABLE) || defined(RGB_MATRIX_ENABLE)
+/** \brief eeconfig read rgb
+ *
+ * Reads the rgblight or rgb_matrix config.
+ */
+uint32_t eeconfig_read_rgb(void)      { return eeconfig_get()->rgb; }
+/** \brief eeconfig update rgb
+ *
+ * Updates the rgblight or rgb_matrix config, which is written once it stops changing.
+ */
+void eeconfig_update_rgb(uint32_t val) { EECONFIG_UPDATE(rgb, val); }
+#endif
+
+/** \brief eeconfig read unicode mode
+ *
+ * Reads the Unicode input mode.
+ */
+uint8_t eeconfig_read_unicode_mode(void)      { return eeconfig_get()->unicode_mode; }
+/** \brief eeconfig update unicode mode
+ *
+ * Updates the Unicode input mode, which is written once it stops changing.
+ */
+void eeconfig_update_unicode_mode(uint8_t val) { EECONFIG_UPDATE(unicode_mode, val); }
+
+/** \brief eeconfig read steno mode
+ *
+ * Reads the steno protocol.
+ */
+uint8_t eeconfig_read_steno_mode(void)      { return eeconfig_get()->steno_mode; }
+/** \brief eeconfig update steno mode
+ *
+ * Updates the steno protocol, which is written once it stops changing.
+ */
+void eeconfig_update_steno_mode(uint8_t val) { EECONFIG_UPDATE(steno_mode, val); }
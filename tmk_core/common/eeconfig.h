@@ -24,7 +24,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define EECONFIG_MAGIC_NUMBER                       (uint16_t)0xFEED
 
-/* eeprom parameteter address */
+/* eeprom parameteter address
+ *
+ * The settings from EECONFIG_DEBUG to EECONFIG_STENOMODE are only read from
+ * here once, to take them over into the config store (see below), or when its
+ * only slot is damaged. Use the eeconfig_read/update functions for them
+ * instead of these addresses.
+ */
 #define EECONFIG_MAGIC                              (uint16_t *)0
 #define EECONFIG_DEBUG                              (uint8_t *)2
 #define EECONFIG_DEFAULT_LAYER                      (uint8_t *)3
@@ -56,6 +62,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EECONFIG_KEYMAP_NKRO                        (1<<7)
 
 
+/* The settings are kept in RAM and written to the EEPROM once they haven't
+ * changed for EECONFIG_COMMIT_DELAY milliseconds, so that a stream of updates
+ * (e.g. while a hue key is held) only costs a single write.
+ *
+ * Each write goes to the next of EECONFIG_SLOTS slots, which carry a sequence
+ * number and a checksum, so that the wear is spread over the slots and a write
+ * that was cut short falls back to the slot written before it. With a single
+ * slot, the default on ARM, the settings are also written to the old addresses
+ * first, and a write that was cut short falls back to those.
+ */
+#ifndef EECONFIG_COMMIT_DELAY
+#define EECONFIG_COMMIT_DELAY 2000
+#endif
+
+/* Bumped when the layout of the settings changes, older slots are ignored */
+#define EECONFIG_STORE_VERSION 1
+
 bool eeconfig_is_enabled(void);
 
 void eeconfig_init(void);
@@ -64,6 +87,13 @@ void eeconfig_enable(void);
 
 void eeconfig_disable(void);
 
+/* Reads the settings from the EEPROM again, dropping changes not written yet */
+void eeconfig_load(void);
+/* Writes changed settings right away, e.g. before jumping to the bootloader */
+void eeconfig_flush(void);
+/* True while there are changes waiting to be written */
+bool eeconfig_is_dirty(void);
+
 uint8_t eeconfig_read_debug(void);
 void eeconfig_update_debug(uint8_t val);
 
@@ -83,4 +113,16 @@ uint8_t eeconfig_read_audio(void);
 void eeconfig_update_audio(uint8_t val);
 #endif
 
+#if defined(RGBLIGHT_ENABLE) || defined(RGB_MATRIX_ENABLE)
+/* Shared by rgblight and rgb_matrix, see eeconfig_read_rgblight() */
+uint32_t eeconfig_read_rgb(void);
+void eeconfig_update_rgb(uint32_t val);
+#endif
+
+uint8_t eeconfig_read_unicode_mode(void);
+void eeconfig_update_unicode_mode(uint8_t val);
+
+uint8_t eeconfig_read_steno_mode(void);
+void eeconfig_update_steno_mode(uint8_t val);
+
 #endif
@@ -0,0 +1,115 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "idle.h"
+#include "deadline.h"
+#include "suspend.h"
+#include "timer.h"
+
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_ANIMATIONS)
+    #include "rgblight.h"
+#endif
+
+#ifdef AUDIO_ENABLE
+    #include "audio.h"
+#endif
+
+idle_stats_t idle_stats;
+
+static uint32_t last_activity;
+static volatile bool wake_pending;
+
+__attribute__ ((weak))
+bool idle_allowed_user(void) {
+    return true;
+}
+
+__attribute__ ((weak))
+bool idle_allowed_kb(void) {
+    return idle_allowed_user();
+}
+
+__attribute__ ((weak))
+bool matrix_wake_arm(void) {
+    return false;
+}
+
+__attribute__ ((weak))
+void matrix_wake_disarm(void) {}
+
+void idle_activity(void) {
+    last_activity = timer_read32();
+}
+
+void idle_wakeup(void) {
+    wake_pending = true;
+}
+
+static bool idle_allowed(void) {
+    if (timer_elapsed32(last_activity) < IDLE_TIMEOUT) {
+        return false;
+    }
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_ANIMATIONS)
+    // Animations are stepped from the main loop
+    if (rgblight_config.enable && rgblight_config.mode >= 2) {
+        return false;
+    }
+#endif
+#ifdef AUDIO_ENABLE
+    // Notes are advanced from the main loop
+    if (is_playing_notes()) {
+        return false;
+    }
+#endif
+    return idle_allowed_kb();
+}
+
+void idle_task(void) {
+    idle_stats.scans++;
+    if (!idle_allowed()) {
+        return;
+    }
+
+    wake_pending = false;
+    bool armed = matrix_wake_arm();
+    uint32_t budget = armed ? IDLE_MAX_SLEEP : IDLE_SCAN_INTERVAL;
+    uint32_t next = deadline_next();
+    if (next < budget) {
+        budget = next;
+    }
+    if (budget == 0) {
+        if (armed) {
+            matrix_wake_disarm();
+        }
+        return;
+    }
+
+    // Sleep a tick at a time, any interrupt (the timer, USB, the matrix) ends a tick
+    uint32_t start = timer_read32();
+    while (!wake_pending && timer_elapsed32(start) < budget) {
+        suspend_idle(1);
+    }
+    if (armed) {
+        matrix_wake_disarm();
+    }
+
+    idle_stats.sleeps++;
+    idle_stats.idle_time += timer_elapsed32(start);
+    if (wake_pending) {
+        idle_stats.wakeups++;
+        idle_activity();
+    }
+}
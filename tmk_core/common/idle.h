@@ -0,0 +1,66 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sleeps the MCU between scans once the keyboard has been idle for a while. A key press
+// is still seen within IDLE_SCAN_INTERVAL, and within IDLE_MAX_SLEEP when the matrix
+// can raise a wake interrupt.
+
+// Milliseconds without a key down before the scan rate is lowered
+#ifndef IDLE_TIMEOUT
+    #define IDLE_TIMEOUT 50
+#endif
+
+// Milliseconds between scans while idle, at most one debounce period
+#ifndef IDLE_SCAN_INTERVAL
+    #ifdef DEBOUNCE
+        #define IDLE_SCAN_INTERVAL DEBOUNCE
+    #else
+        #define IDLE_SCAN_INTERVAL 5
+    #endif
+#endif
+
+// Milliseconds between scans while idle when matrix_wake_arm() has armed a wake interrupt
+#ifndef IDLE_MAX_SLEEP
+    #define IDLE_MAX_SLEEP 100
+#endif
+
+typedef struct {
+    uint32_t scans;      // Calls to idle_task(), one per main loop pass
+    uint32_t sleeps;     // Passes that slept
+    uint32_t idle_time;  // Milliseconds spent sleeping
+    uint32_t wakeups;    // Sleeps cut short by idle_wakeup()
+} idle_stats_t;
+
+extern idle_stats_t idle_stats;
+
+// Called at the end of each main loop pass, sleeps if nothing needs the loop soon
+void idle_task(void);
+// Keeps the loop at full rate for another IDLE_TIMEOUT
+void idle_activity(void);
+// Ends the current sleep, safe to call from an interrupt
+void idle_wakeup(void);
+
+// Return false to keep scanning at full rate, e.g. while a keymap animates something
+bool idle_allowed_kb(void);
+bool idle_allowed_user(void);
+// Arms an interrupt that calls idle_wakeup() on a key press and returns true, or returns
+// false if the matrix can't do that
+bool matrix_wake_arm(void);
+void matrix_wake_disarm(void);
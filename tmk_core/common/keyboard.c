@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "led.h"
 #include "keycode.h"
 #include "timer.h"
+#include "deadline.h"
 #include "print.h"
 #include "debug.h"
 #include "command.h"
@@ -39,6 +40,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef MOUSEKEY_ENABLE
 #   include "mousekey.h"
 #endif
+#ifdef MOUSE_ENABLE
+#   include "mouse_merge.h"
+#endif
 #ifdef PS2_MOUSE_ENABLE
 #   include "ps2_mouse.h"
 #endif
@@ -51,6 +55,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef RGBLIGHT_ENABLE
 #   include "rgblight.h"
 #endif
+#ifdef RGB_MATRIX_ENABLE
+#   include "rgb_matrix.h"
+#endif
+#ifdef AUDIO_ENABLE
+#   include "audio.h"
+#endif
 #ifdef STENO_ENABLE
 #   include "process_steno.h"
 #endif
@@ -69,6 +79,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef MIDI_ENABLE
 #   include "process_midi.h"
 #endif
+#ifdef IDLE_SLEEP_ENABLE
+#   include "idle.h"
+#endif
 
 #ifdef MATRIX_HAS_GHOST
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
@@ -142,16 +155,92 @@ bool is_keyboard_master(void) {
     return true;
 }
 
+keyboard_boot_stats_t keyboard_boot_stats;
+
+#ifdef PS2_MOUSE_ENABLE
+/* The mouse is reset and waited for, so it's brought up late and polled only after that */
+static bool ps2_mouse_ready = false;
+
+static void ps2_mouse_start(void) {
+    ps2_mouse_init();
+    ps2_mouse_ready = true;
+}
+#endif
+
+/* Peripherals that can take a while to come up, e.g. over blocking I2C, and that
+ * nothing needs for the first scans. Their tasks have to cope with running before.
+ */
+static void (*const deferred_init[])(void) = {
+#ifdef BACKLIGHT_ENABLE
+    backlight_init,
+#endif
+#ifdef RGBLIGHT_ENABLE
+    rgblight_init,
+#endif
+#ifdef RGB_MATRIX_ENABLE
+    rgb_matrix_init_drivers,
+#endif
+#ifdef AUDIO_ENABLE
+    audio_init,
+#endif
+#ifdef STENO_ENABLE
+    steno_init,
+#endif
+#ifdef FAUXCLICKY_ENABLE
+    fauxclicky_init,
+#endif
+#ifdef PS2_MOUSE_ENABLE
+    ps2_mouse_start,
+#endif
+    NULL
+};
+
+static uint8_t deferred_init_stage = 0;
+
+/** \brief Bring up the next deferred peripheral
+ *
+ * Returns false once they are all up.
+ */
+static bool keyboard_init_step(void) {
+    void (*init)(void) = deferred_init[deferred_init_stage];
+    if (!init) {
+        return false;
+    }
+
+    uint16_t start = timer_read();
+    init();
+    uint16_t time = timer_elapsed(start);
+    if (time > keyboard_boot_stats.slowest) {
+        keyboard_boot_stats.slowest = time;
+        keyboard_boot_stats.slowest_stage = deferred_init_stage;
+    }
+
+    deferred_init_stage++;
+    if (!deferred_init[deferred_init_stage]) {
+        keyboard_boot_stats.done = timer_read();
+        dprintf("boot: ready %ums, first scan %ums, done %ums, slowest stage %u %ums\n",
+                keyboard_boot_stats.ready, keyboard_boot_stats.first_scan, keyboard_boot_stats.done,
+                keyboard_boot_stats.slowest_stage, keyboard_boot_stats.slowest);
+        return false;
+    }
+    return true;
+}
+
+/** \brief keyboard_init_pending
+ *
+ * True until the deferred peripherals are all up.
+ */
+bool keyboard_init_pending(void) {
+    return deferred_init[deferred_init_stage] != NULL;
+}
+
 /** \brief keyboard_init
  *
- * FIXME: needs doc
+ * Brings up the matrix and whatever the first scan needs, see deferred_init for the rest.
  */
 void keyboard_init(void) {
     timer_init();
     matrix_init();
-#ifdef PS2_MOUSE_ENABLE
-    ps2_mouse_init();
-#endif
 #ifdef SERIAL_MOUSE_ENABLE
     serial_mouse_init();
 #endif
@@ -163,24 +252,19 @@ void keyboard_init(void) {
 #else
     magic();
 #endif
-#ifdef BACKLIGHT_ENABLE
-    backlight_init();
-#endif
-#ifdef RGBLIGHT_ENABLE
-    rgblight_init();
-#endif
-#ifdef STENO_ENABLE
-    steno_init();
-#endif
-#ifdef FAUXCLICKY_ENABLE
-    fauxclicky_init();
-#endif
 #ifdef POINTING_DEVICE_ENABLE
     pointing_device_init();
 #endif
 #if defined(NKRO_ENABLE) && defined(FORCE_NKRO)
     keymap_config.nkro = 1;
 #endif
+#ifdef NO_DEFERRED_INIT
+    while (keyboard_init_step());
+#endif
+    keyboard_boot_stats.ready = timer_read();
+    if (!keyboard_init_pending()) {
+        keyboard_boot_stats.done = keyboard_boot_stats.ready;
+    }
 }
 
 /** \brief Keyboard task: Do keyboard routine jobs
@@ -193,7 +277,8 @@ void keyboard_init(void) {
  * * handle midi commands
  * * light LEDs
  *
- * This is repeatedly called as fast as possible.
+ * This is repeatedly called as fast as possible, or once per IDLE_SCAN_INTERVAL
+ * while idle with IDLE_SLEEP_ENABLE.
  */
 void keyboard_task(void)
 {
@@ -209,10 +294,18 @@ void keyboard_task(void)
 #endif
 
     matrix_scan();
+    if (!keyboard_boot_stats.first_scan) {
+        keyboard_boot_stats.first_scan = timer_read() | 1;
+    }
     if (is_keyboard_master()) {
         for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
             matrix_row = matrix_get_row(r);
             matrix_change = matrix_row ^ matrix_prev[r];
+#ifdef IDLE_SLEEP_ENABLE
+            if (matrix_row) {
+                idle_activity();
+            }
+#endif
             if (matrix_change) {
 #ifdef MATRIX_HAS_GHOST
                 if (has_ghost_in_row(r, matrix_row)) {
@@ -258,13 +351,17 @@ void keyboard_task(void)
 
 MATRIX_LOOP_END:
 
+    deadline_task();
+
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
     mousekey_task();
 #endif
 
 #ifdef PS2_MOUSE_ENABLE
-    ps2_mouse_task();
+    if (ps2_mouse_ready) {
+        ps2_mouse_task();
+    }
 #endif
 
 #ifdef SERIAL_MOUSE_ENABLE
@@ -287,10 +384,20 @@ MATRIX_LOOP_END:
     pointing_device_task();
 #endif
 
+#ifdef MOUSE_ENABLE
+    // one report with the motion of all of the above
+    mouse_merge_task();
+#endif
+
 #ifdef MIDI_ENABLE
     midi_task();
 #endif
 
+    // bring up one more peripheral, the LEDs are set once they are all up
+    if (keyboard_init_step()) {
+        return;
+    }
+
     // update LED
     if (led_status != host_keyboard_leds()) {
         led_status = host_keyboard_leds();
@@ -66,6 +66,23 @@ void keyboard_task(void);
 /* it runs when host LED status is updated */
 void keyboard_set_leds(uint8_t leds);
 
+/* keyboard_init() only brings up what is needed to scan the matrix and talk to the
+ * host, the slower peripherals (backlight, RGB, audio, PS/2 mouse...) follow one per
+ * keyboard_task() call. Define NO_DEFERRED_INIT to bring them all up in keyboard_init().
+ */
+bool keyboard_init_pending(void);
+
+/* Milliseconds since timer_init() at the points of the boot */
+typedef struct {
+    uint16_t ready;         // keyboard_init() returned
+    uint16_t first_scan;    // the first keyboard_task() scanned the matrix
+    uint16_t done;          // the last peripheral is up
+    uint16_t slowest;       // time the slowest peripheral took to come up
+    uint8_t slowest_stage;  // and its index among the deferred ones
+} keyboard_boot_stats_t;
+
+extern keyboard_boot_stats_t keyboard_boot_stats;
+
 #ifdef __cplusplus
 }
 #endif
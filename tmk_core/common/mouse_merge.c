@@ -0,0 +1,105 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mouse_merge.h"
+
+#ifdef MOUSE_ENABLE
+
+#include "host.h"
+#include "timer.h"
+
+static int16_t merged_x;
+static int16_t merged_y;
+static int16_t merged_v;
+static int16_t merged_h;
+static uint8_t source_buttons[MOUSE_SOURCE_COUNT];
+static uint8_t sent_buttons;
+static bool merged_pending;
+static uint16_t last_send;
+
+static uint8_t merged_buttons(void) {
+    uint8_t buttons = 0;
+    for (uint8_t i = 0; i < MOUSE_SOURCE_COUNT; i++) {
+        buttons |= source_buttons[i];
+    }
+    return buttons;
+}
+
+// Saturates, which only loses motion that would take seconds to send anyway
+static void add_axis(int16_t* axis, int8_t delta) {
+    int32_t sum = (int32_t)*axis + delta;
+    *axis = sum > INT16_MAX ? INT16_MAX : sum < -INT16_MAX ? -INT16_MAX : sum;
+}
+
+// The part of the axis that fits into a report, -128 isn't used
+static int8_t take_axis(int16_t* axis) {
+    int8_t part = *axis > 127 ? 127 : *axis < -127 ? -127 : *axis;
+    *axis -= part;
+    return part;
+}
+
+static void send(void) {
+    report_mouse_t report = {
+        .buttons = merged_buttons(),
+        .x = take_axis(&merged_x),
+        .y = take_axis(&merged_y),
+        .v = take_axis(&merged_v),
+        .h = take_axis(&merged_h),
+    };
+    host_mouse_send(&report);
+    sent_buttons = report.buttons;
+    merged_pending = merged_x || merged_y || merged_v || merged_h;
+    last_send = timer_read();
+}
+
+void mouse_merge_add(uint8_t source, const report_mouse_t* report) {
+    uint8_t buttons = merged_buttons();
+    if (source_buttons[source] != report->buttons) {
+        if (buttons != sent_buttons) {
+            // Another change of the buttons is still waiting, which would be lost
+            send();
+        }
+        source_buttons[source] = report->buttons;
+    }
+
+    add_axis(&merged_x, report->x);
+    add_axis(&merged_y, report->y);
+    add_axis(&merged_v, report->v);
+    add_axis(&merged_h, report->h);
+    merged_pending = merged_x || merged_y || merged_v || merged_h || merged_buttons() != sent_buttons;
+}
+
+void mouse_merge_task(void) {
+    if (merged_pending && timer_elapsed(last_send) >= MOUSE_SEND_INTERVAL) {
+        send();
+    }
+}
+
+bool mouse_merge_pending(void) {
+    return merged_pending;
+}
+
+void mouse_merge_clear(void) {
+    merged_x = merged_y = merged_v = merged_h = 0;
+    for (uint8_t i = 0; i < MOUSE_SOURCE_COUNT; i++) {
+        source_buttons[i] = 0;
+    }
+    sent_buttons = 0;
+    merged_pending = false;
+    last_send = timer_read() - MOUSE_SEND_INTERVAL;
+}
+
+#endif
@@ -0,0 +1,55 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "report.h"
+
+// Merges the mouse reports of mouse keys and all pointing devices into one, which is sent at
+// most once per polling interval of the mouse endpoint. Motion is added up and whatever doesn't
+// fit into a report is sent with the next one, so none is lost. Each source keeps its own
+// buttons, the report has the buttons held on any of them.
+
+// In milliseconds, the polling interval of the mouse endpoint
+#ifndef MOUSE_SEND_INTERVAL
+    #define MOUSE_SEND_INTERVAL 10
+#endif
+
+enum mouse_source {
+    MOUSE_SOURCE_MOUSEKEY,
+    MOUSE_SOURCE_POINTING_DEVICE,
+    MOUSE_SOURCE_PS2,
+    MOUSE_SOURCE_SERIAL,
+    MOUSE_SOURCE_COUNT
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Adds the motion of the report, and replaces the buttons of the source with its buttons. A
+// button change is never merged away, when there is one that wasn't sent yet it's sent first.
+void mouse_merge_add(uint8_t source, const report_mouse_t* report);
+// Sends the report if there is something to send and the interval is over
+void mouse_merge_task(void);
+bool mouse_merge_pending(void);
+void mouse_merge_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,12 +16,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "keycode.h"
 #include "host.h"
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
 #include "mousekey.h"
+#include "mouse_merge.h"
 
 
 
@@ -29,6 +31,18 @@ static report_mouse_t mouse_report = {};
 static uint8_t mousekey_repeat =  0;
 static uint8_t mousekey_accel = 0;
 
+/* direction of each axis from the keys held down (-1, 0 or 1) */
+static int8_t mousekey_dir_x = 0;
+static int8_t mousekey_dir_y = 0;
+static int8_t mousekey_dir_v = 0;
+static int8_t mousekey_dir_h = 0;
+/* motion not reported yet, in 1/256 of a unit */
+static int16_t mousekey_remainder_x = 0;
+static int16_t mousekey_remainder_y = 0;
+static int16_t mousekey_remainder_v = 0;
+static int16_t mousekey_remainder_h = 0;
+static bool mousekey_pending = false;
+
 static void mousekey_debug(void);
 
 
@@ -36,7 +50,10 @@ static void mousekey_debug(void);
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta * max_speed * curve(repeat / time_to_max)
+ *
+ * Speeds are kept in 1/256 of a unit, and the fractions left over after each
+ * event carry over to the next one, so slow and diagonal motion stays smooth.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
@@ -46,8 +63,8 @@ uint8_t mk_interval = MOUSEKEY_INTERVAL;
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
 /* number of events (count) accelerating to steady speed (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+/* ramp used to reach maximum pointer speed */
+uint8_t mk_curve = MOUSEKEY_CURVE;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
@@ -55,94 +72,120 @@ uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
 static uint16_t last_timer = 0;
 
-inline int8_t times_inv_sqrt2(int8_t x)
-{
-    // 181/256 is pretty close to 1/sqrt(2)
-    // 0.70703125                 0.707106781
-    // 1 too small for x=99 and x=198
-    // This ends up being a mult and discard lower 8 bits
-    return (x * 181) >> 8;
-}
+/* 181/256 is pretty close to 1/sqrt(2), applied before the fraction is dropped */
+#define TIMES_INV_SQRT2(x) (((uint32_t)(x) * 181) >> 8)
 
-static uint8_t move_unit(void)
+/* fraction of the steady speed reached after repeat events, out of 65536 */
+static uint32_t ramp(uint8_t time_to_max)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
-    } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
+    if (mousekey_repeat >= time_to_max)
+        return 65536;
+
+    uint32_t t = ((uint32_t)mousekey_repeat << 16) / time_to_max;
+    uint32_t t2 = (t * t) >> 16;
+    switch (mk_curve) {
+        case MOUSEKEY_CURVE_QUADRATIC:
+            return t2;
+        case MOUSEKEY_CURVE_KINETIC:
+            /* eases in and out: 3t^2 - 2t^3 */
+            return 3 * t2 - 2 * ((t2 * t) >> 16);
+        default:
+            return t;
     }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
 }
 
-static uint8_t wheel_unit(void)
+/* units per event, in 1/256 of a unit */
+static uint16_t unit(uint8_t delta, uint8_t max_speed, uint8_t time_to_max, uint8_t max)
 {
-    uint16_t unit;
+    uint32_t unit;
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
+        unit = ((uint32_t)delta * max_speed << 8)/4;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
+        unit = ((uint32_t)delta * max_speed << 8)/2;
     } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
+        unit = ((uint32_t)delta * max_speed << 8);
     } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
+        unit = (uint16_t)delta << 8;
     } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+        unit = ((uint32_t)delta * max_speed * ramp(time_to_max)) >> 8;
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+    return (unit > ((uint16_t)max << 8) ? ((uint16_t)max << 8) : (unit == 0 ? 1 : unit));
 }
 
-void mousekey_task(void)
+static uint16_t move_unit(void)
 {
-    if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
-        return;
+    return unit(MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max, MOUSEKEY_MOVE_MAX);
+}
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        return;
+static uint16_t wheel_unit(void)
+{
+    return unit(MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max, MOUSEKEY_WHEEL_MAX);
+}
 
-    if (mousekey_repeat != UINT8_MAX)
-        mousekey_repeat++;
+static int8_t add_clamped(int8_t a, int8_t b)
+{
+    int16_t sum = a + b;
+    return (sum > 127 ? 127 : (sum < -127 ? -127 : sum));
+}
 
+/* adds dir * unit to the remainder and returns the whole units of it */
+static int8_t step_axis(int16_t *remainder, int8_t dir, uint16_t unit)
+{
+    if (!dir) {
+        *remainder = 0;
+        return 0;
+    }
+    *remainder += (dir > 0 ? (int16_t)unit : -(int16_t)unit);
+    int8_t whole = *remainder / 256;
+    *remainder -= whole * 256;
+    return whole;
+}
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+static bool mousekey_moving(void)
+{
+    return mousekey_dir_x || mousekey_dir_y || mousekey_dir_v || mousekey_dir_h;
+}
 
+static void mousekey_step(void)
+{
+    uint16_t move = move_unit();
     /* diagonal move [1/sqrt(2)] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x = times_inv_sqrt2(mouse_report.x);
-        mouse_report.y = times_inv_sqrt2(mouse_report.y);
-    }
+    if (mousekey_dir_x && mousekey_dir_y)
+        move = TIMES_INV_SQRT2(move);
+    uint16_t wheel = wheel_unit();
+
+    mouse_report.x = add_clamped(mouse_report.x, step_axis(&mousekey_remainder_x, mousekey_dir_x, move));
+    mouse_report.y = add_clamped(mouse_report.y, step_axis(&mousekey_remainder_y, mousekey_dir_y, move));
+    mouse_report.v = add_clamped(mouse_report.v, step_axis(&mousekey_remainder_v, mousekey_dir_v, wheel));
+    mouse_report.h = add_clamped(mouse_report.h, step_axis(&mousekey_remainder_h, mousekey_dir_h, wheel));
+    mousekey_pending = true;
+    last_timer = timer_read();
+}
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+void mousekey_task(void)
+{
+    if (mousekey_moving() && timer_elapsed(last_timer) >= (mousekey_repeat ? mk_interval : mk_delay*10)) {
+        if (mousekey_repeat != UINT8_MAX)
+            mousekey_repeat++;
+        mousekey_step();
+    }
 
-    mousekey_send();
+    if (mousekey_pending)
+        mousekey_send();
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    bool moving = mousekey_moving();
+
+    if      (code == KC_MS_UP)       mousekey_dir_y = -1;
+    else if (code == KC_MS_DOWN)     mousekey_dir_y = 1;
+    else if (code == KC_MS_LEFT)     mousekey_dir_x = -1;
+    else if (code == KC_MS_RIGHT)    mousekey_dir_x = 1;
+    else if (code == KC_MS_WH_UP)    mousekey_dir_v = 1;
+    else if (code == KC_MS_WH_DOWN)  mousekey_dir_v = -1;
+    else if (code == KC_MS_WH_LEFT)  mousekey_dir_h = -1;
+    else if (code == KC_MS_WH_RIGHT) mousekey_dir_h = 1;
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -151,18 +194,25 @@ void mousekey_on(uint8_t code)
     else if (code == KC_MS_ACCEL0)   mousekey_accel |= (1<<0);
     else if (code == KC_MS_ACCEL1)   mousekey_accel |= (1<<1);
     else if (code == KC_MS_ACCEL2)   mousekey_accel |= (1<<2);
+
+    /* a new direction moves right away, the next event follows after mk_delay */
+    if (IS_MOUSEKEY_MOVE(code) || IS_MOUSEKEY_WHEEL(code)) {
+        if (!moving)
+            mousekey_repeat = 0;
+        mousekey_step();
+    }
 }
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    if      (code == KC_MS_UP       && mousekey_dir_y < 0) mousekey_dir_y = 0;
+    else if (code == KC_MS_DOWN     && mousekey_dir_y > 0) mousekey_dir_y = 0;
+    else if (code == KC_MS_LEFT     && mousekey_dir_x < 0) mousekey_dir_x = 0;
+    else if (code == KC_MS_RIGHT    && mousekey_dir_x > 0) mousekey_dir_x = 0;
+    else if (code == KC_MS_WH_UP    && mousekey_dir_v > 0) mousekey_dir_v = 0;
+    else if (code == KC_MS_WH_DOWN  && mousekey_dir_v < 0) mousekey_dir_v = 0;
+    else if (code == KC_MS_WH_LEFT  && mousekey_dir_h < 0) mousekey_dir_h = 0;
+    else if (code == KC_MS_WH_RIGHT && mousekey_dir_h > 0) mousekey_dir_h = 0;
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -172,15 +222,21 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
+    if (!mousekey_moving())
         mousekey_repeat = 0;
 }
 
+/* hands the motion and buttons over to the merged report, which is sent once the interval is over */
 void mousekey_send(void)
 {
     mousekey_debug();
-    host_mouse_send(&mouse_report);
-    last_timer = timer_read();
+    mouse_merge_add(MOUSE_SOURCE_MOUSEKEY, &mouse_report);
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
+    mousekey_pending = false;
+    mouse_merge_task();
 }
 
 void mousekey_clear(void)
@@ -188,6 +244,9 @@ void mousekey_clear(void)
     mouse_report = (report_mouse_t){};
     mousekey_repeat = 0;
     mousekey_accel = 0;
+    mousekey_dir_x = mousekey_dir_y = mousekey_dir_v = mousekey_dir_h = 0;
+    mousekey_remainder_x = mousekey_remainder_y = mousekey_remainder_v = mousekey_remainder_h = 0;
+    mousekey_pending = false;
 }
 
 static void mousekey_debug(void)
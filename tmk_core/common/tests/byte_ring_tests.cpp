@@ -0,0 +1,130 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "byte_ring.h"
+}
+
+// Endpoint size of the LUFA virtual serial port
+#define PACKET_SIZE 16
+#define RING_SIZE 64
+
+class ByteRing : public testing::Test {
+public:
+    std::vector<uint8_t> read(uint8_t size) {
+        uint8_t out[256] = {};
+        uint8_t count = byte_ring_read(&ring, out, size);
+        return std::vector<uint8_t>(out, out + count);
+    }
+
+    void put(const char* s) {
+        while (*s) {
+            byte_ring_put(&ring, *s++);
+        }
+    }
+
+    std::string read_string(uint8_t size) {
+        std::vector<uint8_t> out = read(size);
+        return std::string(out.begin(), out.end());
+    }
+
+    uint8_t data[RING_SIZE];
+    byte_ring_t ring = BYTE_RING(data);
+};
+
+TEST_F(ByteRing, starts_empty) {
+    EXPECT_EQ(byte_ring_count(&ring), 0);
+    EXPECT_TRUE(read(PACKET_SIZE).empty());
+}
+
+TEST_F(ByteRing, reads_packet_sized_chunks_in_order) {
+    put("0123456789abcdefghij");
+    EXPECT_EQ(byte_ring_count(&ring), 20);
+    EXPECT_EQ(read_string(PACKET_SIZE), "0123456789abcdef");
+    EXPECT_EQ(read_string(PACKET_SIZE), "ghij");
+    EXPECT_EQ(byte_ring_count(&ring), 0);
+}
+
+TEST_F(ByteRing, keeps_order_when_wrapping) {
+    for (int i = 0; i < 10; i++) {
+        put("0123456789abcdefghij");
+        EXPECT_EQ(read_string(20), "0123456789abcdefghij");
+    }
+    const uint8_t chord[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    EXPECT_TRUE(byte_ring_write(&ring, chord, sizeof(chord)));
+    EXPECT_EQ(read(PACKET_SIZE), std::vector<uint8_t>(chord, chord + 8));
+}
+
+TEST_F(ByteRing, put_drops_the_oldest_byte_when_full) {
+    for (int i = 0; i < RING_SIZE; i++) {
+        byte_ring_put(&ring, 'a');
+    }
+    put("xyz");
+    EXPECT_EQ(byte_ring_count(&ring), RING_SIZE);
+    EXPECT_EQ(ring.dropped, 3);
+    std::string all = read_string(255);
+    EXPECT_EQ(all, std::string(RING_SIZE - 3, 'a') + "xyz");
+}
+
+TEST_F(ByteRing, write_drops_what_doesnt_fit_whole) {
+    uint8_t fill[RING_SIZE - 4] = {};
+    EXPECT_TRUE(byte_ring_write(&ring, fill, sizeof(fill)));
+    const uint8_t chord[] = {0x81, 0x02, 0x03, 0x04, 0x05, 0x06};
+    EXPECT_FALSE(byte_ring_write(&ring, chord, sizeof(chord)));
+    EXPECT_EQ(byte_ring_count(&ring), sizeof(fill));
+    EXPECT_EQ(ring.dropped, 1);
+    EXPECT_TRUE(byte_ring_write(&ring, chord, 4));
+    EXPECT_EQ(byte_ring_count(&ring), RING_SIZE);
+}
+
+TEST_F(ByteRing, the_dropped_count_saturates) {
+    ring.dropped = UINT16_MAX - 1;
+    for (int i = 0; i < RING_SIZE + 5; i++) {
+        byte_ring_put(&ring, 'a');
+    }
+    EXPECT_EQ(ring.dropped, UINT16_MAX);
+}
+
+TEST_F(ByteRing, clear_empties_it) {
+    put("abc");
+    byte_ring_clear(&ring);
+    EXPECT_EQ(byte_ring_count(&ring), 0);
+    put("d");
+    EXPECT_EQ(read_string(PACKET_SIZE), "d");
+}
+
+TEST_F(ByteRing, benchmark_gemini_chords_per_second) {
+    // The host takes one packet per 1 ms frame, before it took one byte
+    const uint8_t chord[] = {0x81, 0x02, 0x03, 0x04, 0x05, 0x06};
+    const int count = 1000;
+    int written = 0;
+    int frames = 0;
+    while (written < count || byte_ring_count(&ring)) {
+        // A chord from the keyboard every scan, as fast as the ring takes them
+        while (written < count && RING_SIZE - byte_ring_count(&ring) >= sizeof(chord)) {
+            byte_ring_write(&ring, chord, sizeof(chord));
+            written++;
+        }
+        read(PACKET_SIZE);
+        frames++;
+    }
+    double chords_per_second = count * 1000.0 / frames;
+    printf("[ BENCHMARK] %.0f Gemini PR chords/s, was %.0f with a packet per byte\n", chords_per_second, 1000.0 / sizeof(chord));
+    EXPECT_EQ(ring.dropped, 0);
+    EXPECT_GE(chords_per_second, 2500);
+}
@@ -0,0 +1,194 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "deadline.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+struct call_t {
+    uint32_t now;
+    uint32_t deadline;
+    int id;
+};
+
+static std::vector<call_t> calls;
+static uint32_t next_delay[DEADLINE_MAX + 1];
+static deadline_token_t cancel_token;
+
+static uint32_t callback(uint32_t deadline, void *arg) {
+    int id = (int)(intptr_t)arg;
+    calls.push_back({timer_read32(), deadline, id});
+    return next_delay[id];
+}
+
+static uint32_t cancelling_callback(uint32_t deadline, void *arg) {
+    deadline_cancel(cancel_token);
+    return callback(deadline, arg);
+}
+
+class Deadline : public testing::Test {
+public:
+    Deadline() {
+        set_time(1000);
+        calls.clear();
+        for (auto& delay : next_delay) {
+            delay = 0;
+        }
+    }
+
+    ~Deadline() {
+        for (deadline_token_t token = 1; token <= DEADLINE_MAX; token++) {
+            deadline_cancel(token);
+        }
+    }
+
+    deadline_token_t schedule(uint32_t delay, int id) {
+        return deadline_schedule(delay, callback, (void*)(intptr_t)id);
+    }
+
+    void run_for(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            advance_time(1);
+            deadline_task();
+        }
+    }
+};
+
+TEST_F(Deadline, nothing_is_pending_at_first) {
+    EXPECT_EQ(deadline_next(), DEADLINE_NONE);
+    run_for(100);
+    EXPECT_TRUE(calls.empty());
+}
+
+TEST_F(Deadline, a_callback_is_called_once_when_its_deadline_passes) {
+    ASSERT_NE(schedule(50, 1), DEADLINE_INVALID);
+    EXPECT_EQ(deadline_next(), 50);
+    run_for(49);
+    EXPECT_TRUE(calls.empty());
+    EXPECT_EQ(deadline_next(), 1);
+    run_for(100);
+    ASSERT_EQ(calls.size(), 1);
+    EXPECT_EQ(calls[0].now, 1050);
+    EXPECT_EQ(calls[0].deadline, 1050);
+    EXPECT_EQ(deadline_next(), DEADLINE_NONE);
+}
+
+TEST_F(Deadline, the_next_deadline_is_the_earliest_one) {
+    schedule(300, 1);
+    schedule(100, 2);
+    schedule(200, 3);
+    EXPECT_EQ(deadline_next(), 100);
+    run_for(400);
+    ASSERT_EQ(calls.size(), 3);
+    EXPECT_EQ(calls[0].id, 2);
+    EXPECT_EQ(calls[1].id, 3);
+    EXPECT_EQ(calls[2].id, 1);
+}
+
+TEST_F(Deadline, a_late_task_still_calls_the_callback) {
+    schedule(10, 1);
+    advance_time(500);
+    EXPECT_EQ(deadline_next(), 0);
+    deadline_task();
+    ASSERT_EQ(calls.size(), 1);
+    EXPECT_EQ(calls[0].deadline, 1010);
+}
+
+TEST_F(Deadline, returning_a_delay_calls_the_callback_again) {
+    next_delay[1] = 20;
+    schedule(20, 1);
+    run_for(100);
+    ASSERT_EQ(calls.size(), 5);
+    for (size_t i = 0; i < calls.size(); i++) {
+        EXPECT_EQ(calls[i].now, 1020 + 20 * i);
+    }
+    next_delay[1] = 0;
+    run_for(100);
+    EXPECT_EQ(calls.size(), 6);
+}
+
+TEST_F(Deadline, a_repeating_callback_does_not_catch_up_after_a_long_pause) {
+    next_delay[1] = 10;
+    schedule(10, 1);
+    advance_time(1000);
+    deadline_task();
+    EXPECT_EQ(deadline_next(), 10);
+}
+
+TEST_F(Deadline, extending_moves_the_deadline) {
+    deadline_token_t token = schedule(50, 1);
+    run_for(40);
+    EXPECT_TRUE(deadline_extend(token, 50));
+    run_for(49);
+    EXPECT_TRUE(calls.empty());
+    run_for(1);
+    EXPECT_EQ(calls.size(), 1);
+    EXPECT_FALSE(deadline_extend(token, 50));
+}
+
+TEST_F(Deadline, cancelling_removes_the_deadline) {
+    deadline_token_t token = schedule(50, 1);
+    schedule(100, 2);
+    EXPECT_TRUE(deadline_cancel(token));
+    EXPECT_FALSE(deadline_cancel(token));
+    EXPECT_EQ(deadline_next(), 100);
+    run_for(200);
+    ASSERT_EQ(calls.size(), 1);
+    EXPECT_EQ(calls[0].id, 2);
+    EXPECT_FALSE(deadline_cancel(DEADLINE_INVALID));
+}
+
+TEST_F(Deadline, a_callback_can_cancel_another_deadline) {
+    deadline_schedule(10, cancelling_callback, (void*)1);
+    cancel_token = schedule(10, 2);
+    run_for(100);
+    ASSERT_EQ(calls.size(), 1);
+    EXPECT_EQ(calls[0].id, 1);
+    EXPECT_EQ(deadline_next(), DEADLINE_NONE);
+}
+
+TEST_F(Deadline, scheduling_fails_when_all_deadlines_are_used) {
+    for (int i = 0; i < DEADLINE_MAX; i++) {
+        EXPECT_NE(schedule(10 + i, i), DEADLINE_INVALID);
+    }
+    EXPECT_EQ(schedule(10, DEADLINE_MAX), DEADLINE_INVALID);
+    run_for(10);
+    EXPECT_NE(schedule(10, DEADLINE_MAX), DEADLINE_INVALID);
+}
+
+TEST_F(Deadline, deadlines_work_across_the_16_bit_timer_wrap) {
+    set_time(0xFFFF - 100);
+    schedule(70000, 1);
+    run_for(69999);
+    EXPECT_TRUE(calls.empty());
+    run_for(1);
+    EXPECT_EQ(calls.size(), 1);
+}
+
+TEST_F(Deadline, deadlines_work_across_the_32_bit_timer_wrap) {
+    set_time(0xFFFFFFFF - 10);
+    schedule(20, 1);
+    EXPECT_EQ(deadline_next(), 20);
+    run_for(19);
+    EXPECT_TRUE(calls.empty());
+    run_for(1);
+    EXPECT_EQ(calls.size(), 1);
+}
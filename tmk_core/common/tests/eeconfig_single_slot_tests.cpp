@@ -0,0 +1,68 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "eeconfig.h"
+#include "eeprom.h"
+}
+
+// The store is set up with a single slot at EECONFIG_STORE_ADDR 16 by the test rules, like on ARM
+#define SLOT_BACKLIGHT ((uint8_t*)(16 + 4 + 4))
+
+class EeconfigSingleSlot : public testing::Test {
+public:
+    EeconfigSingleSlot() {
+        for (uintptr_t addr = 0; addr < 32; addr++) {
+            eeprom_write_byte((uint8_t*)addr, 0xFF);
+        }
+        eeconfig_load();
+    }
+
+    ~EeconfigSingleSlot() {
+        eeconfig_load();
+    }
+};
+
+TEST_F(EeconfigSingleSlot, TheOldAddressesAreWrittenAsWell) {
+    eeconfig_update_backlight(1);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_read_byte(SLOT_BACKLIGHT), 1);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_BACKLIGHT), 1);
+}
+
+TEST_F(EeconfigSingleSlot, ACutShortWriteFallsBackToTheOldAddresses) {
+    eeconfig_update_backlight(1);
+    eeconfig_flush();
+    eeconfig_update_backlight(2);
+    eeconfig_flush();
+    // The old addresses were written, but only part of the slot
+    eeprom_write_byte(SLOT_BACKLIGHT, 0x55);
+
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_backlight(), 2);
+}
+
+TEST_F(EeconfigSingleSlot, ACutShortWriteOfTheOldAddressesKeepsTheSlot) {
+    eeconfig_update_backlight(1);
+    eeconfig_flush();
+    // The power went while the old addresses were written, before the slot
+    eeprom_write_byte(EECONFIG_BACKLIGHT, 2);
+    eeprom_write_byte(EECONFIG_AUDIO, 0x55);
+
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_backlight(), 1);
+}
@@ -0,0 +1,174 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "eeconfig.h"
+#include "eeprom.h"
+#include "deadline.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+// The store is set up with 4 slots at EECONFIG_STORE_ADDR 64 by the test rules
+#define SLOT_ADDR(i) (64 + (i) * 16)
+#define SLOT_VERSION(i) ((uint8_t*)SLOT_ADDR(i) + 1)
+#define SLOT_RGB(i) ((uint32_t*)(SLOT_ADDR(i) + 4 + 6))
+
+class EeconfigStore : public testing::Test {
+public:
+    EeconfigStore() {
+        set_time(1000);
+        for (uintptr_t addr = 0; addr < SLOT_ADDR(4); addr++) {
+            eeprom_write_byte((uint8_t*)addr, 0xFF);
+        }
+        eeconfig_load();
+    }
+
+    ~EeconfigStore() {
+        eeconfig_load();
+    }
+
+    void idle_for(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            advance_time(1);
+            deadline_task();
+        }
+    }
+
+    bool slot_written(int i) {
+        return eeprom_read_byte(SLOT_VERSION(i)) == EECONFIG_STORE_VERSION;
+    }
+};
+
+TEST_F(EeconfigStore, ChangesAreWrittenOnceTheyStopChanging) {
+    for (uint32_t hue = 0; hue < 50; hue++) {
+        eeconfig_update_rgb(hue);
+        idle_for(EECONFIG_COMMIT_DELAY / 2);
+    }
+    EXPECT_TRUE(eeconfig_is_dirty());
+    EXPECT_FALSE(slot_written(0));
+
+    idle_for(EECONFIG_COMMIT_DELAY);
+    EXPECT_FALSE(eeconfig_is_dirty());
+    EXPECT_TRUE(slot_written(0));
+    EXPECT_EQ(eeprom_read_dword(SLOT_RGB(0)), 49);
+    // Only written once
+    EXPECT_FALSE(slot_written(1));
+}
+
+TEST_F(EeconfigStore, AnUnchangedSettingIsNotWritten) {
+    eeconfig_update_audio(0x42);
+    eeconfig_flush();
+    eeconfig_update_audio(0x42);
+    EXPECT_FALSE(eeconfig_is_dirty());
+    idle_for(EECONFIG_COMMIT_DELAY + 1);
+    EXPECT_FALSE(slot_written(1));
+}
+
+TEST_F(EeconfigStore, ReadsSeeChangesBeforeTheyAreWritten) {
+    eeconfig_update_default_layer(4);
+    eeconfig_update_steno_mode(1);
+    EXPECT_EQ(eeconfig_read_default_layer(), 4);
+    EXPECT_EQ(eeconfig_read_steno_mode(), 1);
+    // Until they are dropped
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_default_layer(), 0xFF);
+}
+
+TEST_F(EeconfigStore, EachWriteGoesToTheNextSlot) {
+    for (uint32_t i = 0; i < 6; i++) {
+        eeconfig_update_rgb(100 + i);
+        eeconfig_flush();
+        EXPECT_EQ(eeprom_read_dword(SLOT_RGB(i % 4)), 100 + i);
+    }
+    EXPECT_EQ(eeprom_read_dword(SLOT_RGB(2)), 102);
+
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_rgb(), 105);
+    eeconfig_update_rgb(106);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_read_dword(SLOT_RGB(2)), 106);
+}
+
+TEST_F(EeconfigStore, TheSequenceWrapsAround) {
+    for (uint32_t i = 0; i < 300; i++) {
+        eeconfig_update_rgb(i);
+        eeconfig_flush();
+    }
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_rgb(), 299);
+}
+
+TEST_F(EeconfigStore, ACutShortWriteFallsBackToTheSlotBefore) {
+    eeconfig_update_backlight(1);
+    eeconfig_flush();
+    eeconfig_update_backlight(2);
+    eeconfig_flush();
+    // Only part of the second write made it
+    eeprom_write_dword(SLOT_RGB(1), 0x12345678);
+
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_backlight(), 1);
+    // Which is the slot written next
+    eeconfig_update_backlight(3);
+    eeconfig_flush();
+    EXPECT_NE(eeprom_read_dword(SLOT_RGB(1)), 0x12345678);
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_backlight(), 3);
+}
+
+TEST_F(EeconfigStore, SlotsOfAnotherVersionAreIgnored) {
+    eeconfig_update_keymap(5);
+    eeconfig_flush();
+    eeprom_write_byte(SLOT_VERSION(0), EECONFIG_STORE_VERSION + 1);
+
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_keymap(), 0xFF);
+}
+
+TEST_F(EeconfigStore, TheOldSettingsAreTakenOver) {
+    eeprom_write_word(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    eeprom_write_byte(EECONFIG_DEBUG, 1);
+    eeprom_write_byte(EECONFIG_AUDIO, 0);
+    eeprom_write_dword(EECONFIG_RGBLIGHT, 0xABCDEF01);
+    eeprom_write_byte(EECONFIG_UNICODEMODE, 2);
+
+    eeconfig_load();
+    EXPECT_TRUE(eeconfig_is_enabled());
+    EXPECT_EQ(eeconfig_read_debug(), 1);
+    EXPECT_EQ(eeconfig_read_audio(), 0);
+    EXPECT_EQ(eeconfig_read_rgb(), 0xABCDEF01);
+    EXPECT_EQ(eeconfig_read_unicode_mode(), 2);
+    EXPECT_FALSE(slot_written(0));
+
+    // And written into the store with the first change
+    eeconfig_update_debug(0);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_read_dword(SLOT_RGB(0)), 0xABCDEF01);
+}
+
+TEST_F(EeconfigStore, InitIsWrittenRightAway) {
+    eeconfig_update_rgb(7);
+    eeconfig_init();
+    EXPECT_FALSE(eeconfig_is_dirty());
+    EXPECT_TRUE(eeconfig_is_enabled());
+    EXPECT_TRUE(slot_written(0));
+    eeconfig_load();
+    EXPECT_EQ(eeconfig_read_rgb(), 0);
+    EXPECT_EQ(eeconfig_read_audio(), 0xFF);
+}
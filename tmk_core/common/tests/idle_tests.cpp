@@ -0,0 +1,150 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+extern "C" {
+#include "idle.h"
+#include "deadline.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+static bool allowed;
+static bool wake_armed;
+static bool wake_interrupt;
+static uint32_t wake_at;
+static int armed_count;
+
+extern "C" {
+// Each call stands for one timer tick, or the wake interrupt
+void suspend_idle(uint8_t time) {
+    advance_time(1);
+    if (wake_interrupt && armed_count && timer_read32() == wake_at) {
+        idle_wakeup();
+    }
+}
+
+bool idle_allowed_user(void) {
+    return allowed;
+}
+
+bool matrix_wake_arm(void) {
+    if (wake_armed) {
+        armed_count++;
+    }
+    return wake_armed;
+}
+
+void matrix_wake_disarm(void) {
+    armed_count--;
+}
+
+static uint32_t done(uint32_t deadline, void *arg) {
+    return 0;
+}
+}
+
+class Idle : public testing::Test {
+public:
+    Idle() {
+        set_time(1000);
+        idle_activity();
+        idle_stats = {};
+        allowed = true;
+        wake_armed = false;
+        wake_interrupt = false;
+        armed_count = 0;
+    }
+
+    ~Idle() {
+        for (deadline_token_t token = 1; token <= DEADLINE_MAX; token++) {
+            deadline_cancel(token);
+        }
+    }
+
+    // A main loop pass that takes no time itself
+    uint32_t pass() {
+        uint32_t start = timer_read32();
+        idle_task();
+        return timer_elapsed32(start);
+    }
+};
+
+TEST_F(Idle, does_not_sleep_right_after_activity) {
+    for (int i = 0; i < IDLE_TIMEOUT - 1; i++) {
+        EXPECT_EQ(pass(), 0);
+        advance_time(1);
+    }
+    EXPECT_EQ(idle_stats.sleeps, 0);
+    EXPECT_EQ(idle_stats.scans, IDLE_TIMEOUT - 1);
+}
+
+TEST_F(Idle, sleeps_a_scan_interval_once_idle) {
+    advance_time(IDLE_TIMEOUT);
+    EXPECT_EQ(pass(), IDLE_SCAN_INTERVAL);
+    EXPECT_EQ(pass(), IDLE_SCAN_INTERVAL);
+    EXPECT_EQ(idle_stats.scans, 2);
+    EXPECT_EQ(idle_stats.sleeps, 2);
+    EXPECT_EQ(idle_stats.idle_time, 2 * IDLE_SCAN_INTERVAL);
+}
+
+TEST_F(Idle, activity_restores_full_rate) {
+    advance_time(IDLE_TIMEOUT);
+    EXPECT_EQ(pass(), IDLE_SCAN_INTERVAL);
+    idle_activity();
+    EXPECT_EQ(pass(), 0);
+}
+
+TEST_F(Idle, does_not_sleep_past_a_deadline) {
+    advance_time(IDLE_TIMEOUT);
+    deadline_schedule(2, done, NULL);
+    EXPECT_EQ(pass(), 2);
+    deadline_task();
+    EXPECT_EQ(pass(), IDLE_SCAN_INTERVAL);
+}
+
+TEST_F(Idle, does_not_sleep_with_a_passed_deadline) {
+    deadline_schedule(1, done, NULL);
+    advance_time(IDLE_TIMEOUT);
+    EXPECT_EQ(pass(), 0);
+    EXPECT_EQ(idle_stats.sleeps, 0);
+}
+
+TEST_F(Idle, the_keymap_can_keep_full_rate) {
+    allowed = false;
+    advance_time(IDLE_TIMEOUT);
+    EXPECT_EQ(pass(), 0);
+}
+
+TEST_F(Idle, sleeps_longer_with_a_wake_interrupt) {
+    wake_armed = true;
+    advance_time(IDLE_TIMEOUT);
+    EXPECT_EQ(pass(), IDLE_MAX_SLEEP);
+    EXPECT_EQ(armed_count, 0);
+}
+
+TEST_F(Idle, the_wake_interrupt_ends_the_sleep) {
+    wake_armed = true;
+    wake_interrupt = true;
+    advance_time(IDLE_TIMEOUT);
+    wake_at = timer_read32() + 3;
+    EXPECT_EQ(pass(), 3);
+    EXPECT_EQ(armed_count, 0);
+    EXPECT_EQ(idle_stats.wakeups, 1);
+    // The press keeps the loop at full rate until it has been scanned
+    EXPECT_EQ(pass(), 0);
+}
@@ -0,0 +1,185 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <stdlib.h>
+extern "C" {
+#include "mouse_merge.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+static std::vector<report_mouse_t> reports;
+static std::vector<uint32_t> report_times;
+
+extern "C" void host_mouse_send(report_mouse_t* report) {
+    reports.push_back(*report);
+    report_times.push_back(timer_read32());
+}
+
+class MouseMerge : public testing::Test {
+   public:
+    MouseMerge() {
+        set_time(1000);
+        mouse_merge_clear();
+        reports.clear();
+        report_times.clear();
+    }
+
+    void run_for(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            advance_time(1);
+            mouse_merge_task();
+        }
+    }
+
+    void add(uint8_t source, int8_t x, int8_t y = 0, uint8_t buttons = 0, int8_t v = 0) {
+        report_mouse_t report = {.buttons = buttons, .x = x, .y = y, .v = v};
+        mouse_merge_add(source, &report);
+    }
+
+    long total(int8_t report_mouse_t::*axis) {
+        long sum = 0;
+        for (auto& report : reports) {
+            sum += report.*axis;
+        }
+        return sum;
+    }
+};
+
+TEST_F(MouseMerge, sends_right_away_after_a_quiet_interval) {
+    add(MOUSE_SOURCE_PS2, 5, -3);
+    mouse_merge_task();
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].x, 5);
+    EXPECT_EQ(reports[0].y, -3);
+    EXPECT_FALSE(mouse_merge_pending());
+}
+
+TEST_F(MouseMerge, adds_up_the_motion_of_all_sources) {
+    mouse_merge_task();
+    add(MOUSE_SOURCE_PS2, 5);
+    mouse_merge_task();
+    add(MOUSE_SOURCE_MOUSEKEY, 10, 1);
+    add(MOUSE_SOURCE_POINTING_DEVICE, -3, 2, 0, 1);
+    add(MOUSE_SOURCE_PS2, 1);
+    run_for(MOUSE_SEND_INTERVAL - 1);
+    ASSERT_EQ(reports.size(), 1);
+    run_for(1);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[1].x, 8);
+    EXPECT_EQ(reports[1].y, 3);
+    EXPECT_EQ(reports[1].v, 1);
+}
+
+TEST_F(MouseMerge, carries_over_what_does_not_fit) {
+    for (int i = 0; i < 10; i++) {
+        add(MOUSE_SOURCE_PS2, 127, -127);
+    }
+    add(MOUSE_SOURCE_PS2, 3, -3);
+    run_for(11 * MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 11);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(reports[i].x, 127);
+        EXPECT_EQ(reports[i].y, -127);
+    }
+    EXPECT_EQ(reports[10].x, 3);
+    EXPECT_EQ(reports[10].y, -3);
+    run_for(100);
+    EXPECT_EQ(reports.size(), 11);
+}
+
+TEST_F(MouseMerge, saturates_instead_of_wrapping_around) {
+    for (int i = 0; i < 300; i++) {
+        add(MOUSE_SOURCE_PS2, 127);
+    }
+    run_for(MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].x, 127);
+    EXPECT_TRUE(mouse_merge_pending());
+}
+
+TEST_F(MouseMerge, keeps_buttons_of_each_source) {
+    add(MOUSE_SOURCE_MOUSEKEY, 0, 0, MOUSE_BTN1);
+    run_for(MOUSE_SEND_INTERVAL);
+    add(MOUSE_SOURCE_PS2, 0, 0, MOUSE_BTN1 | MOUSE_BTN2);
+    run_for(MOUSE_SEND_INTERVAL);
+    // mouse keys still hold the first button
+    add(MOUSE_SOURCE_PS2, 0, 0, 0);
+    run_for(MOUSE_SEND_INTERVAL);
+    add(MOUSE_SOURCE_MOUSEKEY, 0, 0, 0);
+    run_for(MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 4);
+    EXPECT_EQ(reports[0].buttons, MOUSE_BTN1);
+    EXPECT_EQ(reports[1].buttons, MOUSE_BTN1 | MOUSE_BTN2);
+    EXPECT_EQ(reports[2].buttons, MOUSE_BTN1);
+    EXPECT_EQ(reports[3].buttons, 0);
+}
+
+TEST_F(MouseMerge, does_not_send_without_changes) {
+    add(MOUSE_SOURCE_PS2, 0, 0, MOUSE_BTN1);
+    run_for(MOUSE_SEND_INTERVAL);
+    add(MOUSE_SOURCE_PS2, 0, 0, MOUSE_BTN1);
+    add(MOUSE_SOURCE_POINTING_DEVICE, 0, 0, 0);
+    run_for(10 * MOUSE_SEND_INTERVAL);
+    EXPECT_EQ(reports.size(), 1);
+}
+
+TEST_F(MouseMerge, a_quick_click_is_not_lost) {
+    add(MOUSE_SOURCE_PS2, 1);
+    mouse_merge_task();
+    add(MOUSE_SOURCE_PS2, 2, 0, MOUSE_BTN1);
+    add(MOUSE_SOURCE_PS2, 0, 0, 0);
+    run_for(MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[1].buttons, MOUSE_BTN1);
+    EXPECT_EQ(reports[1].x, 2);
+    EXPECT_EQ(reports[2].buttons, 0);
+}
+
+// A high resolution sensor reporting every millisecond, mouse keys, and a trackpoint at 100Hz
+TEST_F(MouseMerge, no_motion_is_lost) {
+    srand(1);
+    long added_x = 0, added_y = 0, added_v = 0;
+    for (int ms = 0; ms < 5000; ms++) {
+        int8_t x = rand() % 255 - 127, y = rand() % 255 - 127;
+        add(MOUSE_SOURCE_POINTING_DEVICE, x, y);
+        added_x += x;
+        added_y += y;
+        if (ms % 50 == 0) {
+            add(MOUSE_SOURCE_MOUSEKEY, 50, 0, 0, -1);
+            added_x += 50;
+            added_v -= 1;
+        }
+        if (ms % 10 == 3) {
+            add(MOUSE_SOURCE_PS2, -20, 7);
+            added_x -= 20;
+            added_y += 7;
+        }
+        run_for(1);
+    }
+    run_for(5000);
+    EXPECT_FALSE(mouse_merge_pending());
+    EXPECT_EQ(total(&report_mouse_t::x), added_x);
+    EXPECT_EQ(total(&report_mouse_t::y), added_y);
+    EXPECT_EQ(total(&report_mouse_t::v), added_v);
+    for (size_t i = 1; i < report_times.size(); i++) {
+        EXPECT_GE(report_times[i] - report_times[i - 1], MOUSE_SEND_INTERVAL);
+    }
+    EXPECT_LE(reports.size(), 10000 / MOUSE_SEND_INTERVAL);
+}
@@ -0,0 +1,214 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <cmath>
+extern "C" {
+#include "mousekey.h"
+#include "mouse_merge.h"
+#include "keycode.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+static std::vector<report_mouse_t> reports;
+
+extern "C" void host_mouse_send(report_mouse_t *report) {
+    reports.push_back(*report);
+}
+
+class Mousekey : public testing::Test {
+public:
+    Mousekey() {
+        set_time(1000);
+        mousekey_clear();
+        mouse_merge_clear();
+        reports.clear();
+        mk_delay = MOUSEKEY_DELAY / 10;
+        mk_interval = MOUSEKEY_INTERVAL;
+        mk_max_speed = MOUSEKEY_MAX_SPEED;
+        mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
+        mk_curve = MOUSEKEY_CURVE_LINEAR;
+    }
+
+    void press(uint8_t code) {
+        mousekey_on(code);
+        mousekey_send();
+    }
+
+    void release(uint8_t code) {
+        mousekey_off(code);
+        mousekey_send();
+    }
+
+    void run_for(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            advance_time(1);
+            mousekey_task();
+            mouse_merge_task();
+        }
+    }
+
+    int total_x() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.x;
+        }
+        return total;
+    }
+
+    int total_y() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.y;
+        }
+        return total;
+    }
+
+    // The exact distance after the first press and events repeated events
+    double expected(int events, double (*curve)(double)) {
+        double total = MOUSEKEY_MOVE_DELTA;
+        for (int repeat = 1; repeat <= events; repeat++) {
+            double t = repeat >= mk_time_to_max ? 1.0 : (double)repeat / mk_time_to_max;
+            double speed = MOUSEKEY_MOVE_DELTA * mk_max_speed * curve(t);
+            total += std::min(speed, (double)MOUSEKEY_MOVE_MAX);
+        }
+        return total;
+    }
+
+    // Moves for the delay and events repeated events
+    void move_right(int events) {
+        press(KC_MS_RIGHT);
+        run_for(mk_delay * 10 + (events - 1) * mk_interval);
+    }
+};
+
+static double linear(double t) { return t; }
+static double quadratic(double t) { return t * t; }
+static double kinetic(double t) { return t * t * (3 - 2 * t); }
+
+TEST_F(Mousekey, a_press_moves_right_away) {
+    press(KC_MS_RIGHT);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].x, MOUSEKEY_MOVE_DELTA);
+    EXPECT_EQ(reports[0].y, 0);
+    run_for(mk_delay * 10 - 1);
+    EXPECT_EQ(reports.size(), 1);
+    run_for(1);
+    EXPECT_EQ(reports.size(), 2);
+}
+
+TEST_F(Mousekey, the_linear_curve_keeps_the_fractions) {
+    move_right(30);
+    EXPECT_EQ(reports.size(), 31);
+    EXPECT_NEAR(total_x(), expected(30, linear), 1.0);
+    // The steady speed is reached without rounding
+    EXPECT_EQ(reports.back().x, MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED);
+}
+
+TEST_F(Mousekey, the_quadratic_curve_starts_slower) {
+    mk_curve = MOUSEKEY_CURVE_QUADRATIC;
+    move_right(10);
+    EXPECT_NEAR(total_x(), expected(10, quadratic), 1.0);
+    EXPECT_LT(total_x(), expected(10, linear) - 10);
+    run_for(20 * mk_interval);
+    EXPECT_NEAR(total_x(), expected(30, quadratic), 1.0);
+    EXPECT_EQ(reports.back().x, MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED);
+}
+
+TEST_F(Mousekey, the_kinetic_curve_eases_in_and_out) {
+    mk_curve = MOUSEKEY_CURVE_KINETIC;
+    move_right(30);
+    EXPECT_NEAR(total_x(), expected(30, kinetic), 1.0);
+    EXPECT_EQ(reports.back().x, MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED);
+}
+
+TEST_F(Mousekey, slow_motion_does_not_stall) {
+    mk_curve = MOUSEKEY_CURVE_QUADRATIC;
+    mk_time_to_max = 200;
+    move_right(20);
+    // Under a unit per event at first, but it adds up
+    EXPECT_NEAR(total_x(), expected(20, quadratic), 1.0);
+    EXPECT_GT(total_x(), MOUSEKEY_MOVE_DELTA);
+}
+
+TEST_F(Mousekey, diagonals_keep_the_speed) {
+    press(KC_MS_RIGHT);
+    press(KC_MS_DOWN);
+    run_for(MOUSE_SEND_INTERVAL);
+    reports.clear();
+    run_for(mk_delay * 10 + 99 * mk_interval - MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 100);
+    double distance = (expected(100, linear) - MOUSEKEY_MOVE_DELTA) * 181 / 256;
+    EXPECT_NEAR(total_x(), distance, 2.0);
+    EXPECT_NEAR(total_y(), distance, 2.0);
+}
+
+TEST_F(Mousekey, releasing_stops_the_motion) {
+    move_right(5);
+    release(KC_MS_RIGHT);
+    run_for(MOUSE_SEND_INTERVAL);
+    size_t count = reports.size();
+    run_for(1000);
+    EXPECT_EQ(reports.size(), count);
+}
+
+TEST_F(Mousekey, pointing_device_motion_is_sent_with_the_keys) {
+    press(KC_MS_RIGHT);
+    reports.clear();
+    run_for(mk_delay * 10 - 1);
+    report_mouse_t first = {.buttons = MOUSE_BTN2, .x = 3, .y = -2};
+    report_mouse_t second = {.buttons = MOUSE_BTN2, .x = 4};
+    mouse_merge_add(MOUSE_SOURCE_POINTING_DEVICE, &first);
+    mouse_merge_add(MOUSE_SOURCE_POINTING_DEVICE, &second);
+    run_for(1);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].buttons, MOUSE_BTN2);
+    // 7 from the pointing device and the first repeated event of the keys
+    EXPECT_EQ(reports[0].x, 7 + (int)(expected(1, linear) - MOUSEKEY_MOVE_DELTA));
+    EXPECT_EQ(reports[0].y, -2);
+}
+
+TEST_F(Mousekey, at_most_one_report_per_interval) {
+    report_mouse_t motion = {.x = 1};
+    for (int i = 0; i < 3; i++) {
+        mouse_merge_add(MOUSE_SOURCE_POINTING_DEVICE, &motion);
+        mousekey_task();
+        mouse_merge_task();
+    }
+    EXPECT_EQ(reports.size(), 1);
+    run_for(MOUSE_SEND_INTERVAL - 1);
+    EXPECT_EQ(reports.size(), 1);
+    run_for(1);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(total_x(), 3);
+    run_for(10);
+    EXPECT_EQ(reports.size(), 2);
+}
+
+TEST_F(Mousekey, buttons_are_sent_right_away) {
+    press(KC_MS_BTN1);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].buttons, MOUSE_BTN1);
+    // the release waits for the next interval
+    release(KC_MS_BTN1);
+    EXPECT_EQ(reports.size(), 1);
+    run_for(MOUSE_SEND_INTERVAL);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[1].buttons, 0);
+}
@@ -0,0 +1,44 @@
+deadline_SRC :=\
+	$(TMK_PATH)/common/tests/deadline_tests.cpp \
+	$(TMK_PATH)/common/deadline.c \
+	$(TMK_PATH)/common/test/timer.c
+
+eeconfig_DEFS := -DEECONFIG_SLOTS=4 -DEECONFIG_STORE_ADDR=64 -DBACKLIGHT_ENABLE -DAUDIO_ENABLE -DRGBLIGHT_ENABLE -DSTENO_ENABLE
+eeconfig_SRC :=\
+	$(TMK_PATH)/common/tests/eeconfig_tests.cpp \
+	$(TMK_PATH)/common/eeconfig.c \
+	$(TMK_PATH)/common/deadline.c \
+	$(TMK_PATH)/common/test/eeprom.c \
+	$(TMK_PATH)/common/test/timer.c
+
+eeconfig_single_slot_DEFS := -DEECONFIG_SLOTS=1 -DEECONFIG_STORE_ADDR=16 -DBACKLIGHT_ENABLE
+eeconfig_single_slot_SRC :=\
+	$(TMK_PATH)/common/tests/eeconfig_single_slot_tests.cpp \
+	$(TMK_PATH)/common/eeconfig.c \
+	$(TMK_PATH)/common/deadline.c \
+	$(TMK_PATH)/common/test/eeprom.c \
+	$(TMK_PATH)/common/test/timer.c
+
+idle_DEFS := -DIDLE_SLEEP_ENABLE
+idle_SRC :=\
+	$(TMK_PATH)/common/tests/idle_tests.cpp \
+	$(TMK_PATH)/common/idle.c \
+	$(TMK_PATH)/common/deadline.c \
+	$(TMK_PATH)/common/test/timer.c
+
+mousekey_DEFS := -DNO_PRINT -DNO_DEBUG -DMOUSE_ENABLE
+mousekey_SRC :=\
+	$(TMK_PATH)/common/tests/mousekey_tests.cpp \
+	$(TMK_PATH)/common/mousekey.c \
+	$(TMK_PATH)/common/mouse_merge.c \
+	$(TMK_PATH)/common/test/timer.c
+
+mouse_merge_DEFS := -DMOUSE_ENABLE
+mouse_merge_SRC :=\
+	$(TMK_PATH)/common/tests/mouse_merge_tests.cpp \
+	$(TMK_PATH)/common/mouse_merge.c \
+	$(TMK_PATH)/common/test/timer.c
+
+byte_ring_SRC :=\
+	$(TMK_PATH)/common/tests/byte_ring_tests.cpp \
+	$(TMK_PATH)/common/byte_ring.c
@@ -0,0 +1,8 @@
+TEST_LIST +=\
+	deadline\
+	eeconfig\
+	eeconfig_single_slot\
+	idle\
+	mousekey\
+	mouse_merge\
+	byte_ring
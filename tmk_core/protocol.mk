@@ -15,6 +15,7 @@ endif
 
 ifdef PS2_USE_INT
     SRC += protocol/ps2_interrupt.c
+    SRC += protocol/ps2_engine.c
     SRC += protocol/ps2_io_avr.c
     OPT_DEFS += -DPS2_USE_INT
 endif
@@ -44,6 +44,9 @@
 #ifdef MIDI_ENABLE
 #include "qmk_midi.h"
 #endif
+#ifdef IDLE_SLEEP_ENABLE
+#include "idle.h"
+#endif
 #include "suspend.h"
 #include "wait.h"
 
@@ -200,6 +203,9 @@ int main(void) {
     }
 
     keyboard_task();
+#ifdef MIDI_ENABLE
+    midi_send_queued();
+#endif
 #ifdef CONSOLE_ENABLE
     console_task();
 #endif
@@ -208,6 +214,9 @@ int main(void) {
 #endif
 #ifdef RAW_HID_ENABLE
     raw_hid_task();
+#endif
+#ifdef IDLE_SLEEP_ENABLE
+    idle_task();
 #endif
   }
 }
@@ -860,6 +860,11 @@ void send_midi_packet(MIDI_EventPacket_t* event) {
   chnWrite(&drivers.midi_driver.driver, (uint8_t*)event, sizeof(MIDI_EventPacket_t));
 }
 
+void send_midi_packets(const MIDI_EventPacket_t* events, uint8_t count) {
+  // A single write is only flushed at the next SOF as a whole
+  chnWrite(&drivers.midi_driver.driver, (const uint8_t*)events, count * sizeof(MIDI_EventPacket_t));
+}
+
 bool recv_midi_packet(MIDI_EventPacket_t* const event) {
   size_t size = chnReadTimeout(&drivers.midi_driver.driver, (uint8_t*)event, sizeof(MIDI_EventPacket_t), TIME_IMMEDIATE);
   return size == sizeof(MIDI_EventPacket_t);
@@ -873,6 +878,10 @@ void virtser_send(const uint8_t byte) {
   chnWrite(&drivers.serial_driver.driver, &byte, 1);
 }
 
+void virtser_send_buffer(const uint8_t *data, uint8_t length) {
+  chnWrite(&drivers.serial_driver.driver, data, length);
+}
+
 __attribute__ ((weak))
 void virtser_recv(uint8_t c)
 {
@@ -0,0 +1,467 @@
+#include "adafruit_ble_sdep.h"
+#include <string.h>
+#include "debug.h"
+#include "progmem.h"
+#include "report.h"
+#include "timer.h"
+#include "wait.h"
+#include "ringbuffer.hpp"
+
+// Items that we wish to send
+static RingBuffer<queue_item, 40> send_buf;
+// Pending responses; when the pipeline is full, we can't send any more
+// requests. This records the time at which we sent each command for which
+// we are expecting a response, and whether it is the query. The query has
+// a slot on top of the pipeline.
+struct resp_item {
+  uint16_t sent;
+  bool query;
+};
+static RingBuffer<resp_item, AdafruitBlePipelineDepth + 2> resp_buf;
+
+// The response of the query that is in flight, if any
+static sdep_response_handler_t query_handler;
+static char query_resp[SdepMaxResponse];
+static uint8_t query_resp_len;
+
+// The report that the host will have once the queue is sent
+static uint8_t queued_modifier;
+static uint8_t queued_keys[6];
+
+// Parts of the oldest queued item that were sent before a later part failed
+static uint8_t sent_parts;
+#ifdef MOUSE_ENABLE
+static uint8_t sent_buttons;
+#endif
+
+void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
+                    const uint8_t *payload, uint8_t len, bool moredata) {
+  msg->type = SdepCommand;
+  msg->cmd_low = command & 0xff;
+  msg->cmd_high = command >> 8;
+  msg->len = len;
+  msg->more = (moredata && len == SdepMaxPayload) ? 1 : 0;
+
+  static_assert(sizeof(*msg) == 20, "msg is correctly packed");
+
+  memcpy(msg->payload, payload, len);
+}
+
+bool sdep_send_command(uint16_t command, const uint8_t *payload, uint16_t len,
+                       uint16_t timeout) {
+  struct sdep_msg msg;
+  const uint8_t *end = payload + len;
+
+  while (end - payload > SdepMaxPayload) {
+    sdep_build_pkt(&msg, command, payload, SdepMaxPayload, true);
+    if (!sdep_send_pkt(&msg, timeout)) {
+      return false;
+    }
+    payload += SdepMaxPayload;
+  }
+
+  sdep_build_pkt(&msg, command, payload, end - payload, false);
+  return sdep_send_pkt(&msg, timeout);
+}
+
+uint8_t resp_buf_size(void) {
+  return resp_buf.size();
+}
+
+bool sdep_response_ok(char *resp) {
+  char *dest = resp + strlen(resp);
+
+  // "Parse" the result text; we want to snip off the trailing OK or ERROR line
+  // Rewind past the possible trailing CRLF so that we can strip it
+  while (dest > resp && (dest[-1] == '\n' || dest[-1] == '\r')) {
+    *--dest = 0;
+  }
+
+  // Look back for start of preceeding line
+  char *last_line = strrchr(resp, '\n');
+  if (last_line) {
+    ++last_line;
+  } else {
+    last_line = resp;
+  }
+
+  return !strcmp(last_line, "OK");
+}
+
+// Consumes the oldest entry, and passes the response to the query handler
+// if it was the query
+static void resp_buf_finish(bool ok) {
+  struct resp_item item;
+  resp_buf.get(item);
+  if (item.query) {
+    sdep_response_handler_t handler = query_handler;
+    query_resp[query_resp_len] = 0;
+    query_handler = NULL;
+    query_resp_len = 0;
+    ok = ok && sdep_response_ok(query_resp);
+    handler(query_resp, ok);
+  }
+}
+
+void resp_buf_read_one(bool greedy) {
+  struct resp_item item;
+  if (!resp_buf.peek(item)) {
+    return;
+  }
+
+  if (sdep_recv_ready()) {
+    struct sdep_msg msg;
+
+again:
+    if (sdep_recv_pkt(&msg, SdepTimeout)) {
+      if (item.query && msg.len <= SdepMaxPayload) {
+        uint8_t len = msg.len;
+        if (len > sizeof(query_resp) - 1 - query_resp_len) {
+          len = sizeof(query_resp) - 1 - query_resp_len;
+        }
+        memcpy(query_resp + query_resp_len, msg.payload, len);
+        query_resp_len += len;
+      }
+      if (!msg.more) {
+        // We got it; consume this entry
+        dprintf("recv latency %dms\n", TIMER_DIFF_16(timer_read(), item.sent));
+        resp_buf_finish(msg.type == SdepResponse);
+      }
+
+      if (greedy && resp_buf.peek(item) && sdep_recv_ready()) {
+        goto again;
+      }
+    }
+
+  } else if (timer_elapsed(item.sent) > SdepTimeout * 2) {
+    dprintf("waiting_for_result: timeout, resp_buf size %d\n",
+            (int)resp_buf.size());
+
+    // Timed out: consume this entry
+    query_resp_len = 0;
+    resp_buf_finish(false);
+  }
+}
+
+void resp_buf_wait(const char *cmd) {
+  bool didPrint = false;
+  while (!resp_buf.empty()) {
+    if (!didPrint) {
+      dprintf("wait on buf for %s\n", cmd);
+      didPrint = true;
+    }
+    resp_buf_read_one(true);
+  }
+}
+
+static bool sdep_send_at(const char *cmd, uint16_t len, uint16_t timeout,
+                         bool query) {
+  if (!sdep_send_command(BleAtWrapper, (const uint8_t *)cmd, len, timeout)) {
+    return false;
+  }
+
+  struct resp_item item = { timer_read(), query };
+  auto now = item.sent;
+  while (!resp_buf.enqueue(item)) {
+    resp_buf_read_one(false);
+  }
+  auto later = timer_read();
+  if (TIMER_DIFF_16(later, now) > 0) {
+    dprintf("waited %dms for resp_buf\n", TIMER_DIFF_16(later, now));
+  }
+  return true;
+}
+
+bool sdep_send_at_async(const char *cmd, uint16_t len, uint16_t timeout) {
+  return sdep_send_at(cmd, len, timeout, false);
+}
+
+bool sdep_send_query(const char *cmd, uint16_t len, uint16_t timeout,
+                     sdep_response_handler_t handler) {
+  if (query_handler) {
+    return false;
+  }
+  if (!sdep_send_at(cmd, len, timeout, true)) {
+    return false;
+  }
+  query_handler = handler;
+  return true;
+}
+
+bool sdep_query_pending(void) {
+  return query_handler != NULL;
+}
+
+static const char kHexDigits[] PROGMEM = "0123456789abcdef";
+static const char kKeyboardCode[] PROGMEM = "AT+BLEKEYBOARDCODE=";
+static const char kControlKey[] PROGMEM = "AT+BLEHIDCONTROLKEY=0x";
+#ifdef MOUSE_ENABLE
+static const char kMouseMove[] PROGMEM = "AT+BLEHIDMOUSEMOVE=";
+static const char kMouseButton[] PROGMEM = "AT+BLEHIDMOUSEBUTTON=";
+#endif
+
+static char *put_P(char *dest, const char *src) {
+  char c;
+  while ((c = pgm_read_byte(src++))) {
+    *dest++ = c;
+  }
+  return dest;
+}
+
+static char *put_hex(char *dest, uint8_t value) {
+  *dest++ = pgm_read_byte(&kHexDigits[value >> 4]);
+  *dest++ = pgm_read_byte(&kHexDigits[value & 0xf]);
+  return dest;
+}
+
+#ifdef MOUSE_ENABLE
+static char *put_decimal(char *dest, int8_t value) {
+  uint8_t magnitude = value < 0 ? -value : value;
+  if (value < 0) {
+    *dest++ = '-';
+  }
+  if (magnitude >= 100) {
+    *dest++ = '0' + magnitude / 100;
+  }
+  if (magnitude >= 10) {
+    *dest++ = '0' + magnitude / 10 % 10;
+  }
+  *dest++ = '0' + magnitude % 10;
+  return dest;
+}
+#endif
+
+uint8_t ble_format_item(const struct queue_item *item, uint8_t part, char *buf) {
+  char *p = buf;
+
+  *p = 0;
+
+  switch (item->queue_type) {
+    case QTKeyReport: {
+      if (part > 0) {
+        return 0;
+      }
+      // Keys after the last one that is down can be left out, which
+      // keeps most reports to two SDEP packets instead of four
+      uint8_t nkeys = 6;
+      while (nkeys > 0 && item->key.keys[nkeys - 1] == 0) {
+        --nkeys;
+      }
+      p = put_P(p, kKeyboardCode);
+      p = put_hex(p, item->key.modifier);
+      *p++ = '-';
+      p = put_hex(p, 0);
+      for (uint8_t i = 0; i < nkeys; ++i) {
+        *p++ = '-';
+        p = put_hex(p, item->key.keys[i]);
+      }
+      break;
+    }
+
+    case QTConsumer:
+      if (part > 0) {
+        return 0;
+      }
+      p = put_P(p, kControlKey);
+      p = put_hex(p, item->consumer >> 8);
+      p = put_hex(p, item->consumer & 0xff);
+      break;
+
+#ifdef MOUSE_ENABLE
+    case QTMouseMove:
+      if (part == 0) {
+        if (!item->mousemove.x && !item->mousemove.y &&
+            !item->mousemove.scroll && !item->mousemove.pan) {
+          return 0;
+        }
+        p = put_P(p, kMouseMove);
+        p = put_decimal(p, item->mousemove.x);
+        *p++ = ',';
+        p = put_decimal(p, item->mousemove.y);
+        *p++ = ',';
+        p = put_decimal(p, item->mousemove.scroll);
+        *p++ = ',';
+        p = put_decimal(p, item->mousemove.pan);
+      } else if (part == 1) {
+        p = put_P(p, kMouseButton);
+        if (item->mousemove.buttons & MOUSE_BTN1) {
+          *p++ = 'L';
+        }
+        if (item->mousemove.buttons & MOUSE_BTN2) {
+          *p++ = 'R';
+        }
+        if (item->mousemove.buttons & MOUSE_BTN3) {
+          *p++ = 'M';
+        }
+        if (item->mousemove.buttons == 0) {
+          *p++ = '0';
+        }
+      } else {
+        return 0;
+      }
+      break;
+#endif
+
+    default:
+      return 0;
+  }
+
+  *p = 0;
+  return p - buf;
+}
+
+// Whether every key and modifier of the report a is also down in b
+static bool keys_subset(uint8_t a_modifier, const uint8_t *a_keys,
+                        uint8_t b_modifier, const uint8_t *b_keys) {
+  if (a_modifier & ~b_modifier) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 6; ++i) {
+    if (a_keys[i] && !memchr(b_keys, a_keys[i], 6)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Merges the report into the last queued item, if that is still waiting to
+// be sent and the host would see the same presses either way
+static bool send_buf_merge(const struct queue_item *item) {
+  if (send_buf.empty() || (sent_parts && send_buf.size() == 1)) {
+    return false;
+  }
+  struct queue_item &last = send_buf.back();
+  if (last.queue_type != item->queue_type) {
+    return false;
+  }
+
+  switch (item->queue_type) {
+    case QTKeyReport:
+      // Releases can go out together, the order of presses has to be kept
+      if (!last.key.releases_only ||
+          !keys_subset(item->key.modifier, item->key.keys,
+                       last.key.modifier, last.key.keys)) {
+        return false;
+      }
+      last.key.modifier = item->key.modifier;
+      memcpy(last.key.keys, item->key.keys, sizeof(last.key.keys));
+      return true;
+
+    case QTConsumer:
+      return last.consumer == item->consumer;
+
+#ifdef MOUSE_ENABLE
+    case QTMouseMove: {
+      if (last.mousemove.buttons != item->mousemove.buttons) {
+        return false;
+      }
+      int16_t x = last.mousemove.x + item->mousemove.x;
+      int16_t y = last.mousemove.y + item->mousemove.y;
+      int16_t scroll = last.mousemove.scroll + item->mousemove.scroll;
+      int16_t pan = last.mousemove.pan + item->mousemove.pan;
+      if (x < -127 || x > 127 || y < -127 || y > 127 ||
+          scroll < -127 || scroll > 127 || pan < -127 || pan > 127) {
+        return false;
+      }
+      last.mousemove.x = x;
+      last.mousemove.y = y;
+      last.mousemove.scroll = scroll;
+      last.mousemove.pan = pan;
+      return true;
+    }
+#endif
+
+    default:
+      return false;
+  }
+}
+
+bool send_buf_enqueue(const struct queue_item *item) {
+  struct queue_item queued = *item;
+
+  if (queued.queue_type == QTKeyReport) {
+    if (queued.key.modifier == queued_modifier &&
+        !memcmp(queued.key.keys, queued_keys, sizeof(queued_keys))) {
+      // The host already has (or will have) this report
+      return true;
+    }
+    queued.key.releases_only =
+        keys_subset(queued.key.modifier, queued.key.keys, queued_modifier,
+                    queued_keys);
+  }
+
+  if (!send_buf_merge(&queued) && !send_buf.enqueue(queued)) {
+    return false;
+  }
+
+  if (queued.queue_type == QTKeyReport) {
+    queued_modifier = queued.key.modifier;
+    memcpy(queued_keys, queued.key.keys, sizeof(queued_keys));
+  }
+  return true;
+}
+
+uint8_t send_buf_size(void) {
+  return send_buf.size();
+}
+
+static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
+  char cmd[BleMaxReportCommand];
+
+  if (TIMER_DIFF_16(timer_read(), item->added) > 0) {
+    dprintf("send latency %dms\n", TIMER_DIFF_16(timer_read(), item->added));
+  }
+
+  for (uint8_t part = 0; part < 2; ++part) {
+    if (sent_parts & (1 << part)) {
+      continue;
+    }
+#ifdef MOUSE_ENABLE
+    // The module remembers the buttons, only send them when they change
+    if (item->queue_type == QTMouseMove && part == 1 &&
+        item->mousemove.buttons == sent_buttons) {
+      continue;
+    }
+#endif
+    uint8_t len = ble_format_item(item, part, cmd);
+    if (len == 0) {
+      continue;
+    }
+    if (!sdep_send_at_async(cmd, len, timeout)) {
+      return false;
+    }
+    sent_parts |= 1 << part;
+#ifdef MOUSE_ENABLE
+    if (item->queue_type == QTMouseMove && part == 1) {
+      sent_buttons = item->mousemove.buttons;
+    }
+#endif
+  }
+  return true;
+}
+
+bool send_buf_send_one(uint16_t timeout) {
+  struct queue_item item;
+
+  // Don't send anything more until the module catches up with the reports,
+  // a query in flight doesn't hold them up
+  if (resp_buf.size() - sdep_query_pending() >= AdafruitBlePipelineDepth) {
+    return false;
+  }
+
+  if (!send_buf.peek(item)) {
+    return false;
+  }
+  if (process_queue_item(&item, timeout)) {
+    // commit that peek
+    send_buf.get(item);
+    sent_parts = 0;
+    dprintf("send_buf_send_one: have %d remaining\n", (int)send_buf.size());
+    return true;
+  }
+
+  dprint("failed to send, will retry\n");
+  wait_ms(SdepTimeout);
+  resp_buf_read_one(true);
+  return false;
+}
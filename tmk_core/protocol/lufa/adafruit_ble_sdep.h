@@ -0,0 +1,142 @@
+/* SDEP transport and report queue for the Adafruit BLE module.
+ * Author: Wez Furlong, 2016
+ * This is the part of the driver that doesn't touch the hardware, so that
+ * it can also be run against a fake module in the tests.
+ */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Commands are encoded using SDEP and sent via SPI
+// https://github.com/adafruit/Adafruit_BluefruitLE_nRF51/blob/master/SDEP.md
+
+#define SdepMaxPayload 16
+struct sdep_msg {
+  uint8_t type;
+  uint8_t cmd_low;
+  uint8_t cmd_high;
+  struct __attribute__((packed)) {
+    uint8_t len:7;
+    uint8_t more:1;
+  };
+  uint8_t payload[SdepMaxPayload];
+} __attribute__((packed));
+
+enum sdep_type {
+  SdepCommand = 0x10,
+  SdepResponse = 0x20,
+  SdepAlert = 0x40,
+  SdepError = 0x80,
+  SdepSlaveNotReady = 0xfe, // Try again later
+  SdepSlaveOverflow = 0xff, // You read more data than is available
+};
+
+enum ble_cmd {
+  BleInitialize = 0xbeef,
+  BleAtWrapper = 0x0a00,
+  BleUartTx = 0x0a01,
+  BleUartRx = 0x0a02,
+};
+
+#define SdepTimeout 150 /* milliseconds */
+#define SdepShortTimeout 10 /* milliseconds */
+
+// How many reports may be sent before the module has answered the first
+// of them. By default every response is waited for. Larger values save a
+// SPI round trip per report, but rely on the module buffering commands while
+// it works on the one before, which hasn't been verified on hardware yet.
+// A query has a slot of its own on top of these, so that a report never
+// waits behind a connection or battery check.
+#ifndef AdafruitBlePipelineDepth
+#define AdafruitBlePipelineDepth 1
+#endif
+
+// The longest AT command that a queued report turns into
+#define BleMaxReportCommand 48
+
+// The recv latency is relatively high, so when we're hammering keys quickly,
+// we want to avoid waiting for the responses in the matrix loop.  We maintain
+// a short queue for that.  Since there is quite a lot of space overhead for
+// the AT command representation wrapped up in SDEP, we queue the minimal
+// information here.
+
+enum queue_type {
+  QTKeyReport, // 1-byte modifier + 6-byte key report
+  QTConsumer,  // 16-bit key code
+#ifdef MOUSE_ENABLE
+  QTMouseMove, // 4-byte mouse report
+#endif
+};
+
+struct queue_item {
+  enum queue_type queue_type;
+  uint16_t added;
+  union __attribute__((packed)) {
+    struct __attribute__((packed)) {
+      uint8_t modifier;
+      uint8_t keys[6];
+      // Only releases keys of the report queued before it
+      bool releases_only;
+    } key;
+
+    uint16_t consumer;
+    struct __attribute__((packed)) {
+      int8_t x, y, scroll, pan;
+      uint8_t buttons;
+    } mousemove;
+  };
+};
+
+// Provided by the hardware driver: send or receive a single SDEP packet,
+// and check if the module has a packet for us
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout);
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout);
+bool sdep_recv_ready(void);
+
+void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
+                    const uint8_t *payload, uint8_t len, bool moredata);
+// Fragments a command into as many SDEP packets as it needs
+bool sdep_send_command(uint16_t command, const uint8_t *payload, uint16_t len,
+                       uint16_t timeout);
+// Sends an AT command whose response is only counted, not read, so that
+// it doesn't hold up the commands after it
+bool sdep_send_at_async(const char *cmd, uint16_t len, uint16_t timeout);
+
+// The longest query response that is kept, longer ones are cut off
+#define SdepMaxResponse 48
+
+// Called with the response text of a query, and whether it ended in OK.
+// When the module doesn't answer in time, ok is false and resp is empty.
+typedef void (*sdep_response_handler_t)(char *resp, bool ok);
+
+// Sends an AT command without waiting for its response, which is passed
+// to the handler once it comes in. Reports are still sent while the query
+// is in flight, it doesn't take up their pipeline. There can only be one
+// query at a time, returns false if one is still in flight or the command
+// couldn't be sent.
+bool sdep_send_query(const char *cmd, uint16_t len, uint16_t timeout,
+                     sdep_response_handler_t handler);
+bool sdep_query_pending(void);
+// Strips the trailing line breaks off a response, and checks that its last
+// line is OK
+bool sdep_response_ok(char *resp);
+
+// Number of commands sent without reading their response yet
+uint8_t resp_buf_size(void);
+// Reads one response, or all that are ready if greedy
+void resp_buf_read_one(bool greedy);
+// Waits until all responses are read
+void resp_buf_wait(const char *cmd);
+
+// Writes the AT command for one part of a queued report into buf, which
+// must hold BleMaxReportCommand characters. Mouse reports have two parts,
+// the motion and the buttons. Returns the length, 0 when there is no such part.
+uint8_t ble_format_item(const struct queue_item *item, uint8_t part, char *buf);
+
+// Queues a report, merging it into the last queued report when no key
+// press or movement is lost by that. Returns false if the queue is full.
+bool send_buf_enqueue(const struct queue_item *item);
+// Sends the oldest report if the pipeline has room for it, returns true
+// if something was sent
+bool send_buf_send_one(uint16_t timeout = SdepTimeout);
+uint8_t send_buf_size(void);
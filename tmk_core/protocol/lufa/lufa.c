@@ -44,6 +44,7 @@
 #include "led.h"
 #include "sendchar.h"
 #include "debug.h"
+#include "byte_ring.h"
 #ifdef SLEEP_LED_ENABLE
 #include "sleep_led.h"
 #endif
@@ -78,6 +79,10 @@
     #include "virtser.h"
 #endif
 
+#ifdef IDLE_SLEEP_ENABLE
+    #include "idle.h"
+#endif
+
 #if (defined(RGB_MIDI) | defined(RGBLIGHT_ANIMATIONS)) & defined(RGBLIGHT_ENABLE)
     #include "rgblight.h"
 #endif
@@ -230,9 +235,23 @@ static void raw_hid_task(void)
  * Console
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
+#ifndef CONSOLE_BUFFER_SIZE
+    #define CONSOLE_BUFFER_SIZE 128
+#elif CONSOLE_BUFFER_SIZE > 255
+    #error CONSOLE_BUFFER_SIZE needs to be smaller than 256
+#endif
+
+/* output of sendchar(), the oldest is dropped when more is printed than the host reads */
+static uint8_t console_data[CONSOLE_BUFFER_SIZE];
+byte_ring_t console_buffer = BYTE_RING(console_data);
+
+/* set every frame, so that a partly filled packet is sent at most once per frame */
+static volatile bool console_flush = false;
+
 /** \brief Console Task
  *
- * FIXME: Needs doc
+ * Writes the output buffered by sendchar() to the console endpoint, whole packets
+ * as soon as the bank is free and the rest once per frame. Called from the main loop.
  */
 static void Console_Task(void)
 {
@@ -240,6 +259,9 @@ static void Console_Task(void)
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+    if (!byte_ring_count(&console_buffer))
+        return;
+
     uint8_t ep = Endpoint_GetCurrentEndpoint();
 
 #if 0
@@ -274,13 +296,13 @@ static void Console_Task(void)
         return;
     }
 
-    // fill empty bank
-    while (Endpoint_IsReadWriteAllowed())
-        Endpoint_Write_8(0);
-
-    // flash senchar packet
-    if (Endpoint_IsINReady()) {
+    while (Endpoint_IsINReady() && (byte_ring_count(&console_buffer) >= CONSOLE_EPSIZE || console_flush)) {
+        // the rest of a partly filled packet is padded with zeros
+        uint8_t data[CONSOLE_EPSIZE] = {0};
+        byte_ring_read(&console_buffer, data, sizeof(data));
+        Endpoint_Write_Stream_LE(data, sizeof(data), NULL);
         Endpoint_ClearIN();
+        console_flush = false;
     }
 
     Endpoint_SelectEndpoint(ep);
@@ -371,27 +393,14 @@ void EVENT_USB_Device_WakeUp()
 
 
 #ifdef CONSOLE_ENABLE
-static bool console_flush = false;
-#define CONSOLE_FLUSH_SET(b)   do { \
-  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {\
-    console_flush = b; \
-  } \
-} while (0)
-
 /** \brief Event USB Device Start Of Frame
  *
- * FIXME: Needs doc
+ * Lets Console_Task() send a partly filled packet.
  * called every 1ms
  */
 void EVENT_USB_Device_StartOfFrame(void)
 {
-    static uint8_t count;
-    if (++count % 50) return;
-    count = 0;
-
-    if (!console_flush) return;
-    Console_Task();
-    console_flush = false;
+    console_flush = true;
 }
 
 #endif
@@ -800,66 +809,15 @@ static void send_consumer(uint16_t data)
  * sendchar
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
-#define SEND_TIMEOUT 5
 /** \brief Send Char
  *
- * FIXME: Needs doc
+ * Only buffers the char, Console_Task() sends it. Never waits for the host,
+ * the oldest output is dropped instead when the buffer is full.
  */
 int8_t sendchar(uint8_t c)
 {
-    // Not wait once timeouted.
-    // Because sendchar() is called so many times, waiting each call causes big lag.
-    static bool timeouted = false;
-
-    // prevents Console_Task() from running during sendchar() runs.
-    // or char will be lost. These two function is mutually exclusive.
-    CONSOLE_FLUSH_SET(false);
-
-    if (USB_DeviceState != DEVICE_STATE_Configured)
-        return -1;
-
-    uint8_t ep = Endpoint_GetCurrentEndpoint();
-    Endpoint_SelectEndpoint(CONSOLE_IN_EPNUM);
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        goto ERROR_EXIT;
-    }
-
-    if (timeouted && !Endpoint_IsReadWriteAllowed()) {
-        goto ERROR_EXIT;
-    }
-
-    timeouted = false;
-
-    uint8_t timeout = SEND_TIMEOUT;
-    while (!Endpoint_IsReadWriteAllowed()) {
-        if (USB_DeviceState != DEVICE_STATE_Configured) {
-            goto ERROR_EXIT;
-        }
-        if (Endpoint_IsStalled()) {
-            goto ERROR_EXIT;
-        }
-        if (!(timeout--)) {
-            timeouted = true;
-            goto ERROR_EXIT;
-        }
-        _delay_ms(1);
-    }
-
-    Endpoint_Write_8(c);
-
-    // send when bank is full
-    if (!Endpoint_IsReadWriteAllowed()) {
-        while (!(Endpoint_IsINReady()));
-        Endpoint_ClearIN();
-    } else {
-        CONSOLE_FLUSH_SET(true);
-    }
-
-    Endpoint_SelectEndpoint(ep);
+    byte_ring_put(&console_buffer, c);
     return 0;
-ERROR_EXIT:
-    Endpoint_SelectEndpoint(ep);
-    return -1;
 }
 #else
 int8_t sendchar(uint8_t c)
@@ -897,6 +855,16 @@ void send_midi_packet(MIDI_EventPacket_t* event) {
   MIDI_Device_SendEventPacket(&USB_MIDI_Interface, event);
 }
 
+void send_midi_packets(const MIDI_EventPacket_t* events, uint8_t count) {
+  if (USB_DeviceState != DEVICE_STATE_Configured)
+    return;
+
+  Endpoint_SelectEndpoint(MIDI_STREAM_IN_EPADDR);
+  if (Endpoint_Write_Stream_LE(events, count * sizeof(MIDI_EventPacket_t), NULL) != ENDPOINT_RWSTREAM_NoError)
+    return;
+  Endpoint_ClearIN();
+}
+
 bool recv_midi_packet(MIDI_EventPacket_t* const event) {
   return MIDI_Device_ReceiveEventPacket(&USB_MIDI_Interface, event);
 }
@@ -928,9 +896,22 @@ void virtser_recv(uint8_t c)
   // Ignore by default
 }
 
+#ifndef VIRTSER_BUFFER_SIZE
+    #define VIRTSER_BUFFER_SIZE 64
+#elif VIRTSER_BUFFER_SIZE > 255
+    #error VIRTSER_BUFFER_SIZE needs to be smaller than 256
+#endif
+
+/* output of virtser_send(), a whole chord is dropped when it doesn't fit */
+static uint8_t virtser_data[VIRTSER_BUFFER_SIZE];
+static byte_ring_t virtser_buffer = BYTE_RING(virtser_data);
+static bool virtser_zlp = false;
+
 /** \brief Virtual Serial Task
  *
- * FIXME: Needs doc
+ * Passes received bytes to virtser_recv(), and writes the output buffered by
+ * virtser_send() to the CDC endpoint, as much as fits in a packet whenever the
+ * bank is free. Called from the main loop.
  */
 void virtser_task(void)
 {
@@ -941,36 +922,57 @@ void virtser_task(void)
     ch = CDC_Device_ReceiveByte(&cdc_device);
     virtser_recv(ch);
   }
+
+  if (!byte_ring_count(&virtser_buffer) && !virtser_zlp)
+    return;
+
+  if (!(cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)) {
+    // The port was closed, nobody is reading the rest
+    byte_ring_clear(&virtser_buffer);
+    virtser_zlp = false;
+    return;
+  }
+
+  uint8_t ep = Endpoint_GetCurrentEndpoint();
+
+  /* IN packet */
+  Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
+  if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
+      Endpoint_SelectEndpoint(ep);
+      return;
+  }
+
+  while (Endpoint_IsINReady() && (byte_ring_count(&virtser_buffer) || virtser_zlp)) {
+    uint8_t data[CDC_EPSIZE];
+    uint8_t length = byte_ring_read(&virtser_buffer, data, sizeof(data));
+    Endpoint_Write_Stream_LE(data, length, NULL);
+    Endpoint_ClearIN();
+    // A full packet doesn't end the transfer, the host waits for a shorter one
+    virtser_zlp = length == sizeof(data);
+  }
+
+  Endpoint_SelectEndpoint(ep);
 }
+
 /** \brief Virtual Serial Send
  *
- * FIXME: Needs doc
+ * Only buffers the byte, virtser_task() sends it.
  */
 void virtser_send(const uint8_t byte)
 {
-  uint8_t timeout = 255;
-  uint8_t ep = Endpoint_GetCurrentEndpoint();
+  virtser_send_buffer(&byte, 1);
+}
 
+/** \brief Virtual Serial Send Buffer
+ *
+ * Buffers the bytes to be sent together by virtser_task(). Output is dropped
+ * while no program on the host has the port open.
+ */
+void virtser_send_buffer(const uint8_t *data, uint8_t length)
+{
   if (cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)
   {
-    /* IN packet */
-    Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
-
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        Endpoint_SelectEndpoint(ep);
-        return;
-    }
-
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-
-    Endpoint_Write_8(byte);
-    CDC_Device_Flush(&cdc_device);
-
-    if (Endpoint_IsINReady()) {
-      Endpoint_ClearIN();
-    }
-
-    Endpoint_SelectEndpoint(ep);
+    byte_ring_write(&virtser_buffer, data, length);
   }
 }
 #endif
@@ -1071,6 +1073,7 @@ int main(void)
         keyboard_task();
 
 #ifdef MIDI_ENABLE
+        midi_send_queued();
         MIDI_Device_USBTask(&USB_MIDI_Interface);
 #endif
 
@@ -1091,10 +1094,17 @@ int main(void)
         raw_hid_task();
 #endif
 
+#ifdef CONSOLE_ENABLE
+        Console_Task();
+#endif
+
 #if !defined(INTERRUPT_CONTROL_ENDPOINT)
         USB_USBTask();
 #endif
 
+#ifdef IDLE_SLEEP_ENABLE
+        idle_task();
+#endif
     }
 }
 
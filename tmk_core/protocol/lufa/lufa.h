@@ -48,11 +48,16 @@
 #include <LUFA/Version.h>
 #include <LUFA/Drivers/USB/USB.h>
 #include "host.h"
+#include "byte_ring.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 extern host_driver_t lufa_driver;
+#ifdef CONSOLE_ENABLE
+/* console_buffer.dropped counts the output lost because the host didn't read it in time */
+extern byte_ring_t console_buffer;
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,388 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string.h>
+#include "adafruit_ble_sdep.h"
+extern "C" {
+#include "timer.h"
+#include "report.h"
+void advance_time(uint32_t ms);
+}
+
+struct fake_response {
+    uint32_t ready;
+    std::string text;
+};
+
+// A fake module, which answers each AT command after a delay, with an OK
+// unless it has another answer for it. It takes any number of commands before
+// answering the first, so the pipelined tests only check the driver's side of it.
+struct fake_module {
+    std::string command;
+    std::vector<std::string> commands;
+    std::map<std::string, std::string> answers;
+    std::deque<fake_response> responses;
+    uint32_t latency;
+    uint32_t bytes_out;
+    uint32_t bytes_in;
+    uint32_t packets_out;
+};
+
+static fake_module module;
+
+bool sdep_send_pkt(const struct sdep_msg* msg, uint16_t timeout) {
+    EXPECT_EQ(msg->type, SdepCommand);
+    EXPECT_EQ(msg->cmd_low | msg->cmd_high << 8, BleAtWrapper);
+    module.packets_out++;
+    module.bytes_out += 4 + msg->len;
+    module.command.append((const char*)msg->payload, msg->len);
+    if (!msg->more) {
+        auto answer = module.answers.find(module.command);
+        std::string text = answer != module.answers.end() ? answer->second : "OK\r\n";
+        module.commands.push_back(module.command);
+        module.command.clear();
+        module.responses.push_back({timer_read32() + module.latency, text});
+    }
+    return true;
+}
+
+bool sdep_recv_ready(void) {
+    return !module.responses.empty() && module.responses.front().ready <= timer_read32();
+}
+
+bool sdep_recv_pkt(struct sdep_msg* msg, uint16_t timeout) {
+    EXPECT_TRUE(sdep_recv_ready());
+    fake_response& response = module.responses.front();
+    msg->type = SdepResponse;
+    msg->cmd_low = BleAtWrapper & 0xff;
+    msg->cmd_high = BleAtWrapper >> 8;
+    msg->len = std::min<size_t>(response.text.size(), SdepMaxPayload);
+    msg->more = msg->len < response.text.size();
+    memcpy(msg->payload, response.text.data(), msg->len);
+    response.text.erase(0, msg->len);
+    if (!msg->more) {
+        module.responses.pop_front();
+    }
+    module.bytes_in += 4 + msg->len;
+    return true;
+}
+
+class AdafruitBle : public testing::Test {
+public:
+    AdafruitBle() {
+        // Let the module catch up, and leave the host with all keys up
+        module.latency = 0;
+        queue_item item = key_report(0, {});
+        send_buf_enqueue(&item);
+        drain();
+        module = fake_module();
+        module.latency = 5;
+    }
+
+    // The last response passed to the query handler
+    static std::string query_resp;
+    static int query_result;
+
+    static void query_done(char* resp, bool ok) {
+        query_resp = resp;
+        query_result = ok;
+    }
+
+    void send_query(const char* cmd) {
+        query_resp.clear();
+        query_result = -1;
+        EXPECT_TRUE(sdep_send_query(cmd, strlen(cmd), SdepShortTimeout, query_done));
+    }
+
+    queue_item key_report(uint8_t modifier, std::vector<uint8_t> keys) {
+        queue_item item = {};
+        item.queue_type = QTKeyReport;
+        item.added = timer_read();
+        item.key.modifier = modifier;
+        for (size_t i = 0; i < keys.size(); i++) {
+            item.key.keys[i] = keys[i];
+        }
+        return item;
+    }
+
+    queue_item mouse_report(int8_t x, int8_t y, uint8_t buttons) {
+        queue_item item = {};
+        item.queue_type = QTMouseMove;
+        item.added = timer_read();
+        item.mousemove.x = x;
+        item.mousemove.y = y;
+        item.mousemove.buttons = buttons;
+        return item;
+    }
+
+    void enqueue(queue_item item) {
+        EXPECT_TRUE(send_buf_enqueue(&item));
+    }
+
+    // Runs the BLE task once a millisecond until everything is sent and answered
+    uint32_t drain() {
+        uint32_t start = timer_read32();
+        while (send_buf_size() || resp_buf_size()) {
+            resp_buf_read_one(true);
+            send_buf_send_one(SdepShortTimeout);
+            advance_time(1);
+        }
+        return timer_read32() - start;
+    }
+
+    std::string format(const queue_item& item, uint8_t part = 0) {
+        char buf[BleMaxReportCommand];
+        uint8_t len = ble_format_item(&item, part, buf);
+        EXPECT_EQ(len, strlen(buf));
+        EXPECT_LT(len, BleMaxReportCommand);
+        return std::string(buf, len);
+    }
+};
+
+std::string AdafruitBle::query_resp;
+int AdafruitBle::query_result;
+
+TEST_F(AdafruitBle, KeyReportsLeaveOutTrailingKeys) {
+    EXPECT_EQ(format(key_report(0x02, {0x04})), "AT+BLEKEYBOARDCODE=02-00-04");
+    EXPECT_EQ(format(key_report(0, {})), "AT+BLEKEYBOARDCODE=00-00");
+    EXPECT_EQ(format(key_report(0, {0, 0x1e})), "AT+BLEKEYBOARDCODE=00-00-00-1e");
+    EXPECT_EQ(format(key_report(0xff, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff})),
+        "AT+BLEKEYBOARDCODE=ff-00-ff-ff-ff-ff-ff-ff");
+    EXPECT_EQ(format(key_report(0, {0x04}), 1), "");
+}
+
+TEST_F(AdafruitBle, ConsumerAndMouseReports) {
+    queue_item item = {};
+    item.queue_type = QTConsumer;
+    item.consumer = 0xe9;
+    EXPECT_EQ(format(item), "AT+BLEHIDCONTROLKEY=0x00e9");
+
+    item = mouse_report(-128, 127, MOUSE_BTN1 | MOUSE_BTN2);
+    item.mousemove.scroll = -5;
+    EXPECT_EQ(format(item, 0), "AT+BLEHIDMOUSEMOVE=-128,127,-5,0");
+    EXPECT_EQ(format(item, 1), "AT+BLEHIDMOUSEBUTTON=LR");
+    EXPECT_EQ(format(mouse_report(0, 0, 0), 0), "");
+    EXPECT_EQ(format(mouse_report(0, 0, 0), 1), "AT+BLEHIDMOUSEBUTTON=0");
+}
+
+TEST_F(AdafruitBle, PressesAreSentInOrder) {
+    enqueue(key_report(0, {0x04}));
+    enqueue(key_report(0, {0x04, 0x05}));
+    drain();
+    std::vector<std::string> expected = {
+        "AT+BLEKEYBOARDCODE=00-00-04",
+        "AT+BLEKEYBOARDCODE=00-00-04-05",
+    };
+    EXPECT_EQ(module.commands, expected);
+}
+
+TEST_F(AdafruitBle, ReleasesAreMerged) {
+    enqueue(key_report(0, {0x04}));
+    enqueue(key_report(0, {0x04, 0x05}));
+    enqueue(key_report(0, {0, 0x05}));
+    enqueue(key_report(0, {}));
+    drain();
+    std::vector<std::string> expected = {
+        "AT+BLEKEYBOARDCODE=00-00-04",
+        "AT+BLEKEYBOARDCODE=00-00-04-05",
+        "AT+BLEKEYBOARDCODE=00-00",
+    };
+    EXPECT_EQ(module.commands, expected);
+}
+
+TEST_F(AdafruitBle, ReleaseThenPressIsNotMerged) {
+    enqueue(key_report(0, {0x04}));
+    enqueue(key_report(0, {}));
+    enqueue(key_report(0, {0x04}));
+    enqueue(key_report(0, {}));
+    drain();
+    EXPECT_EQ(module.commands.size(), 4);
+}
+
+TEST_F(AdafruitBle, RepeatedReportsAreDropped) {
+    enqueue(key_report(0x02, {0x04}));
+    enqueue(key_report(0x02, {0x04}));
+    drain();
+    enqueue(key_report(0x02, {0x04}));
+    drain();
+    EXPECT_EQ(module.commands.size(), 1);
+}
+
+TEST_F(AdafruitBle, MouseMotionIsMerged) {
+    enqueue(mouse_report(10, -3, 0));
+    enqueue(mouse_report(10, -3, 0));
+    enqueue(mouse_report(0, 0, MOUSE_BTN1));
+    enqueue(mouse_report(0, 0, 0));
+    drain();
+    std::vector<std::string> expected = {
+        "AT+BLEHIDMOUSEMOVE=20,-6,0,0",
+        "AT+BLEHIDMOUSEBUTTON=L",
+        "AT+BLEHIDMOUSEBUTTON=0",
+    };
+    EXPECT_EQ(module.commands, expected);
+}
+
+TEST_F(AdafruitBle, MouseMotionIsNotMergedPastItsRange) {
+    enqueue(mouse_report(100, 0, 0));
+    enqueue(mouse_report(100, 0, 0));
+    drain();
+    EXPECT_EQ(module.commands.size(), 2);
+}
+
+TEST_F(AdafruitBle, CommandsArePipelined) {
+    for (uint8_t i = 0; i < AdafruitBlePipelineDepth + 1; i++) {
+        enqueue(key_report(0, {(uint8_t)(0x04 + i)}));
+    }
+    for (uint8_t i = 0; i < AdafruitBlePipelineDepth; i++) {
+        EXPECT_TRUE(send_buf_send_one(SdepShortTimeout));
+    }
+    EXPECT_EQ(module.commands.size(), AdafruitBlePipelineDepth);
+    // The pipeline is full until the module answers
+    EXPECT_FALSE(send_buf_send_one(SdepShortTimeout));
+    advance_time(module.latency);
+    resp_buf_read_one(true);
+    EXPECT_TRUE(send_buf_send_one(SdepShortTimeout));
+    drain();
+}
+
+TEST_F(AdafruitBle, QueryResponsesGoToTheirHandler) {
+    module.answers["AT+GAPGETCONN"] = "1\r\nOK\r\n";
+    send_query("AT+GAPGETCONN");
+    EXPECT_TRUE(sdep_query_pending());
+    drain();
+    EXPECT_FALSE(sdep_query_pending());
+    EXPECT_EQ(query_result, 1);
+    EXPECT_EQ(query_resp, "1\r\nOK");
+
+    module.answers["AT+HWVBAT"] = "ERROR\r\n";
+    send_query("AT+HWVBAT");
+    drain();
+    EXPECT_EQ(query_result, 0);
+}
+
+TEST_F(AdafruitBle, LongQueryResponsesAreJoined) {
+    module.answers["ATI"] = "BLEFRIEND32\r\nnRF51822 QFACA10\r\n0.7.7\r\nOK\r\n";
+    send_query("ATI");
+    drain();
+    EXPECT_EQ(query_result, 1);
+    EXPECT_EQ(query_resp, "BLEFRIEND32\r\nnRF51822 QFACA10\r\n0.7.7\r\nOK");
+}
+
+TEST_F(AdafruitBle, OnlyOneQueryAtATime) {
+    send_query("AT+GAPGETCONN");
+    EXPECT_FALSE(sdep_send_query("AT+HWVBAT", 9, SdepShortTimeout, query_done));
+    drain();
+    EXPECT_EQ(module.commands.size(), 1);
+}
+
+TEST_F(AdafruitBle, QueriesTimeOut) {
+    module.latency = 10 * SdepTimeout;
+    send_query("AT+GAPGETCONN");
+    for (int t = 0; t < 3 * SdepTimeout; t++) {
+        resp_buf_read_one(true);
+        advance_time(1);
+    }
+    EXPECT_EQ(query_result, 0);
+    EXPECT_EQ(query_resp, "");
+    EXPECT_FALSE(sdep_query_pending());
+    EXPECT_EQ(resp_buf_size(), 0);
+    module.responses.clear();
+}
+
+TEST_F(AdafruitBle, ReportsDontWaitForQueries) {
+    module.latency = 20;
+    send_query("AT+GAPGETCONN");
+    enqueue(key_report(0, {0x04}));
+    enqueue(key_report(0, {}));
+    // The query has a slot of its own, so the press goes out at any depth
+    EXPECT_TRUE(send_buf_send_one(SdepShortTimeout));
+    EXPECT_EQ(module.commands.size(), 2);
+    // The release only waits for the reports in flight
+    EXPECT_EQ(send_buf_send_one(SdepShortTimeout), AdafruitBlePipelineDepth > 1);
+    // The responses come back in order, the query's first
+    drain();
+    EXPECT_EQ(query_result, 1);
+    EXPECT_EQ(module.commands.size(), 3);
+}
+
+TEST_F(AdafruitBle, QueriesDontTakeUpThePipeline) {
+    module.latency = 20;
+    send_query("AT+GAPGETCONN");
+    for (uint8_t i = 0; i < AdafruitBlePipelineDepth + 1; i++) {
+        enqueue(key_report(0, {(uint8_t)(0x04 + i)}));
+    }
+    for (uint8_t i = 0; i < AdafruitBlePipelineDepth; i++) {
+        EXPECT_TRUE(send_buf_send_one(SdepShortTimeout));
+    }
+    EXPECT_FALSE(send_buf_send_one(SdepShortTimeout));
+    EXPECT_EQ(module.commands.size(), AdafruitBlePipelineDepth + 1);
+    drain();
+    EXPECT_EQ(query_result, 1);
+}
+
+TEST_F(AdafruitBle, BenchmarkTyping) {
+    const int count = 100;
+    for (int i = 0; i < count; i++) {
+        enqueue(key_report(0, {(uint8_t)(0x04 + i % 26)}));
+        enqueue(key_report(0, {}));
+        // Someone typing quickly, and the queue sent once a millisecond
+        for (int t = 0; t < 30; t++) {
+            resp_buf_read_one(true);
+            send_buf_send_one(SdepShortTimeout);
+            advance_time(1);
+        }
+    }
+    drain();
+    double bytes_out = (double)module.bytes_out / count;
+    double bytes_in = (double)module.bytes_in / count;
+    printf("[ BENCHMARK] %.1f SPI bytes out and %.1f in, %.1f packets and %.1f responses per keystroke\n",
+        bytes_out, bytes_in, (double)module.packets_out / count, (double)module.commands.size() / count);
+    // Each report used to be 51 characters in four SDEP packets, and waited for its OK
+    EXPECT_EQ(module.commands.size(), 2 * count);
+    EXPECT_LE(module.packets_out, 4 * count);
+    EXPECT_LE(bytes_out, 70);
+}
+
+TEST_F(AdafruitBle, BenchmarkBurst) {
+    // A chord of keys pressed and released together, queued faster than it can be sent
+    for (uint8_t i = 0; i < 6; i++) {
+        std::vector<uint8_t> keys;
+        for (uint8_t j = 0; j <= i; j++) {
+            keys.push_back(0x04 + j);
+        }
+        enqueue(key_report(0, keys));
+    }
+    for (uint8_t i = 1; i <= 6; i++) {
+        std::vector<uint8_t> keys(6, 0);
+        for (uint8_t j = i; j < 6; j++) {
+            keys[j] = 0x04 + j;
+        }
+        enqueue(key_report(0, keys));
+    }
+    uint32_t time = drain();
+    printf("[ BENCHMARK] 6 key chord: %d commands, %d ms with %d ms module latency\n",
+        (int)module.commands.size(), time, module.latency);
+    EXPECT_EQ(module.commands.size(), 7);
+#if AdafruitBlePipelineDepth > 1
+    // Without pipelining each command takes a full round trip
+    EXPECT_LT(time, module.commands.size() * module.latency);
+#endif
+}
@@ -0,0 +1,11 @@
+adafruit_ble_DEFS := -DNO_PRINT -DNO_DEBUG -DMOUSE_ENABLE
+adafruit_ble_SRC :=\
+	$(TMK_PATH)/protocol/lufa/tests/adafruit_ble_tests.cpp \
+	$(TMK_PATH)/protocol/lufa/adafruit_ble_sdep.cpp \
+	$(TMK_PATH)/common/test/timer.c
+
+adafruit_ble_INC := $(TMK_PATH)/protocol/lufa
+
+adafruit_ble_pipelined_DEFS := -DNO_PRINT -DNO_DEBUG -DMOUSE_ENABLE -DAdafruitBlePipelineDepth=3
+adafruit_ble_pipelined_SRC := $(adafruit_ble_SRC)
+adafruit_ble_pipelined_INC := $(adafruit_ble_INC)
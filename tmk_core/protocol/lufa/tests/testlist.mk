@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	adafruit_ble\
+	adafruit_ble_pipelined
@@ -6,6 +6,7 @@ SRC += midi.c \
 	   bytequeue/interrupt_setting.c \
 	   sysex_tools.c \
      qmk_midi.c \
+	   usb_midi_queue.c \
 	   $(LUFA_SRC_USBCLASS)
 
 VPATH += $(TMK_PATH)/$(MIDI_DIR)
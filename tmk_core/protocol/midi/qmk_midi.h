@@ -4,6 +4,10 @@
   #include "midi.h"
   extern MidiDevice midi_device;
   void setup_midi(void);
+  // Sends the MIDI messages of this pass of the main loop
+  void midi_send_queued(void);
   void send_midi_packet(MIDI_EventPacket_t* event);
+  // Writes the packets to the endpoint at once, so that they go out in the same frame
+  void send_midi_packets(const MIDI_EventPacket_t* events, uint8_t count);
   bool recv_midi_packet(MIDI_EventPacket_t* const event);
 #endif
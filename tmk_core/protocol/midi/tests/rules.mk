@@ -0,0 +1,8 @@
+usb_midi_queue_SRC :=\
+	$(TMK_PATH)/protocol/midi/tests/usb_midi_queue_tests.cpp \
+	$(TMK_PATH)/protocol/midi/usb_midi_queue.c \
+	$(TMK_PATH)/protocol/midi/midi.c \
+	$(TMK_PATH)/protocol/midi/midi_device.c \
+	$(TMK_PATH)/protocol/midi/bytequeue/bytequeue.c
+
+usb_midi_queue_INC := $(TMK_PATH)/protocol/midi
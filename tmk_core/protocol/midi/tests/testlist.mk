@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	usb_midi_queue
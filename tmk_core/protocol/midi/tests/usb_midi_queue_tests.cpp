@@ -0,0 +1,140 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "midi.h"
+#include "usb_midi_queue.h"
+#include "bytequeue/interrupt_setting.h"
+}
+
+extern "C" {
+interrupt_setting_t store_and_clear_interrupt(void) {
+    return 0;
+}
+
+void restore_interrupt_setting(interrupt_setting_t setting) {
+}
+}
+
+typedef std::vector<usb_midi_packet_t> transfer_t;
+
+static std::vector<transfer_t> transfers;
+static usb_midi_queue_t queue;
+
+static void send_packets(const usb_midi_packet_t* packets, uint8_t count) {
+    transfers.push_back(transfer_t(packets, packets + count));
+}
+
+static void send_func(MidiDevice* device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    usb_midi_queue_message(&queue, cnt, byte0, byte1, byte2);
+}
+
+class UsbMidiQueue : public testing::Test {
+public:
+    UsbMidiQueue() {
+        transfers.clear();
+        usb_midi_queue_init(&queue, send_packets);
+        midi_device_init(&device);
+        midi_device_set_send_func(&device, send_func);
+    }
+
+    void expect_packet(const usb_midi_packet_t& packet, uint8_t event, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+        EXPECT_EQ(packet.event, event);
+        EXPECT_EQ(packet.data[0], byte0);
+        EXPECT_EQ(packet.data[1], byte1);
+        EXPECT_EQ(packet.data[2], byte2);
+    }
+
+    MidiDevice device;
+};
+
+TEST_F(UsbMidiQueue, nothing_is_sent_before_a_flush) {
+    midi_send_noteon(&device, 0, 60, 127);
+    EXPECT_TRUE(transfers.empty());
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 1);
+    ASSERT_EQ(transfers[0].size(), 1);
+    expect_packet(transfers[0][0], 0x09, 0x90, 60, 127);
+}
+
+TEST_F(UsbMidiQueue, flushing_an_empty_queue_sends_nothing) {
+    usb_midi_queue_flush(&queue);
+    midi_send_noteon(&device, 0, 60, 127);
+    usb_midi_queue_flush(&queue);
+    usb_midi_queue_flush(&queue);
+    EXPECT_EQ(transfers.size(), 1);
+}
+
+TEST_F(UsbMidiQueue, a_chord_is_sent_in_a_single_transfer) {
+    const uint8_t chord[] = {60, 64, 67, 72};
+    for (uint8_t note : chord) {
+        midi_send_noteon(&device, 2, note, 100);
+    }
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 1);
+    ASSERT_EQ(transfers[0].size(), sizeof(chord));
+    for (uint8_t i = 0; i < sizeof(chord); i++) {
+        expect_packet(transfers[0][i], 0x09, 0x92, chord[i], 100);
+    }
+}
+
+TEST_F(UsbMidiQueue, messages_keep_their_order_and_cable_index) {
+    midi_send_noteon(&device, 0, 60, 127);
+    midi_send_cc(&device, 1, 64, 127);
+    midi_send_noteoff(&device, 0, 60, 0);
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 1);
+    ASSERT_EQ(transfers[0].size(), 3);
+    expect_packet(transfers[0][0], 0x09, 0x90, 60, 127);
+    expect_packet(transfers[0][1], 0x0B, 0xB1, 64, 127);
+    expect_packet(transfers[0][2], 0x08, 0x80, 60, 0);
+}
+
+TEST_F(UsbMidiQueue, a_full_queue_is_sent_before_more_packets_are_added) {
+    for (uint8_t i = 0; i < USB_MIDI_QUEUE_LENGTH + 3; i++) {
+        midi_send_noteon(&device, 0, i, 1);
+    }
+    ASSERT_EQ(transfers.size(), 1);
+    EXPECT_EQ(transfers[0].size(), USB_MIDI_QUEUE_LENGTH);
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 2);
+    ASSERT_EQ(transfers[1].size(), 3);
+    expect_packet(transfers[1][0], 0x09, 0x90, USB_MIDI_QUEUE_LENGTH, 1);
+}
+
+TEST_F(UsbMidiQueue, sysex_is_split_into_packets_with_the_right_code_index) {
+    uint8_t sysex[] = {0xF0, 0x7D, 0x01, 0x02, 0x03, 0xF7};
+    midi_send_array(&device, sizeof(sysex), sysex);
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 1);
+    ASSERT_EQ(transfers[0].size(), 2);
+    expect_packet(transfers[0][0], 0x04, 0xF0, 0x7D, 0x01);
+    expect_packet(transfers[0][1], 0x07, 0x02, 0x03, 0xF7);
+}
+
+TEST_F(UsbMidiQueue, system_common_messages_use_their_own_code_index) {
+    midi_send_songposition(&device, 0x1234);
+    midi_send_songselect(&device, 5);
+    midi_send_clock(&device);
+    usb_midi_queue_flush(&queue);
+    ASSERT_EQ(transfers.size(), 1);
+    ASSERT_EQ(transfers[0].size(), 3);
+    EXPECT_EQ(transfers[0][0].event, 0x03);
+    EXPECT_EQ(transfers[0][1].event, 0x02);
+    EXPECT_EQ(transfers[0][2].event, 0x0F);
+}
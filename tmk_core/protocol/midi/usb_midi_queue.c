@@ -0,0 +1,98 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "usb_midi_queue.h"
+#include "midi.h"
+
+#define SYSEX_START_OR_CONT 0x40
+#define SYSEX_ENDS_IN_1 0x50
+#define SYSEX_ENDS_IN_2 0x60
+#define SYSEX_ENDS_IN_3 0x70
+
+#define SYS_COMMON_1 0x50
+#define SYS_COMMON_2 0x20
+#define SYS_COMMON_3 0x30
+
+void usb_midi_queue_init(usb_midi_queue_t* queue, usb_midi_send_func_t send_func) {
+  queue->count = 0;
+  queue->send_func = send_func;
+}
+
+void usb_midi_queue_message(usb_midi_queue_t* queue, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+  usb_midi_packet_t packet;
+  packet.data[0] = byte0;
+  packet.data[1] = byte1;
+  packet.data[2] = byte2;
+
+  uint8_t cable = 0;
+
+  //if the length is undefined we assume it is a SYSEX message
+  if (midi_packet_length(byte0) == UNDEFINED) {
+    switch(cnt) {
+      case 3:
+        if (byte2 == SYSEX_END)
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_ENDS_IN_3);
+        else
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_START_OR_CONT);
+        break;
+      case 2:
+        if (byte1 == SYSEX_END)
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_ENDS_IN_2);
+        else
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_START_OR_CONT);
+        break;
+      case 1:
+        if (byte0 == SYSEX_END)
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_ENDS_IN_1);
+        else
+          packet.event = USB_MIDI_EVENT(cable, SYSEX_START_OR_CONT);
+        break;
+      default:
+        return; //invalid cnt
+    }
+  } else {
+    //deal with 'system common' messages
+    //TODO are there any more?
+    switch(byte0){
+      case MIDI_SONGPOSITION:
+        packet.event = USB_MIDI_EVENT(cable, SYS_COMMON_3);
+        break;
+      case MIDI_SONGSELECT:
+      case MIDI_TC_QUARTERFRAME:
+        packet.event = USB_MIDI_EVENT(cable, SYS_COMMON_2);
+        break;
+      default:
+        packet.event = USB_MIDI_EVENT(cable, byte0);
+        break;
+    }
+  }
+
+  usb_midi_queue_packet(queue, &packet);
+}
+
+void usb_midi_queue_packet(usb_midi_queue_t* queue, const usb_midi_packet_t* packet) {
+  if (queue->count >= USB_MIDI_QUEUE_LENGTH) {
+    usb_midi_queue_flush(queue);
+  }
+  queue->packets[queue->count++] = *packet;
+}
+
+void usb_midi_queue_flush(usb_midi_queue_t* queue) {
+  if (queue->count) {
+    queue->send_func(queue->packets, queue->count);
+    queue->count = 0;
+  }
+}
@@ -0,0 +1,50 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+// Collects the USB-MIDI event packets produced during one pass of the main loop, so that they
+// are written to the endpoint together, and e.g. all notes of a chord arrive in the same frame.
+
+// A full 64 byte bulk endpoint
+#ifndef USB_MIDI_QUEUE_LENGTH
+  #define USB_MIDI_QUEUE_LENGTH 16
+#endif
+
+// Same as MIDI_EVENT() from LUFA
+#define USB_MIDI_EVENT(cable, command) (((cable) << 4) | ((command) >> 4))
+
+// Same layout as MIDI_EventPacket_t
+typedef struct {
+  uint8_t event;
+  uint8_t data[3];
+} usb_midi_packet_t;
+
+typedef void (*usb_midi_send_func_t)(const usb_midi_packet_t* packets, uint8_t count);
+
+typedef struct {
+  usb_midi_packet_t packets[USB_MIDI_QUEUE_LENGTH];
+  uint8_t count;
+  usb_midi_send_func_t send_func;
+} usb_midi_queue_t;
+
+void usb_midi_queue_init(usb_midi_queue_t* queue, usb_midi_send_func_t send_func);
+// Queues a message from a MidiDevice send function, as a USB-MIDI packet
+void usb_midi_queue_message(usb_midi_queue_t* queue, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2);
+void usb_midi_queue_packet(usb_midi_queue_t* queue, const usb_midi_packet_t* packet);
+// Sends all queued packets with a single call of the send function
+void usb_midi_queue_flush(usb_midi_queue_t* queue);
@@ -92,6 +92,17 @@ uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
 void ps2_host_set_led(uint8_t usb_led);
 
+#ifdef PS2_USE_INT
+/* Non-blocking calls of the interrupt version. The response to a command
+ * sent with ps2_host_send_async isn't kept, ps2_host_busy tells when the
+ * device is done with it. Received bytes are put together into packets of
+ * the given size, see ps2_engine.h. */
+bool ps2_host_send_async(uint8_t data);
+bool ps2_host_busy(void);
+bool ps2_host_recv_packet(uint8_t *packet);
+void ps2_host_set_packet_size(uint8_t size);
+#endif
+
 
 /*--------------------------------------------------------------------
  * static functions
@@ -0,0 +1,236 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ps2_engine.h"
+
+#define BUFFER_MASK (PS2_BUFFER_SIZE - 1)
+
+#if PS2_BUFFER_SIZE & BUFFER_MASK
+    #error PS2_BUFFER_SIZE needs to be a power of two
+#endif
+
+ps2_stats_t ps2_stats;
+
+// The ISR only moves the head, and only by whole packets, the main loop only moves the tail
+static uint8_t buffer[PS2_BUFFER_SIZE];
+static volatile uint8_t buffer_head;
+static volatile uint8_t buffer_tail;
+
+static uint8_t packet_size = 1;
+// Bytes of the packet being received, which are already written after the head
+static uint8_t packet_length;
+static bool packet_dropped;
+static uint16_t packet_time;
+
+// Bit of the frame being received, 0 is the start bit, 9 the parity and 10 the stop bit
+static uint8_t rx_bit;
+static uint8_t rx_data;
+static bool rx_parity_error;
+static uint16_t rx_time;
+
+static volatile uint8_t command_state;
+static uint8_t command_data;
+static uint8_t command_bit;
+static uint16_t command_time;
+static volatile uint8_t command_response;
+
+static bool odd_parity(uint8_t data) {
+    data ^= data >> 4;
+    data ^= data >> 2;
+    data ^= data >> 1;
+    return data & 1;
+}
+
+static void drop_packet(void) {
+    if (packet_length) {
+        packet_length = 0;
+        ps2_stats.resyncs++;
+    }
+}
+
+void ps2_engine_init(void) {
+    buffer_head = buffer_tail = 0;
+    packet_size = 1;
+    packet_length = 0;
+    rx_bit = 0;
+    command_state = PS2_COMMAND_IDLE;
+    ps2_stats = (ps2_stats_t){0};
+}
+
+static void receive_byte(uint8_t data, uint16_t now) {
+    ps2_stats.bytes++;
+    if (command_state == PS2_COMMAND_WAITING) {
+        command_response = data;
+        command_state = PS2_COMMAND_DONE;
+        return;
+    }
+
+    if (packet_length && (uint16_t)(now - packet_time) >= PS2_PACKET_TIMEOUT) {
+        drop_packet();
+    }
+    packet_time = now;
+    if (packet_length == 0) {
+        if (packet_size > 1 && !(data & PS2_PACKET_SYNC)) {
+            ps2_stats.resyncs++;
+            return;
+        }
+        // One slot stays free to tell a full buffer from an empty one
+        packet_dropped = ((buffer_tail - buffer_head - 1) & BUFFER_MASK) < packet_size;
+    }
+    if (!packet_dropped) {
+        buffer[(buffer_head + packet_length) & BUFFER_MASK] = data;
+    }
+    if (++packet_length < packet_size) {
+        return;
+    }
+
+    packet_length = 0;
+    if (packet_dropped) {
+        ps2_stats.overflows++;
+    } else {
+        buffer_head = (buffer_head + packet_size) & BUFFER_MASK;
+        ps2_stats.packets++;
+    }
+}
+
+static void receive_error(uint16_t* counter) {
+    (*counter)++;
+    rx_bit = 0;
+    drop_packet();
+    if (command_state == PS2_COMMAND_WAITING) {
+        command_state = PS2_COMMAND_FAILED;
+        ps2_stats.command_errors++;
+    }
+}
+
+static int8_t send_bit(bool data, uint16_t now) {
+    command_bit++;
+    if (command_bit <= 8) {
+        return (command_data >> (command_bit - 1)) & 1;
+    }
+    if (command_bit == 9) {
+        return !odd_parity(command_data);
+    }
+    if (command_bit == 10) {
+        // Stop bit, which also lets go of the line for the acknowledge
+        return PS2_DRIVE_HI;
+    }
+
+    if (data) {
+        command_state = PS2_COMMAND_FAILED;
+        ps2_stats.command_errors++;
+    } else {
+        command_state = PS2_COMMAND_WAITING;
+        command_time = now;
+    }
+    return PS2_DRIVE_NONE;
+}
+
+int8_t ps2_engine_clock(bool data, uint16_t now) {
+    if (command_state == PS2_COMMAND_SENDING) {
+        return send_bit(data, now);
+    }
+
+    if (rx_bit && (uint16_t)(now - rx_time) >= PS2_FRAME_TIMEOUT) {
+        // Lost some edges, so this one starts a new frame
+        receive_error(&ps2_stats.timeouts);
+    }
+    rx_time = now;
+
+    switch (rx_bit) {
+        case 0:
+            if (data) {
+                receive_error(&ps2_stats.framing_errors);
+                return PS2_DRIVE_NONE;
+            }
+            rx_data = 0;
+            break;
+        case 9:
+            // Checked with the stop bit, so that it isn't taken for the next start bit
+            rx_parity_error = data == odd_parity(rx_data);
+            break;
+        case 10:
+            rx_bit = 0;
+            if (!data) {
+                receive_error(&ps2_stats.framing_errors);
+            } else if (rx_parity_error) {
+                receive_error(&ps2_stats.parity_errors);
+            } else {
+                receive_byte(rx_data, now);
+            }
+            return PS2_DRIVE_NONE;
+        default:
+            rx_data >>= 1;
+            if (data) {
+                rx_data |= 0x80;
+            }
+            break;
+    }
+    rx_bit++;
+    return PS2_DRIVE_NONE;
+}
+
+void ps2_engine_set_packet_size(uint8_t size) {
+    packet_size = size < 1 ? 1 : size > PS2_PACKET_MAX ? PS2_PACKET_MAX : size;
+    packet_length = 0;
+    buffer_head = buffer_tail = 0;
+}
+
+uint8_t ps2_engine_packet_size(void) {
+    return packet_size;
+}
+
+bool ps2_engine_read_packet(uint8_t* packet) {
+    uint8_t tail = buffer_tail;
+    if (tail == buffer_head) {
+        return false;
+    }
+    for (uint8_t i = 0; i < packet_size; i++) {
+        packet[i] = buffer[(tail + i) & BUFFER_MASK];
+    }
+    buffer_tail = (tail + packet_size) & BUFFER_MASK;
+    return true;
+}
+
+bool ps2_engine_command_start(uint8_t data, uint16_t now) {
+    if (command_state == PS2_COMMAND_SENDING || command_state == PS2_COMMAND_WAITING) {
+        return false;
+    }
+    // Requesting to send cuts off whatever the device was sending
+    rx_bit = 0;
+    drop_packet();
+    command_data = data;
+    command_bit = 0;
+    command_time = now;
+    command_state = PS2_COMMAND_SENDING;
+    return true;
+}
+
+ps2_command_state_t ps2_engine_command_state(uint16_t now) {
+    uint16_t elapsed = now - command_time;
+    if ((command_state == PS2_COMMAND_SENDING && elapsed >= PS2_SEND_TIMEOUT) ||
+        (command_state == PS2_COMMAND_WAITING && elapsed >= PS2_RESPONSE_TIMEOUT)) {
+        command_state = PS2_COMMAND_FAILED;
+        ps2_stats.command_errors++;
+    }
+    return command_state;
+}
+
+uint8_t ps2_engine_command_finish(void) {
+    uint8_t response = command_state == PS2_COMMAND_DONE ? command_response : 0;
+    command_state = PS2_COMMAND_IDLE;
+    return response;
+}
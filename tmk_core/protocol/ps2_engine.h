@@ -0,0 +1,98 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bit level PS/2 receive and send, driven by the falling edges of the clock line. It doesn't
+// touch the pins: the pin interrupt passes the level of the data line in, and drives the line
+// as it's told while a command is being sent. Received bytes are put together into packets,
+// one for keyboards and three or four for mice, which only go into the ring once complete.
+// Everything but ps2_engine_clock is called from the main loop with the interrupt off, except
+// reading packets, which is safe with it on.
+
+// Bytes buffered, a power of two
+#ifndef PS2_BUFFER_SIZE
+    #define PS2_BUFFER_SIZE 32
+#endif
+
+#define PS2_PACKET_MAX 4
+
+// A frame whose clock stops for this long is dropped, bits are less than 0.1ms apart
+#ifndef PS2_FRAME_TIMEOUT
+    #define PS2_FRAME_TIMEOUT 2
+#endif
+
+// A partial packet is dropped when its next byte doesn't come in this time
+#ifndef PS2_PACKET_TIMEOUT
+    #define PS2_PACKET_TIMEOUT 4
+#endif
+
+// The device starts clocking a command in at most 15ms, and answers in 25ms ([5]p.50 and p.46 in ps2.h)
+#define PS2_SEND_TIMEOUT 15
+#define PS2_RESPONSE_TIMEOUT 25
+
+// The first byte of a mouse packet always has bit 3 set, the others can hold anything.
+// A byte without it can't start a packet, so it is skipped to get back in sync.
+#define PS2_PACKET_SYNC 0x08
+
+// What ps2_engine_clock wants done with the data line
+#define PS2_DRIVE_NONE -1
+#define PS2_DRIVE_LO 0
+#define PS2_DRIVE_HI 1
+
+typedef enum {
+    PS2_COMMAND_IDLE,
+    PS2_COMMAND_SENDING,
+    PS2_COMMAND_WAITING, // for the response
+    PS2_COMMAND_DONE,
+    PS2_COMMAND_FAILED,
+} ps2_command_state_t;
+
+typedef struct {
+    uint16_t bytes;
+    uint16_t packets;
+    uint16_t parity_errors;
+    uint16_t framing_errors; // wrong start or stop bit
+    uint16_t timeouts;       // frames cut off
+    uint16_t overflows;      // packets dropped because the buffer was full
+    uint16_t resyncs;        // partial packets or out of sync bytes dropped
+    uint16_t command_errors; // commands not acknowledged or answered in time
+} ps2_stats_t;
+
+extern ps2_stats_t ps2_stats;
+
+void ps2_engine_init(void);
+// Called on each falling edge of the clock with the level of the data line, returns one of
+// the PS2_DRIVE_ values. now is in milliseconds.
+int8_t ps2_engine_clock(bool data, uint16_t now);
+
+// Bytes per packet, up to PS2_PACKET_MAX. Drops whatever was received.
+void ps2_engine_set_packet_size(uint8_t size);
+uint8_t ps2_engine_packet_size(void);
+// Copies the oldest packet out, returns false when there is none
+bool ps2_engine_read_packet(uint8_t* packet);
+
+// Starts sending a command, after the caller has inhibited the bus and pulled the data line
+// low for the start bit. Returns false while the last command is still in flight. The first
+// byte received after the command went out is its response, which doesn't go into the buffer.
+bool ps2_engine_command_start(uint8_t data, uint16_t now);
+// Also fails the command once it has timed out
+ps2_command_state_t ps2_engine_command_state(uint16_t now);
+// Returns the response to a command that is done, 0 when it failed, and makes way for the next
+uint8_t ps2_engine_command_finish(void);
@@ -37,6 +37,10 @@ POSSIBILITY OF SUCH DAMAGE.
 
 /*
  * PS/2 protocol Pin interrupt version
+ *
+ * Both directions are clocked in and out by the interrupt, see ps2_engine.h,
+ * so nothing here waits for the device except the blocking calls made while
+ * setting it up.
  */
 
 #include <stdbool.h>
@@ -44,28 +48,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <util/delay.h>
 #include "ps2.h"
 #include "ps2_io.h"
+#include "ps2_engine.h"
+#include "timer.h"
 #include "print.h"
 
 
-#define WAIT(stat, us, err) do { \
-    if (!wait_##stat(us)) { \
-        ps2_error = err; \
-        goto ERROR; \
-    } \
-} while (0)
-
-
 uint8_t ps2_error = PS2_ERR_NONE;
 
 
-static inline uint8_t pbuf_dequeue(void);
-static inline void pbuf_enqueue(uint8_t data);
-static inline bool pbuf_has_data(void);
-static inline void pbuf_clear(void);
-
-
 void ps2_host_init(void)
 {
+    ps2_engine_init();
     idle();
     PS2_INT_INIT();
     PS2_INT_ON();
@@ -73,150 +66,113 @@ void ps2_host_init(void)
     //_delay_ms(2500);
 }
 
-uint8_t ps2_host_send(uint8_t data)
+static ps2_command_state_t command_state(void)
 {
-    bool parity = true;
-    ps2_error = PS2_ERR_NONE;
+    PS2_INT_OFF();
+    ps2_command_state_t state = ps2_engine_command_state(timer_read());
+    PS2_INT_ON();
+    if (state == PS2_COMMAND_FAILED) {
+        // the start bit may still be held
+        idle();
+    }
+    return state;
+}
+
+bool ps2_host_busy(void)
+{
+    ps2_command_state_t state = command_state();
+    return state == PS2_COMMAND_SENDING || state == PS2_COMMAND_WAITING;
+}
+
+bool ps2_host_send_async(uint8_t data)
+{
+    if (ps2_host_busy()) {
+        return false;
+    }
 
     PS2_INT_OFF();
+    ps2_engine_command_start(data, timer_read());
 
     /* terminate a transmission if we have */
     inhibit();
     _delay_us(100); // 100us [4]p.13, [5]p.50
 
-    /* 'Request to Send' and Start bit */
+    /* 'Request to Send' and Start bit, the interrupt clocks out the rest */
     data_lo();
     clock_hi();
-    WAIT(clock_lo, 10000, 10);   // 10ms [5]p.50
-
-    /* Data bit[2-9] */
-    for (uint8_t i = 0; i < 8; i++) {
-        _delay_us(15);
-        if (data&(1<<i)) {
-            parity = !parity;
-            data_hi();
-        } else {
-            data_lo();
-        }
-        WAIT(clock_hi, 50, 2);
-        WAIT(clock_lo, 50, 3);
-    }
-
-    /* Parity bit */
-    _delay_us(15);
-    if (parity) { data_hi(); } else { data_lo(); }
-    WAIT(clock_hi, 50, 4);
-    WAIT(clock_lo, 50, 5);
-
-    /* Stop bit */
-    _delay_us(15);
-    data_hi();
+    PS2_INT_ON();
+    return true;
+}
 
-    /* Ack */
-    WAIT(data_lo, 50, 6);
-    WAIT(clock_lo, 50, 7);
+uint8_t ps2_host_send(uint8_t data)
+{
+    ps2_error = PS2_ERR_NONE;
 
-    /* wait for idle state */
-    WAIT(clock_hi, 50, 8);
-    WAIT(data_hi, 50, 9);
+    while (!ps2_host_send_async(data));
+    while (ps2_host_busy());
 
-    idle();
-    PS2_INT_ON();
-    return ps2_host_recv_response();
-ERROR:
-    idle();
+    PS2_INT_OFF();
+    if (ps2_engine_command_state(timer_read()) == PS2_COMMAND_FAILED) {
+        ps2_error = PS2_ERR_NODATA;
+    }
+    uint8_t response = ps2_engine_command_finish();
     PS2_INT_ON();
-    return 0;
+    return response;
 }
 
 uint8_t ps2_host_recv_response(void)
 {
+    uint8_t packet[PS2_PACKET_MAX] = { 0 };
+
     // Command may take 25ms/20ms at most([5]p.46, [3]p.21)
     uint8_t retry = 25;
-    while (retry-- && !pbuf_has_data()) {
+    while (retry-- && !ps2_engine_read_packet(packet)) {
         _delay_ms(1);
     }
-    return pbuf_dequeue();
+    return packet[0];
 }
 
 /* get data received by interrupt */
 uint8_t ps2_host_recv(void)
 {
-    if (pbuf_has_data()) {
+    uint8_t packet[PS2_PACKET_MAX];
+
+    if (ps2_engine_read_packet(packet)) {
         ps2_error = PS2_ERR_NONE;
-        return pbuf_dequeue();
+        return packet[0];
     } else {
         ps2_error = PS2_ERR_NODATA;
         return 0;
     }
 }
 
-ISR(PS2_INT_VECT)
+bool ps2_host_recv_packet(uint8_t *packet)
 {
-    static enum {
-        INIT,
-        START,
-        BIT0, BIT1, BIT2, BIT3, BIT4, BIT5, BIT6, BIT7,
-        PARITY,
-        STOP,
-    } state = INIT;
-    static uint8_t data = 0;
-    static uint8_t parity = 1;
+    return ps2_engine_read_packet(packet);
+}
 
-    // TODO: abort if elapse 100us from previous interrupt
+void ps2_host_set_packet_size(uint8_t size)
+{
+    PS2_INT_OFF();
+    ps2_engine_set_packet_size(size);
+    PS2_INT_ON();
+}
 
+ISR(PS2_INT_VECT)
+{
     // return unless falling edge
     if (clock_in()) {
-        goto RETURN;
+        return;
     }
 
-    state++;
-    switch (state) {
-        case START:
-            if (data_in())
-                goto ERROR;
-            break;
-        case BIT0:
-        case BIT1:
-        case BIT2:
-        case BIT3:
-        case BIT4:
-        case BIT5:
-        case BIT6:
-        case BIT7:
-            data >>= 1;
-            if (data_in()) {
-                data |= 0x80;
-                parity++;
-            }
-            break;
-        case PARITY:
-            if (data_in()) {
-                if (!(parity & 0x01))
-                    goto ERROR;
-            } else {
-                if (parity & 0x01)
-                    goto ERROR;
-            }
+    switch (ps2_engine_clock(data_in(), timer_read())) {
+        case PS2_DRIVE_LO:
+            data_lo();
             break;
-        case STOP:
-            if (!data_in())
-                goto ERROR;
-            pbuf_enqueue(data);
-            goto DONE;
+        case PS2_DRIVE_HI:
+            data_hi();
             break;
-        default:
-            goto ERROR;
     }
-    goto RETURN;
-ERROR:
-    ps2_error = state;
-DONE:
-    state = INIT;
-    data = 0;
-    parity = 1;
-RETURN:
-    return;
 }
 
 /* send LED state to keyboard */
@@ -225,55 +181,3 @@ void ps2_host_set_led(uint8_t led)
     ps2_host_send(0xED);
     ps2_host_send(led);
 }
-
-
-/*--------------------------------------------------------------------
- * Ring buffer to store scan codes from keyboard
- *------------------------------------------------------------------*/
-#define PBUF_SIZE 32
-static uint8_t pbuf[PBUF_SIZE];
-static uint8_t pbuf_head = 0;
-static uint8_t pbuf_tail = 0;
-static inline void pbuf_enqueue(uint8_t data)
-{
-    uint8_t sreg = SREG;
-    cli();
-    uint8_t next = (pbuf_head + 1) % PBUF_SIZE;
-    if (next != pbuf_tail) {
-        pbuf[pbuf_head] = data;
-        pbuf_head = next;
-    } else {
-        print("pbuf: full\n");
-    }
-    SREG = sreg;
-}
-static inline uint8_t pbuf_dequeue(void)
-{
-    uint8_t val = 0;
-
-    uint8_t sreg = SREG;
-    cli();
-    if (pbuf_head != pbuf_tail) {
-        val = pbuf[pbuf_tail];
-        pbuf_tail = (pbuf_tail + 1) % PBUF_SIZE;
-    }
-    SREG = sreg;
-
-    return val;
-}
-static inline bool pbuf_has_data(void)
-{
-    uint8_t sreg = SREG;
-    cli();
-    bool has_data = (pbuf_head != pbuf_tail);
-    SREG = sreg;
-    return has_data;
-}
-static inline void pbuf_clear(void)
-{
-    uint8_t sreg = SREG;
-    cli();
-    pbuf_head = pbuf_tail = 0;
-    SREG = sreg;
-}
-
@@ -25,6 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "report.h"
 #include "debug.h"
 #include "ps2.h"
+#include "mouse_merge.h"
 
 /* ============================= MACROS ============================ */
 
@@ -35,6 +36,12 @@ static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report)
 static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_enable_scrolling(void);
 static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report);
+#if PS2_MOUSE_SCROLL_BTN_MASK && PS2_MOUSE_SCROLL_BTN_SEND
+static inline void ps2_mouse_scroll_click_task(void);
+#endif
+#ifdef PS2_USE_INT
+static inline bool ps2_mouse_recv_packet(uint8_t *packet);
+#endif
 
 /* ============================= IMPLEMENTATION ============================ */
 
@@ -64,6 +71,11 @@ void ps2_mouse_init(void) {
 #endif
 
     ps2_mouse_init_user();
+
+#ifdef PS2_USE_INT
+    // from here on the mouse only sends packets
+    ps2_host_set_packet_size(PS2_MOUSE_PACKET_SIZE);
+#endif
 }
 
 __attribute__((weak))
@@ -74,7 +86,23 @@ void ps2_mouse_task(void) {
     static uint8_t buttons_prev = 0;
     extern int tp_buttons;
 
+#if PS2_MOUSE_SCROLL_BTN_MASK && PS2_MOUSE_SCROLL_BTN_SEND
+    ps2_mouse_scroll_click_task();
+#endif
+
     /* receives packet from mouse */
+#ifdef PS2_USE_INT
+    uint8_t packet[PS2_MOUSE_PACKET_SIZE];
+    if (!ps2_mouse_recv_packet(packet)) {
+        return;
+    }
+    mouse_report.buttons = packet[0] | tp_buttons;
+    mouse_report.x = packet[1] * PS2_MOUSE_X_MULTIPLIER;
+    mouse_report.y = packet[2] * PS2_MOUSE_Y_MULTIPLIER;
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+    mouse_report.v = -(packet[3] & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+#endif
+#else
     uint8_t rcv;
     rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
     if (rcv == PS2_ACK) {
@@ -88,6 +116,7 @@ void ps2_mouse_task(void) {
         if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
         return;
     }
+#endif
 
     /* if mouse moves or buttons state changes */
     if (mouse_report.x || mouse_report.y || mouse_report.v ||
@@ -105,7 +134,7 @@ void ps2_mouse_task(void) {
         // Used to debug the bytes sent to the host
         ps2_mouse_print_report(&mouse_report);
 #endif
-        host_mouse_send(&mouse_report);
+        mouse_merge_add(MOUSE_SOURCE_PS2, &mouse_report);
     }
 
     ps2_mouse_clear_report(&mouse_report);
@@ -147,6 +176,27 @@ void ps2_mouse_set_sample_rate(ps2_mouse_sample_rate_t sample_rate) {
 
 /* ============================= HELPERS ============================ */
 
+#ifdef PS2_USE_INT
+/* Packets come in by themselves in stream mode. In remote mode the next one
+ * is asked for once the last one is in, without waiting for it. */
+static inline bool ps2_mouse_recv_packet(uint8_t *packet) {
+    static bool requested = false;
+    static uint16_t request_time = 0;
+
+    if (ps2_host_recv_packet(packet)) {
+        requested = false;
+        return true;
+    }
+    if (ps2_mouse_mode == PS2_MOUSE_REMOTE_MODE &&
+            (!requested || timer_elapsed(request_time) > PS2_MOUSE_READ_TIMEOUT) &&
+            ps2_host_send_async(PS2_MOUSE_READ_DATA)) {
+        requested = true;
+        request_time = timer_read();
+    }
+    return false;
+}
+#endif
+
 #define X_IS_NEG  (mouse_report->buttons & (1<<PS2_MOUSE_X_SIGN))
 #define Y_IS_NEG  (mouse_report->buttons & (1<<PS2_MOUSE_Y_SIGN))
 #define X_IS_OVF  (mouse_report->buttons & (1<<PS2_MOUSE_X_OVFLW))
@@ -208,6 +258,12 @@ static inline void ps2_mouse_enable_scrolling(void) {
     _delay_ms(20);
 }
 
+#if PS2_MOUSE_SCROLL_BTN_SEND
+static bool scroll_click_held = false;
+static uint8_t scroll_click_buttons;
+static uint16_t scroll_click_time;
+#endif
+
 #define PRESS_SCROLL_BUTTONS    mouse_report->buttons |= (PS2_MOUSE_SCROLL_BTN_MASK)
 #define RELEASE_SCROLL_BUTTONS  mouse_report->buttons &= ~(PS2_MOUSE_SCROLL_BTN_MASK)
 static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
@@ -246,14 +302,33 @@ static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
 #if PS2_MOUSE_SCROLL_BTN_SEND
         if (scroll_state == SCROLL_BTN
                 && timer_elapsed(scroll_button_time) < PS2_MOUSE_SCROLL_BTN_SEND) {
+            // The click is sent with this report, and released by a later one
+            scroll_click_buttons = mouse_report->buttons;
+            scroll_click_time = timer_read();
+            scroll_click_held = true;
+            scroll_state = SCROLL_NONE;
             PRESS_SCROLL_BUTTONS;
-            host_mouse_send(mouse_report);
-            _delay_ms(100);
-            RELEASE_SCROLL_BUTTONS;
+            return;
         }
 #endif
         scroll_state = SCROLL_NONE;
     }
 
+#if PS2_MOUSE_SCROLL_BTN_SEND
+    // A report without the click releases it
+    scroll_click_held = false;
+#endif
     RELEASE_SCROLL_BUTTONS;
 }
+
+#if PS2_MOUSE_SCROLL_BTN_SEND
+// Releases a click of the scroll buttons a send interval after its press, so that the two are
+// sent in separate reports
+static inline void ps2_mouse_scroll_click_task(void) {
+    if (scroll_click_held && timer_elapsed(scroll_click_time) >= MOUSE_SEND_INTERVAL) {
+        report_mouse_t release = { .buttons = scroll_click_buttons };
+        scroll_click_held = false;
+        mouse_merge_add(MOUSE_SOURCE_PS2, &release);
+    }
+}
+#endif
@@ -117,6 +117,16 @@ static enum ps2_mouse_mode_e {
 #ifndef PS2_MOUSE_INIT_DELAY
 #define PS2_MOUSE_INIT_DELAY            1000
 #endif
+/* in remote mode, ask again when a packet hasn't come in this many ms */
+#ifndef PS2_MOUSE_READ_TIMEOUT
+#define PS2_MOUSE_READ_TIMEOUT          50
+#endif
+
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+#define PS2_MOUSE_PACKET_SIZE           4
+#else
+#define PS2_MOUSE_PACKET_SIZE           3
+#endif
 
 enum ps2_mouse_command_e {
     PS2_MOUSE_RESET = 0xFF,
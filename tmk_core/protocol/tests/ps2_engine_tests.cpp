@@ -0,0 +1,310 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <stdlib.h>
+extern "C" {
+#include "ps2_engine.h"
+}
+
+// A device on the other end of the bus, which clocks frames bit by bit at about 12.5kHz
+class Ps2Device {
+   public:
+    uint32_t time_us = 0;
+
+    uint16_t now() { return time_us / 1000; }
+
+    void edge(bool data) {
+        time_us += 80;
+        driven.push_back(ps2_engine_clock(data, now()));
+    }
+
+    // The 11 bits of a frame, with the parity or the stop bit flipped if asked to
+    std::vector<bool> frame(uint8_t data, bool bad_parity = false, bool bad_stop = false) {
+        std::vector<bool> bits;
+        bool parity = true;
+        bits.push_back(false);
+        for (int i = 0; i < 8; i++) {
+            bool bit = data & (1 << i);
+            parity ^= bit;
+            bits.push_back(bit);
+        }
+        bits.push_back(parity ^ bad_parity);
+        bits.push_back(!bad_stop);
+        return bits;
+    }
+
+    void send(uint8_t data, bool bad_parity = false, bool bad_stop = false) {
+        for (bool bit : frame(data, bad_parity, bad_stop)) {
+            edge(bit);
+        }
+        time_us += 100;
+    }
+
+    void send(std::vector<uint8_t> packet) {
+        for (uint8_t data : packet) {
+            send(data);
+        }
+    }
+
+    // Clocks a command in from the host, reading each bit on the rising edge after the host
+    // has set it, and acknowledges it if asked to. Returns the bits read, the start bit first.
+    std::vector<bool> receive(bool ack = true) {
+        std::vector<bool> bits;
+        bool line = false; // pulled low by the host for the start bit
+        bits.push_back(line);
+        driven.clear();
+        for (int i = 0; i < 10; i++) {
+            edge(true);
+            if (driven.back() != PS2_DRIVE_NONE) {
+                line = driven.back();
+            }
+            bits.push_back(line);
+        }
+        edge(!ack);
+        time_us += 100;
+        return bits;
+    }
+
+    void wait_ms(uint32_t ms) { time_us += ms * 1000; }
+
+    std::vector<int8_t> driven;
+};
+
+class Ps2Engine : public testing::Test {
+   public:
+    Ps2Engine() { ps2_engine_init(); }
+
+    std::vector<std::vector<uint8_t>> read_packets() {
+        std::vector<std::vector<uint8_t>> packets;
+        uint8_t packet[PS2_PACKET_MAX];
+        while (ps2_engine_read_packet(packet)) {
+            packets.emplace_back(packet, packet + ps2_engine_packet_size());
+        }
+        return packets;
+    }
+
+    Ps2Device device;
+};
+
+typedef std::vector<std::vector<uint8_t>> packets_t;
+
+TEST_F(Ps2Engine, ReceivesKeyboardBytes) {
+    device.send({0x1C, 0xF0, 0x1C});
+    EXPECT_EQ(read_packets(), packets_t({{0x1C}, {0xF0}, {0x1C}}));
+    EXPECT_EQ(ps2_stats.bytes, 3);
+    EXPECT_EQ(ps2_stats.packets, 3);
+}
+
+TEST_F(Ps2Engine, NeverDrivesTheLineWhileReceiving) {
+    device.send({0x00, 0xFF, 0xAA});
+    for (int8_t drive : device.driven) {
+        EXPECT_EQ(drive, PS2_DRIVE_NONE);
+    }
+}
+
+TEST_F(Ps2Engine, AssemblesMousePackets) {
+    ps2_engine_set_packet_size(3);
+    device.send({0x08, 0x01, 0xFF});
+    EXPECT_EQ(read_packets(), packets_t({{0x08, 0x01, 0xFF}}));
+    device.send({0x09, 0x00});
+    EXPECT_EQ(read_packets(), packets_t());
+    device.send(0x00);
+    EXPECT_EQ(read_packets(), packets_t({{0x09, 0x00, 0x00}}));
+}
+
+TEST_F(Ps2Engine, ParityErrorDropsThePacket) {
+    ps2_engine_set_packet_size(3);
+    device.send(0x08);
+    device.send(0x10, true);
+    device.send(0x01);
+    device.send({0x0A, 0x02, 0x03});
+    EXPECT_EQ(read_packets(), packets_t({{0x0A, 0x02, 0x03}}));
+    EXPECT_EQ(ps2_stats.parity_errors, 1);
+    // the partial packet, and the byte after the error which can't start one
+    EXPECT_EQ(ps2_stats.resyncs, 2);
+}
+
+TEST_F(Ps2Engine, FramingErrorsDropTheByte) {
+    device.send(0x1C, false, true);
+    // a glitch where the start bit should be
+    device.edge(true);
+    device.send(0x32);
+    EXPECT_EQ(read_packets(), packets_t({{0x32}}));
+    EXPECT_EQ(ps2_stats.framing_errors, 2);
+}
+
+TEST_F(Ps2Engine, ResyncsAfterLostEdges) {
+    std::vector<bool> bits = device.frame(0x1C);
+    for (int i = 0; i < 5; i++) {
+        device.edge(bits[i]);
+    }
+    device.wait_ms(PS2_FRAME_TIMEOUT + 1);
+    device.send(0x32);
+    EXPECT_EQ(read_packets(), packets_t({{0x32}}));
+    EXPECT_EQ(ps2_stats.timeouts, 1);
+}
+
+TEST_F(Ps2Engine, PartialPacketTimesOut) {
+    ps2_engine_set_packet_size(3);
+    device.send({0x08, 0x01});
+    device.wait_ms(PS2_PACKET_TIMEOUT + 1);
+    device.send({0x18, 0x02, 0xFE});
+    EXPECT_EQ(read_packets(), packets_t({{0x18, 0x02, 0xFE}}));
+    EXPECT_EQ(ps2_stats.resyncs, 1);
+}
+
+TEST_F(Ps2Engine, OverflowDropsWholePackets) {
+    ps2_engine_set_packet_size(3);
+    const uint8_t capacity = (PS2_BUFFER_SIZE - 1) / 3;
+    for (uint8_t i = 0; i < capacity + 2; i++) {
+        device.send({0x08, i, 0});
+    }
+    packets_t packets = read_packets();
+    ASSERT_EQ(packets.size(), capacity);
+    for (uint8_t i = 0; i < capacity; i++) {
+        EXPECT_EQ(packets[i], std::vector<uint8_t>({0x08, i, 0}));
+    }
+    EXPECT_EQ(ps2_stats.overflows, 2);
+
+    device.send({0x08, 0x55, 0});
+    EXPECT_EQ(read_packets(), packets_t({{0x08, 0x55, 0}}));
+}
+
+TEST_F(Ps2Engine, SendsCommandAndReadsResponse) {
+    EXPECT_TRUE(ps2_engine_command_start(0xF4, device.now()));
+    EXPECT_FALSE(ps2_engine_command_start(0xF5, device.now()));
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_SENDING);
+
+    std::vector<bool> bits = device.receive();
+    std::vector<bool> expected = device.frame(0xF4);
+    EXPECT_EQ(bits, expected);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_WAITING);
+
+    device.send(0xFA);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_DONE);
+    EXPECT_EQ(ps2_engine_command_finish(), 0xFA);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_IDLE);
+
+    // the response isn't a packet, but what follows it is
+    device.send({0xAA, 0x00});
+    EXPECT_EQ(read_packets(), packets_t({{0xAA}, {0x00}}));
+}
+
+TEST_F(Ps2Engine, SendsEveryByteWithOddParity) {
+    for (int data = 0; data < 256; data++) {
+        ASSERT_TRUE(ps2_engine_command_start(data, device.now()));
+        EXPECT_EQ(device.receive(), device.frame(data));
+        device.send(0xFA);
+        EXPECT_EQ(ps2_engine_command_finish(), 0xFA);
+    }
+    EXPECT_EQ(ps2_stats.command_errors, 0);
+}
+
+TEST_F(Ps2Engine, CommandFailsWithoutAcknowledge) {
+    ps2_engine_command_start(0xFF, device.now());
+    device.receive(false);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_FAILED);
+    EXPECT_EQ(ps2_engine_command_finish(), 0);
+    EXPECT_EQ(ps2_stats.command_errors, 1);
+}
+
+TEST_F(Ps2Engine, CommandTimesOut) {
+    ps2_engine_command_start(0xFF, device.now());
+    device.wait_ms(PS2_SEND_TIMEOUT - 1);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_SENDING);
+    device.wait_ms(1);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_FAILED);
+
+    ps2_engine_command_start(0xFF, device.now());
+    device.receive();
+    device.wait_ms(PS2_RESPONSE_TIMEOUT);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_FAILED);
+    EXPECT_EQ(ps2_stats.command_errors, 2);
+
+    // the device can still be talked to
+    ps2_engine_command_start(0xF4, device.now());
+    device.receive();
+    device.send(0xFA);
+    EXPECT_EQ(ps2_engine_command_state(device.now()), PS2_COMMAND_DONE);
+}
+
+TEST_F(Ps2Engine, CommandCutsOffWhatTheDeviceWasSending) {
+    ps2_engine_set_packet_size(3);
+    device.send(0x08);
+    std::vector<bool> bits = device.frame(0x01);
+    for (int i = 0; i < 4; i++) {
+        device.edge(bits[i]);
+    }
+    ps2_engine_command_start(0xEB, device.now());
+    EXPECT_EQ(device.receive(), device.frame(0xEB));
+    device.send(0xFA);
+    device.send({0x09, 0x03, 0x04});
+    EXPECT_EQ(ps2_engine_command_finish(), 0xFA);
+    EXPECT_EQ(read_packets(), packets_t({{0x09, 0x03, 0x04}}));
+}
+
+// Mouse packets on a noisy bus: every packet that is read has to be one that was sent, in order
+TEST_F(Ps2Engine, RecoversFromRandomErrors) {
+    ps2_engine_set_packet_size(3);
+    srand(1);
+    std::vector<std::vector<uint8_t>> sent;
+    packets_t received;
+    int errors = 0;
+    for (int i = 0; i < 2000; i++) {
+        std::vector<uint8_t> packet = {(uint8_t)((rand() & 0xF7) | 0x08), (uint8_t)rand(), (uint8_t)rand()};
+        sent.push_back(packet);
+        for (int j = 0; j < 3; j++) {
+            switch (rand() % 50) {
+                case 0:
+                    device.send(packet[j], true);
+                    errors++;
+                    break;
+                case 1:
+                    device.send(packet[j], false, true);
+                    errors++;
+                    break;
+                case 2: {
+                    std::vector<bool> bits = device.frame(packet[j]);
+                    for (int k = 0; k < rand() % 10 + 1; k++) {
+                        device.edge(bits[k]);
+                    }
+                    device.wait_ms(PS2_FRAME_TIMEOUT);
+                    errors++;
+                    break;
+                }
+                default:
+                    device.send(packet[j]);
+            }
+        }
+        device.wait_ms(5);
+        packets_t packets = read_packets();
+        received.insert(received.end(), packets.begin(), packets.end());
+    }
+
+    size_t next = 0;
+    for (auto& packet : received) {
+        while (next < sent.size() && sent[next] != packet) {
+            next++;
+        }
+        ASSERT_LT(next, sent.size());
+        next++;
+    }
+    EXPECT_EQ(ps2_stats.parity_errors + ps2_stats.framing_errors + ps2_stats.timeouts, errors);
+    EXPECT_GE(received.size(), sent.size() - errors);
+    EXPECT_EQ(ps2_stats.overflows, 0);
+}
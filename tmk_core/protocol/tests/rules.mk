@@ -0,0 +1,5 @@
+ps2_engine_SRC :=\
+	$(TMK_PATH)/protocol/tests/ps2_engine_tests.cpp \
+	$(TMK_PATH)/protocol/ps2_engine.c
+
+ps2_engine_INC := $(TMK_PATH)/protocol
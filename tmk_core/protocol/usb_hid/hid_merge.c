@@ -0,0 +1,127 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "hid_merge.h"
+
+#define BOOT_REPORT_SIZE 8
+#define STATE_SIZE (256 / 8)
+
+typedef struct {
+    uint8_t reports[HID_MERGE_QUEUE_SIZE][BOOT_REPORT_SIZE];
+    uint8_t head;
+    uint8_t count;
+    // Usages down, one bit each
+    uint8_t state[STATE_SIZE];
+} hid_device_t;
+
+static hid_device_t devices[HID_MERGE_DEVICES];
+static uint8_t merged[STATE_SIZE];
+static uint16_t dropped;
+
+void hid_merge_init(void) {
+    memset(devices, 0, sizeof(devices));
+    memset(merged, 0, sizeof(merged));
+    dropped = 0;
+}
+
+void hid_merge_report(uint8_t device, const uint8_t* report, uint8_t length) {
+    if (device >= HID_MERGE_DEVICES) {
+        return;
+    }
+    hid_device_t* d = &devices[device];
+    uint8_t slot;
+    if (d->count == HID_MERGE_QUEUE_SIZE) {
+        slot = (d->head + d->count - 1) % HID_MERGE_QUEUE_SIZE;
+        dropped++;
+    } else {
+        slot = (d->head + d->count) % HID_MERGE_QUEUE_SIZE;
+        d->count++;
+    }
+    memset(d->reports[slot], 0, BOOT_REPORT_SIZE);
+    memcpy(d->reports[slot], report, length < BOOT_REPORT_SIZE ? length : BOOT_REPORT_SIZE);
+}
+
+void hid_merge_release(uint8_t device) {
+    static const uint8_t empty[BOOT_REPORT_SIZE] = {0};
+    hid_merge_report(device, empty, BOOT_REPORT_SIZE);
+}
+
+static void apply_report(hid_device_t* d, const uint8_t* report) {
+    uint8_t state[STATE_SIZE] = {0};
+    if (report[2] == HID_ERROR_ROLL_OVER) {
+        // Keeps the keys, only the modifiers are known
+        memcpy(state, d->state, STATE_SIZE);
+    } else {
+        for (uint8_t i = 2; i < BOOT_REPORT_SIZE; i++) {
+            // Usages 1 to 3 are errors, not keys
+            if (report[i] > 3) {
+                state[report[i] / 8] |= 1 << (report[i] % 8);
+            }
+        }
+    }
+    state[HID_MODIFIER_FIRST / 8] = report[0];
+    memcpy(d->state, state, STATE_SIZE);
+}
+
+bool hid_merge_apply(void) {
+    bool applied = false;
+    for (uint8_t i = 0; i < HID_MERGE_DEVICES; i++) {
+        hid_device_t* d = &devices[i];
+        if (d->count) {
+            apply_report(d, d->reports[d->head]);
+            d->head = (d->head + 1) % HID_MERGE_QUEUE_SIZE;
+            d->count--;
+            applied = true;
+        }
+    }
+    if (!applied) {
+        return false;
+    }
+
+    bool changed = false;
+    for (uint8_t byte = 0; byte < STATE_SIZE; byte++) {
+        uint8_t bits = 0;
+        for (uint8_t i = 0; i < HID_MERGE_DEVICES; i++) {
+            bits |= devices[i].state[byte];
+        }
+        changed |= bits != merged[byte];
+        merged[byte] = bits;
+    }
+    return changed;
+}
+
+bool hid_merge_is_on(uint8_t usage) {
+    return merged[usage / 8] & (1 << (usage % 8));
+}
+
+uint16_t hid_merge_row(uint8_t row) {
+    return merged[row * 2] | (uint16_t)merged[row * 2 + 1] << 8;
+}
+
+uint8_t hid_merge_key_count(void) {
+    uint8_t count = 0;
+    for (uint8_t byte = 0; byte < STATE_SIZE; byte++) {
+        for (uint8_t bits = merged[byte]; bits; bits &= bits - 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint16_t hid_merge_dropped(void) {
+    return dropped;
+}
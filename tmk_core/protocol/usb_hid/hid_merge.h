@@ -0,0 +1,66 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Merges the boot protocol reports of several keyboards into the state of all 256 HID usages,
+// so that all of them together can have any number of keys down. Reports are queued per
+// keyboard and applied one per keyboard at a time, so that each state of a keyboard is seen
+// by a scan, even when it sends reports faster than the matrix is scanned. That needs the
+// scan to process every key a report changed, so QMK_KEYS_PER_SCAN has to be the size of
+// the matrix.
+
+#ifndef HID_MERGE_DEVICES
+    #define HID_MERGE_DEVICES 4
+#endif
+
+// Reports of a keyboard that aren't applied yet
+#ifndef HID_MERGE_QUEUE_SIZE
+    #define HID_MERGE_QUEUE_SIZE 4
+#endif
+
+// Usage the keyboard puts in every key slot when too many keys are down to tell which
+#define HID_ERROR_ROLL_OVER 0x01
+
+// Modifiers are usages 0xE0 to 0xE7
+#define HID_MODIFIER_FIRST 0xE0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void hid_merge_init(void);
+// Queues a boot protocol report: modifiers, a reserved byte, then the keys down. When the
+// queue is full the newest report is replaced, so only the final state is sure to be seen.
+void hid_merge_report(uint8_t device, const uint8_t* report, uint8_t length);
+// A keyboard was unplugged, its keys are released with the next apply
+void hid_merge_release(uint8_t device);
+// Applies the oldest queued report of each keyboard, returns whether anything changed
+bool hid_merge_apply(void);
+
+bool hid_merge_is_on(uint8_t usage);
+// Usages row * 16 to row * 16 + 15, one bit each
+uint16_t hid_merge_row(uint8_t row);
+uint8_t hid_merge_key_count(void);
+// Reports that had to be replaced because a queue was full
+uint16_t hid_merge_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,17 +1,21 @@
 #include "parser.h"
 #include "usb_hid.h"
+#include "hid_merge.h"
 
 #include "debug.h"
 
 
 void KBDReportParser::Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf)
 {
-    ::memcpy(&report, buf, sizeof(report_keyboard_t));
+    // the report type is larger than a boot report with NKRO_ENABLE
+    ::memset(&report, 0, sizeof(report_keyboard_t));
+    ::memcpy(&report, buf, len < sizeof(report_keyboard_t) ? len : sizeof(report_keyboard_t));
     time_stamp = millis();
+    hid_merge_report(device, buf, len);
 
     dprintf("input %d:  %02X %02X", hid->GetAddress(), report.mods, report.reserved);
-    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
-        dprintf(" %02X", report.keys[i]);
+    for (uint8_t i = 2; i < len; i++) {
+        dprintf(" %02X", buf[i]);
     }
     dprint("\r\n");
 }
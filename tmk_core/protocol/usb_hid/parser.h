@@ -7,8 +7,11 @@
 class KBDReportParser : public HIDReportParser
 {
 public:
+    KBDReportParser(uint8_t device = 0) : device(device) {}
     report_keyboard_t report;
     uint16_t time_stamp;
+    // index of the keyboard in hid_merge.h
+    uint8_t device;
     virtual void Parse(HID *hid, bool is_rpt_id, uint8_t len, uint8_t *buf);
 };
 
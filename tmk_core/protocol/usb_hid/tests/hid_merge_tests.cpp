@@ -0,0 +1,202 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <utility>
+#include "hid_merge.h"
+
+// A report as it came in from a keyboard, ms after the capture started
+struct captured_report {
+    uint32_t time;
+    uint8_t device;
+    uint8_t report[8];
+};
+
+typedef std::vector<std::pair<uint8_t, bool>> events_t;
+
+// HID usages
+enum { A = 0x04, E = 0x08, H = 0x0B, T = 0x17, LSHIFT = 0xE1, RSHIFT = 0xE5 };
+#define MOD(usage) (1 << ((usage) - HID_MODIFIER_FIRST))
+
+class HidMerge : public testing::Test {
+   public:
+    HidMerge() { hid_merge_init(); }
+
+    // Replays a capture into a matrix scanned every scan_interval ms, and returns the key
+    // events that the scans see, in order
+    events_t replay(const std::vector<captured_report>& capture, uint32_t scan_interval) {
+        events_t events;
+        size_t next = 0;
+        uint32_t end = capture.back().time + 100;
+        for (uint32_t time = 0; time <= end; time += scan_interval) {
+            while (next < capture.size() && capture[next].time <= time) {
+                hid_merge_report(capture[next].device, capture[next].report, sizeof(capture[next].report));
+                next++;
+            }
+            scan(events);
+        }
+        return events;
+    }
+
+    // Like keyboard_task(): the matrix is scanned, which applies the queued reports, then the
+    // keys that changed are processed in matrix order, up to keys_per_scan of them
+    void scan(events_t& events) {
+        hid_merge_apply();
+        unsigned processed = 0;
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            uint16_t change = hid_merge_row(row) ^ matrix_prev[row];
+            for (uint8_t col = 0; change && col < MATRIX_COLS; col++) {
+                if (change & (1 << col)) {
+                    events.emplace_back(row * MATRIX_COLS + col, hid_merge_row(row) & (1 << col));
+                    matrix_prev[row] ^= 1 << col;
+                    if (++processed >= keys_per_scan) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    // The converter's matrix has a row per 16 usages
+    static const uint8_t MATRIX_ROWS = 16;
+    static const uint8_t MATRIX_COLS = 16;
+    // As the converter sets QMK_KEYS_PER_SCAN
+    unsigned keys_per_scan = MATRIX_ROWS * MATRIX_COLS;
+    uint16_t matrix_prev[MATRIX_ROWS] = {};
+};
+
+// Typing "the" quickly, with each key still down when the next is pressed
+static const std::vector<captured_report> rolled_the = {
+    {0, 0, {0, 0, T}},
+    {2, 0, {0, 0, T, H}},
+    {3, 0, {0, 0, H}},
+    {5, 0, {0, 0, H, E}},
+    {6, 0, {0, 0, E}},
+    {8, 0, {0, 0}},
+};
+
+TEST_F(HidMerge, every_report_is_seen_by_a_scan) {
+    events_t expected = {{T, true}, {H, true}, {T, false}, {E, true}, {H, false}, {E, false}};
+    EXPECT_EQ(replay(rolled_the, 1), expected);
+    // with the scans slower than the reports
+    hid_merge_init();
+    std::fill(std::begin(matrix_prev), std::end(matrix_prev), 0);
+    EXPECT_EQ(replay(rolled_the, 3), expected);
+    EXPECT_EQ(hid_merge_dropped(), 0);
+}
+
+TEST_F(HidMerge, a_tap_between_two_scans_is_not_lost) {
+    std::vector<captured_report> capture = {
+        {1, 0, {MOD(LSHIFT), 0, A}},
+        {2, 0, {0, 0}},
+    };
+    events_t expected = {{A, true}, {LSHIFT, true}, {A, false}, {LSHIFT, false}};
+    EXPECT_EQ(replay(capture, 5), expected);
+}
+
+TEST_F(HidMerge, one_key_per_scan_loses_part_of_a_report) {
+    // why the converter has to process all keys that changed in a scan
+    keys_per_scan = 1;
+    std::vector<captured_report> capture = {
+        {1, 0, {MOD(LSHIFT), 0, A}},
+        {2, 0, {0, 0}},
+    };
+    events_t events = replay(capture, 5);
+    EXPECT_EQ(events, events_t({{A, true}, {A, false}}));
+}
+
+TEST_F(HidMerge, keyboards_together_roll_over_more_than_six_keys) {
+    std::vector<captured_report> capture = {
+        {0, 0, {MOD(LSHIFT), 0, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09}},
+        {0, 1, {MOD(RSHIFT), 0, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23}},
+    };
+    replay(capture, 1);
+    EXPECT_EQ(hid_merge_key_count(), 14);
+    EXPECT_TRUE(hid_merge_is_on(0x09));
+    EXPECT_TRUE(hid_merge_is_on(0x23));
+    // the converter's matrix has 16 usages per row
+    EXPECT_EQ(hid_merge_row(0), 0x03F0);
+    EXPECT_EQ(hid_merge_row(0xE), MOD(LSHIFT) | MOD(RSHIFT));
+}
+
+TEST_F(HidMerge, a_key_held_on_two_keyboards_is_released_by_the_last) {
+    std::vector<captured_report> capture = {
+        {0, 0, {0, 0, A}},
+        {10, 2, {0, 0, A}},
+        {20, 0, {0, 0}},
+        {30, 2, {0, 0}},
+    };
+    events_t events;
+    size_t next = 0;
+    std::vector<bool> held;
+    for (uint32_t time = 0; time <= 40; time++) {
+        while (next < capture.size() && capture[next].time <= time) {
+            hid_merge_report(capture[next].device, capture[next].report, 8);
+            next++;
+        }
+        scan(events);
+        if (time % 10 == 5) {
+            held.push_back(hid_merge_is_on(A));
+        }
+    }
+    EXPECT_EQ(events, events_t({{A, true}, {A, false}}));
+    EXPECT_EQ(held, std::vector<bool>({true, true, true, false}));
+}
+
+TEST_F(HidMerge, roll_over_errors_keep_the_keys) {
+    std::vector<captured_report> capture = {
+        {0, 0, {0, 0, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09}},
+        // a seventh key, and shift
+        {5, 0, {MOD(LSHIFT), 0, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01}},
+        {10, 0, {MOD(LSHIFT), 0, 0x05}},
+    };
+    events_t events = replay(capture, 1);
+    events_t expected = {{0x04, true}, {0x05, true}, {0x06, true}, {0x07, true}, {0x08, true}, {0x09, true},
+                         {LSHIFT, true},
+                         {0x04, false}, {0x06, false}, {0x07, false}, {0x08, false}, {0x09, false}};
+    EXPECT_EQ(events, expected);
+    EXPECT_FALSE(hid_merge_is_on(0x01));
+}
+
+TEST_F(HidMerge, unplugging_releases_the_keys) {
+    std::vector<captured_report> capture = {
+        {0, 1, {MOD(LSHIFT), 0, A}},
+    };
+    replay(capture, 1);
+    EXPECT_EQ(hid_merge_key_count(), 2);
+    hid_merge_release(1);
+    EXPECT_TRUE(hid_merge_apply());
+    EXPECT_EQ(hid_merge_key_count(), 0);
+}
+
+TEST_F(HidMerge, a_full_queue_keeps_the_last_report) {
+    for (uint8_t key = 0x04; key < 0x04 + HID_MERGE_QUEUE_SIZE + 3; key++) {
+        uint8_t report[8] = {0, 0, key};
+        hid_merge_report(0, report, sizeof(report));
+    }
+    while (hid_merge_apply()) {
+    }
+    EXPECT_EQ(hid_merge_dropped(), 3);
+    EXPECT_EQ(hid_merge_key_count(), 1);
+    EXPECT_TRUE(hid_merge_is_on(0x04 + HID_MERGE_QUEUE_SIZE + 2));
+}
+
+TEST_F(HidMerge, ignores_reports_of_unknown_keyboards) {
+    uint8_t report[8] = {0, 0, A};
+    hid_merge_report(HID_MERGE_DEVICES, report, sizeof(report));
+    EXPECT_FALSE(hid_merge_apply());
+}
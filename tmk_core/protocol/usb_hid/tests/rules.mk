@@ -0,0 +1,5 @@
+hid_merge_SRC :=\
+	$(TMK_PATH)/protocol/usb_hid/tests/hid_merge_tests.cpp \
+	$(TMK_PATH)/protocol/usb_hid/hid_merge.c
+
+hid_merge_INC := $(TMK_PATH)/protocol/usb_hid
@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	hid_merge